@@ -1,6 +1,7 @@
 /// Eye animation definitions for 2023 booper.badge.lgbt.
 /**
- **
+ ** Generated from animations.anim by programming/anim_compile.py; edit that, not this.
+ ** See the ANIM_ opcodes in leds.h for the encoding.
  **
  ** \file animations.c
  ** \author George Louthan
@@ -9,207 +10,100 @@
  */
 
 #include "leds.h"
-#include "eyes.h"
-
-eye_anim_frame_t anim_shifty_frames[] = {
-    (eye_anim_frame_t) {
-        {CIRCLE_LEFT, CIRCLE_LEFT},
-        20,
-    },
-    (eye_anim_frame_t) {
-        {CIRCLE_RIGHT, CIRCLE_RIGHT},
-        20,
-    }
-};
-
-eye_anim_t anim_shifty = (eye_anim_t) {
-    .frames = anim_shifty_frames,
-    .length = 2,
-    .loop_count = 3,
-};
-
-eye_anim_frame_t anim_dafuq_frames[] = {
-    (eye_anim_frame_t) {
-        {CIRCLE_RIGHT, CIRCLE_BIG},
-        80,
-    },
-    (eye_anim_frame_t) {
-        {CIRCLE_BIG, CIRCLE_LEFT},
-        80,
-    },
-};
-
-eye_anim_t anim_dafuq = (eye_anim_t) {
-    .frames = anim_dafuq_frames,
-    .length = 2,
-    .loop_count = 4,
-};
-
-eye_anim_frame_t anim_happytoggle_frames[] = {
-    (eye_anim_frame_t) {
-        {HAPPY_LEFT, HAPPY_RIGHT},
-        75,
-    },
-    (eye_anim_frame_t) {
-        {HAPPY_RIGHT, HAPPY_LEFT},
-        75,
-    },
-};
-
-eye_anim_t anim_happytoggle = (eye_anim_t) {
-    .frames = anim_happytoggle_frames,
-    .length = 2,
-    .loop_count = 6,
-};
-
-eye_anim_frame_t anim_happywink_frames[] = {
-    (eye_anim_frame_t) {
-        {HAPPY_BIG, BLINK_WIDE},
-        150,
-    },
-};
-
-eye_anim_t anim_happywink = (eye_anim_t) {
-    .frames = anim_happywink_frames,
-    .length = 1,
-    .loop_count = 0,
-};
-
-eye_anim_frame_t anim_wink_frames[] = {
-    (eye_anim_frame_t) {
-        {CIRCLE_RIGHT, BLINK_LEFT},
-        80,
-    },
-};
-
-eye_anim_t anim_wink = (eye_anim_t) {
-    .frames = anim_wink_frames,
-    .length = 1,
-    .loop_count = 0,
-};
-
-eye_anim_frame_t anim_dirshifty_frames[] = {
-    (eye_anim_frame_t) {
-        {SIDE_LEFT, SIDE_LEFT},
-        45,
-    },
-    (eye_anim_frame_t) {
-        {SIDE_RIGHT, SIDE_RIGHT},
-        45,
-    }
-};
-
-eye_anim_t anim_dirshifty = (eye_anim_t) {
-    .frames = anim_dirshifty_frames,
-    .length = 2,
-    .loop_count = 3,
-};
-
-
-eye_anim_frame_t anim_lookaround_frames[] = {
-    (eye_anim_frame_t) {
-        {DIAG_UL, DIAG_UL},
-        32,
-    },
-    (eye_anim_frame_t) {
-        {DIAG_LR, DIAG_LR},
-        32,
-    },
-};
-
-eye_anim_t anim_lookaround = (eye_anim_t) {
-    .frames = anim_lookaround_frames,
-    .length = 2,
-    .loop_count = 4,
-};
-
-eye_anim_t *animations[] = {
-    &anim_shifty,
-    &anim_dafuq,
-    &anim_happytoggle,
-    &anim_happywink,
-    &anim_wink,
-    &anim_dirshifty,
-    &anim_lookaround,
-};
-
-eye_anim_frame_t anim_boop_frames[] = {
-   (eye_anim_frame_t) {
-       {ONLY_M, ONLY_L},
-       5,
-   },
-   (eye_anim_frame_t) {
-       {ONLY_UR, ONLY_UL},
-       5,
-   },
-   (eye_anim_frame_t) {
-       {ONLY_R, ONLY_M},
-       5,
-   },
-   (eye_anim_frame_t) {
-       {ONLY_LR, ONLY_LL},
-       5,
-   },
-};
-
-eye_anim_t anim_boop = (eye_anim_t) {
-    .frames = anim_boop_frames,
-    .length = 4,
-    .loop_count = 10,
-};
-
-#define BIGSPIN_FRAMERATE 3
-eye_anim_frame_t anim_bigspin_frames[] = {
-    (eye_anim_frame_t) {
-        {ONLY_L, EYE_OFF},
-        BIGSPIN_FRAMERATE,
-    },
-    (eye_anim_frame_t) {
-        {ONLY_LL, EYE_OFF},
-        BIGSPIN_FRAMERATE,
-    },
-    (eye_anim_frame_t) {
-        {ONLY_LR, EYE_OFF},
-        BIGSPIN_FRAMERATE,
-    },
-    (eye_anim_frame_t) {
-        {EYE_OFF, ONLY_LL},
-        BIGSPIN_FRAMERATE,
-    },
-    (eye_anim_frame_t) {
-        {EYE_OFF, ONLY_LR},
-        BIGSPIN_FRAMERATE,
-    },
-    (eye_anim_frame_t) {
-        {EYE_OFF, ONLY_R},
-        BIGSPIN_FRAMERATE,
-    },
-    (eye_anim_frame_t) {
-        {EYE_OFF, ONLY_UR},
-        BIGSPIN_FRAMERATE,
-    },
-    (eye_anim_frame_t) {
-        {EYE_OFF, ONLY_UL},
-        BIGSPIN_FRAMERATE,
-    },
-    (eye_anim_frame_t) {
-        {ONLY_UR, EYE_OFF},
-        BIGSPIN_FRAMERATE,
-    },
-    (eye_anim_frame_t) {
-        {ONLY_UL, EYE_OFF},
-        BIGSPIN_FRAMERATE,
-    },
-};
-
-eye_anim_t anim_new_badge = (eye_anim_t) {
-    .frames = anim_bigspin_frames,
-    .length = 10,
-    .loop_count = 8,
-};
-
-eye_anim_t anim_seen_badge = (eye_anim_t) {
-    .frames = anim_bigspin_frames,
-    .length = 10,
-    .loop_count = 1,
+#include "animations.h"
+
+eye_anim_t anim_shifty[] = {
+    0x54,                // dur 20
+    0x01, 0x04,          // repeat 4
+        0x04, 0x0f,          // frame: CIRCLE_LEFT
+        0x08,                // frame: mirror
+    0x02,                // next
+    0x00,                // end
+};
+
+eye_anim_t anim_dafuq[] = {
+    0x0a, 0x50,          // dur 80
+    0x01, 0x05,          // repeat 5
+        0x03, 0xe8, 0xe7,    // frame: CIRCLE_RIGHT CIRCLE_BIG
+        0x03, 0xe7, 0x0f,    // frame: CIRCLE_BIG CIRCLE_LEFT
+    0x02,                // next
+    0x00,                // end
+};
+
+eye_anim_t anim_happytoggle[] = {
+    0x0a, 0x4b,          // dur 75
+    0x01, 0x07,          // repeat 7
+        0x03, 0x0b, 0x68,    // frame: HAPPY_LEFT HAPPY_RIGHT
+        0x08,                // frame: mirror
+    0x02,                // next
+    0x00,                // end
+};
+
+eye_anim_t anim_happywink[] = {
+    0x0a, 0x96,          // dur 150
+    0x03, 0x63, 0x84,    // frame: HAPPY_BIG BLINK_WIDE
+    0x00,                // end
+};
+
+eye_anim_t anim_wink[] = {
+    0x0a, 0x50,          // dur 80
+    0x03, 0xe8, 0x04,    // frame: CIRCLE_RIGHT BLINK_LEFT
+    0x00,                // end
+};
+
+eye_anim_t anim_dirshifty[] = {
+    0x6d,                // dur 45
+    0x01, 0x04,          // repeat 4
+        0x04, 0x07,          // frame: SIDE_LEFT
+        0x08,                // frame: mirror
+    0x02,                // next
+    0x00,                // end
+};
+
+eye_anim_t anim_lookaround[] = {
+    0x60,                // dur 32
+    0x01, 0x05,          // repeat 5
+        0x04, 0x03,          // frame: DIAG_UL
+        0x13,                // frame: rotate 3
+    0x02,                // next
+    0x00,                // end
+};
+
+eye_anim_t anim_boop[] = {
+    0x45,                // dur 5
+    0x01, 0x0b,          // repeat 11
+        0x03, 0x08, 0x02,    // frame: ONLY_M ONLY_L
+        0x03, 0x20, 0x01,    // frame: ONLY_UR ONLY_UL
+        0x03, 0x40, 0x08,    // frame: ONLY_R ONLY_M
+        0x03, 0x80, 0x04,    // frame: ONLY_LR ONLY_LL
+    0x02,                // next
+    0x00,                // end
+};
+
+eye_anim_t anim_new_badge[] = {
+    0x43,                // dur 3
+    0x03, 0x02, 0x00,    // frame: ONLY_L EYE_OFF
+    0x01, 0x59,          // repeat 89
+        0x09,                // frame: chase
+    0x02,                // next
+    0x00,                // end
+};
+
+eye_anim_t anim_seen_badge[] = {
+    0x43,                // dur 3
+    0x03, 0x02, 0x00,    // frame: ONLY_L EYE_OFF
+    0x01, 0x13,          // repeat 19
+        0x09,                // frame: chase
+    0x02,                // next
+    0x00,                // end
+};
+
+eye_anim_t * const animations[] = {
+    anim_shifty,
+    anim_dafuq,
+    anim_happytoggle,
+    anim_happywink,
+    anim_wink,
+    anim_dirshifty,
+    anim_lookaround,
 };
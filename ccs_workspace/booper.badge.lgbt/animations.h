@@ -1,6 +1,7 @@
-/// Animation headers for 2023 booper.badge.lgbt.
+/// Eye animation headers for 2023 booper.badge.lgbt.
 /**
- **
+ ** Generated from animations.anim by programming/anim_compile.py; edit that, not this.
+ ** See the ANIM_ opcodes in leds.h for the encoding.
  **
  ** \file animations.h
  ** \author George Louthan
@@ -13,11 +14,17 @@
 
 #define ANIMATION_COUNT 7
 
-extern eye_anim_t *animations[];
+extern eye_anim_t * const animations[];
 
-extern eye_anim_t anim_shifty;
-extern eye_anim_t anim_boop;
-extern eye_anim_t anim_new_badge;
-extern eye_anim_t anim_seen_badge;
+extern eye_anim_t anim_shifty[];
+extern eye_anim_t anim_dafuq[];
+extern eye_anim_t anim_happytoggle[];
+extern eye_anim_t anim_happywink[];
+extern eye_anim_t anim_wink[];
+extern eye_anim_t anim_dirshifty[];
+extern eye_anim_t anim_lookaround[];
+extern eye_anim_t anim_boop[];
+extern eye_anim_t anim_new_badge[];
+extern eye_anim_t anim_seen_badge[];
 
 #endif /* ANIMATIONS_H_ */
@@ -19,7 +19,6 @@
  */
 
 #include <stdint.h>
-#include <stdlib.h>
 
 #include <msp430fr2633.h>
 
@@ -28,13 +27,25 @@
 #include "util.h"
 #include "leds.h"
 #include "radio.h"
-
-uint8_t badge_boop_radio_cooldown = 0;
+#include "timer.h"
+#include "persist.h"
+#include "rng.h"
+
+void badge_blink();
+void badge_count_step();
+
+/// Running while it's too soon after our last radio boop for another.
+sw_timer_t badge_boop_radio_cooldown = {0,};
+/// Comes due when it's time to blink or animate.
+sw_timer_t badge_blink_timer = {.fire = badge_blink};
+/// Comes due for each number of the boot count-up.
+sw_timer_t badge_count_timer = {.fire = badge_count_step};
+/// Next number the boot count-up will show.
+uint8_t badge_count_next = 0;
 uint8_t badge_block_radio_game = 0;
 uint8_t long_presses = 0;
 
-#pragma PERSISTENT(badge_conf)
-/// The main persistent badge configuration.
+/// The main persistent badge configuration, loaded and saved by persist.c.
 volatile badge_conf_t badge_conf = (badge_conf_t){
     .badge_id = BADGE_ID_UNASSIGNED,
     .badges_seen = {0,},
@@ -72,11 +83,11 @@ void badge_set_seen(uint8_t id) {
     if (badge_block_radio_game)
         return;
 
-    if (id >= 8*BADGES_SEEN_BUFFER_LEN_BYTES) {
+    if (id >= BITSET_WORD_BITS*BADGES_SET_WORDS) {
         return; // Invalid ID.
     }
 
-    uint8_t seen = check_id_buf(id, (uint8_t *) badge_conf.badges_seen);
+    uint8_t seen = bitset_test((uint16_t *) badge_conf.badges_seen, id);
 
     if (seen) {
         leds_queerdar_alert(LEDS_QUEERDAR_OLDBADGE);
@@ -84,15 +95,13 @@ void badge_set_seen(uint8_t id) {
     }
 
     // New badge!
-    fram_unlock();
-
-    set_id_buf(id, (uint8_t *) (badge_conf.badges_seen));
+    bitset_set((uint16_t *) badge_conf.badges_seen, id);
 
     if (badge_conf.badges_seen_count < UINT8_MAX) {
         badge_conf.badges_seen_count++;
     }
 
-    fram_lock();
+    persist_changed();
 
     leds_queerdar_alert(LEDS_QUEERDAR_NEWBADGE);
 }
@@ -102,13 +111,16 @@ void badge_set_id(uint8_t id) {
     uint8_t old_id = badge_conf.badge_id;
 
     if (id != badge_conf.badge_id) {
-        fram_unlock();
-
         badge_conf.badge_id = id;
-        unset_id_buf(old_id, (uint8_t *) badge_conf.badges_seen);
-        set_id_buf(badge_conf.badge_id, (uint8_t *) badge_conf.badges_seen);
+        // BADGE_ID_UNASSIGNED, coming or going, has no bit in the set.
+        if (old_id < BITSET_WORD_BITS*BADGES_SET_WORDS) {
+            bitset_clear((uint16_t *) badge_conf.badges_seen, old_id);
+        }
+        if (id < BITSET_WORD_BITS*BADGES_SET_WORDS) {
+            bitset_set((uint16_t *) badge_conf.badges_seen, id);
+        }
 
-        fram_lock();
+        persist_changed();
     }
 }
 
@@ -122,31 +134,71 @@ void badge_button_press_long() {
 /// Callback for a short button press.
 void badge_button_press_short() {
     if (!badge_conf.bootstrapped) {
-        fram_unlock();
         badge_conf.bootstrapped = 1;
-        fram_lock();
+        persist_changed();
         leds_queerdar_alert(LEDS_QUEERDAR_OLDBADGE);
         return;
     }
 
     leds_boop();
-    if (!badge_boop_radio_cooldown) {
-        badge_boop_radio_cooldown = BADGE_RADIO_BOOP_COOLDOWN;
+    if (!timer_running(&badge_boop_radio_cooldown)) {
+        timer_start(&badge_boop_radio_cooldown, BADGE_RADIO_BOOP_COOLDOWN * 100);
         s_boop_radio = 1;
     }
 }
 
+/// Blink or animate, unless the game hasn't started, and pick when to next.
+void badge_blink() {
+    if (!badge_block_radio_game) {
+        leds_blink_or_bling();
+    }
+    timer_start(&badge_blink_timer,
+                (1 + rng_below(BADGE_SECS_PER_BLINK_AVG)) * 100);
+}
+
+/// Show the next number of the boot count-up, and come back for the one after.
+/**
+ ** Every number but the last comes down on its own if the next one is
+ ** late, and the last stays up for BADGE_COUNT_HOLD_CSECS.
+ */
+void badge_count_step() {
+    uint8_t last = badge_conf.badges_seen_count < 100 ? badge_conf.badges_seen_count : 100;
+
+    if (badge_count_next < last) {
+        leds_show_number(badge_count_next, 2 * BADGE_COUNT_STEP_CSECS);
+        badge_count_next++;
+        timer_start(&badge_count_timer, BADGE_COUNT_STEP_CSECS);
+    } else {
+        leds_show_number(last, BADGE_COUNT_HOLD_CSECS);
+    }
+}
+
+/// Count up the badges we've seen on the eyes, if we have something to show.
+/**
+ ** This runs from the main loop's timers, so the radio and the button are
+ ** already live while it counts, rather than waiting for it.
+ */
+void badge_count_start() {
+    if (badge_conf.bootstrapped && badge_conf.badges_seen_count > 1) {
+        badge_count_next = 0;
+        badge_count_step();
+    }
+}
+
 /// Initialize the badge application behavior.
 void badge_init() {
     // If my ID is unassigned, set myself to un-bootstrapped
     if (badge_conf.badge_id == BADGE_ID_UNASSIGNED) {
         if (badge_conf.bootstrapped) {
-            fram_unlock();
             badge_conf.bootstrapped = 0;
-            fram_lock();
+            persist_changed();
         }
     }
 
-    // Re-seed PRNG.
-    srand(badge_conf.badge_id*100 + badge_conf.badges_seen_count);
+    // Start the PRNG somewhere no other badge will; main() stirs in the
+    //  hardware's noise after this.
+    rng_stir(badge_conf.badge_id);
+
+    // The first blink is a couple of seconds into the main loop.
+    timer_start(&badge_blink_timer, 200);
 }
@@ -14,6 +14,8 @@
 
 #include "stdint.h"
 
+#include "bitset.h"
+
 /// MCLK rate in MHZ.
 #define MCLK_FREQ_MHZ 8
 /// SMCLK rate in Hz.
@@ -25,25 +27,38 @@
 /// Number of possible badges in the system
 #define BADGES_IN_SYSTEM 120
 
-/// Number of bytes in the bitfield of all badge IDs
-#define BADGES_SEEN_BUFFER_LEN_BYTES BADGES_IN_SYSTEM / 8 + 1
+/// Number of words in a bitset of all badge IDs (see bitset.h)
+#define BADGES_SET_WORDS BITSET_WORDS(BADGES_IN_SYSTEM)
 /// Valid badge ID but indicating it hasn't been assigned by a controller.
 #define BADGE_ID_UNASSIGNED 250
 
-/// The number of seconds allowed between radio boops
+/// The number of seconds between radio boops
 #define BADGE_RADIO_BOOP_COOLDOWN 2
 
 /// Duration of a blink in csec ticks.
 #define BLINK_TICKS 30
 
-#define BADGE_BRIGHTNESS_0 0x00ff
-#define BADGE_BRIGHTNESS_1 0x0900
-#define BADGE_BRIGHTNESS_2 0xf000
+/// The levels of leds_brightness_ladder that the button cycles through.
+#define BADGE_BRIGHTNESS_0 0
+#define BADGE_BRIGHTNESS_1 6
+#define BADGE_BRIGHTNESS_2 15
+/// SMCLK (so, GSCLK) is divided by 2 to this power at BADGE_BRIGHTNESS_0.
+#define BADGE_DIM_SMCLK_DIV_SHIFT 1
 
 #define BADGE_POST_ERR_NONE 0
 #define BADGE_POST_ERR_NOID 1
 #define BADGE_POST_ERR_NORF 2
 #define BADGE_POST_ERR_FREQ 3
+#define BADGE_POST_ERR_LEDS 4
+
+/// First byte of the LED test report sent out P1.4 at power-on.
+/**
+ ** The report is `0x5A | open (2) | shorted (2) | sum`, little-endian, with
+ ** the bitmaps from tlc_test_leds(), and `sum` making the 8-bit sum of
+ ** every byte after the 0x5A come out to zero. programming/post_check.py
+ ** reads it.
+ */
+#define BADGE_POST_REPORT_SYNC 0x5A
 
 #define BADGE_RADIO_CALIBRATION_SECS_PER_FREQ 8
 #define BADGE_RADIO_CALIBRATION_SECS_PER_FREQ_INITIAL 4
@@ -52,13 +67,17 @@
 #define BADGE_BOOP_FACE_LEN_CSECS 800
 #define BADGE_ANIM_CHANCE_ONE_IN 8
 #define BADGE_FACE_CHANCE_ONE_IN 8
+/// Ticks each number of the boot count-up of badges seen is shown for.
+#define BADGE_COUNT_STEP_CSECS 8
+/// Ticks the last number of the boot count-up stays up.
+#define BADGE_COUNT_HOLD_CSECS 600
 
 /// Badge config struct definition
 typedef struct {
     /// The badge's ID, between 0 and BADGE_ID_UNASSIGNED, inclusive.
     uint16_t badge_id;
-    /// Bitfield tracking badge IDs seen.
-    uint8_t badges_seen[BADGES_SEEN_BUFFER_LEN_BYTES];
+    /// Bitset of badge IDs seen; the same 16 bytes as the byte-wise buffer it was.
+    uint16_t badges_seen[BADGES_SET_WORDS];
     /// Counter of badges seen generally
     uint8_t badges_seen_count;
     /// Has my setup been completed?
@@ -69,18 +88,15 @@ extern volatile badge_conf_t badge_conf;
 extern uint8_t badge_block_radio_game;
 
 extern uint8_t badge_brightness_level;
-extern volatile uint8_t f_time_loop;
-extern volatile uint8_t f_button_press_long;
-extern volatile uint8_t f_second;
 extern uint8_t s_boop_radio;
 extern volatile uint8_t button_state;
 
-extern uint8_t badge_boop_radio_cooldown;
-
 extern uint8_t long_presses;
 
-volatile void fram_unlock();
-volatile void fram_lock();
+void fram_unlock();
+void fram_lock();
+void fram_protect(uint16_t protect);
+void smclk_set_div_shift(uint8_t shift);
 
 void badge_update_queerdar_count(uint8_t badges_nearby);
 void badge_set_seen(uint8_t id);
@@ -88,5 +104,6 @@ void badge_button_press_long();
 void badge_button_press_short();
 
 void badge_init();
+void badge_count_start();
 
 #endif /* BADGE_H_ */
@@ -0,0 +1,145 @@
+/// Sets of badge IDs, and other small bitsets, a word at a time.
+/**
+ ** A bitset is an array of 16-bit words, with bit `n` at bit `n % 16` of
+ ** word `n / 16`. On the little-endian MSP430 that's the same layout as
+ ** the byte-wise buffers this replaced (bit `n % 8` of byte `n / 8`), so
+ ** the sets already in FRAM read the same either way.
+ **
+ ** The MSP430 shifts one bit per instruction, so nothing here shifts by
+ ** a variable amount where it can help it: single bits come out of
+ ** bitset_bits, and counts come from a nibble-at-a-time table, which is
+ ** small enough to keep in FRAM without a second thought. Everything
+ ** else works on whole words, which the CPU does in one instruction.
+ **
+ ** \file bitset.c
+ ** \author George Louthan
+ ** \date   2023
+ ** \copyright (c) 2023 George Louthan @duplico. MIT License.
+ */
+
+#include <stdint.h>
+
+#include "bitset.h"
+
+/// Each bit of a word, on its own.
+const uint16_t bitset_bits[BITSET_WORD_BITS] = {
+    0x0001, 0x0002, 0x0004, 0x0008, 0x0010, 0x0020, 0x0040, 0x0080,
+    0x0100, 0x0200, 0x0400, 0x0800, 0x1000, 0x2000, 0x4000, 0x8000,
+};
+
+/// Bits set in each nibble.
+const uint8_t bitset_nibble_count[16] = {
+    0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+};
+
+/// Return 1 if `bit` is set in `set`, 0 otherwise.
+uint8_t bitset_test(const uint16_t *set, uint16_t bit) {
+    return (set[bit / BITSET_WORD_BITS] & bitset_bits[bit % BITSET_WORD_BITS]) ? 1 : 0;
+}
+
+/// Set `bit` in `set`.
+void bitset_set(uint16_t *set, uint16_t bit) {
+    set[bit / BITSET_WORD_BITS] |= bitset_bits[bit % BITSET_WORD_BITS];
+}
+
+/// Clear `bit` in `set`.
+void bitset_clear(uint16_t *set, uint16_t bit) {
+    set[bit / BITSET_WORD_BITS] &= ~bitset_bits[bit % BITSET_WORD_BITS];
+}
+
+/// Return the first bit set in `set`, of `words` words, at or after `from`.
+/**
+ ** Returns BITSET_NONE if there isn't one. Words with nothing set are
+ ** skipped whole, so going through a sparse set like this:
+ **
+ **     for (i = bitset_next(set, words, 0); i != BITSET_NONE; i = bitset_next(set, words, i + 1))
+ **
+ ** costs a compare per empty word rather than one per bit. It's fine to
+ ** clear bit `i` inside the loop.
+ */
+uint16_t bitset_next(const uint16_t *set, uint8_t words, uint16_t from) {
+    uint16_t w = from / BITSET_WORD_BITS;
+    uint16_t word;
+
+    if (w >= words) {
+        return BITSET_NONE;
+    }
+
+    // The first word, without the bits before `from`.
+    word = set[w] & ~(bitset_bits[from % BITSET_WORD_BITS] - 1);
+    while (!word) {
+        if (++w >= words) {
+            return BITSET_NONE;
+        }
+        word = set[w];
+    }
+
+    // Find the lowest bit set, a byte, then a nibble, then a bit at a time.
+    from = w * BITSET_WORD_BITS;
+    if (!(word & 0x00ff)) {
+        word >>= 8;
+        from += 8;
+    }
+    if (!(word & 0x000f)) {
+        word >>= 4;
+        from += 4;
+    }
+    while (!(word & 1)) {
+        word >>= 1;
+        from++;
+    }
+    return from;
+}
+
+/// Return how many bits are set in `word`.
+uint8_t bitset_word_count(uint16_t word) {
+    return bitset_nibble_count[word & 0xf] +
+           bitset_nibble_count[(word >> 4) & 0xf] +
+           bitset_nibble_count[(word >> 8) & 0xf] +
+           bitset_nibble_count[word >> 12];
+}
+
+/// Return how many bits are set in `set`, of `words` words.
+uint16_t bitset_count(const uint16_t *set, uint8_t words) {
+    uint16_t count = 0;
+
+    for (uint8_t i=0; i<words; i++) {
+        if (set[i]) {
+            count += bitset_word_count(set[i]);
+        }
+    }
+    return count;
+}
+
+/// Return how many bits are set in both `a` and `b`, without building their intersection.
+uint16_t bitset_count_and(const uint16_t *a, const uint16_t *b, uint8_t words) {
+    uint16_t count = 0;
+
+    for (uint8_t i=0; i<words; i++) {
+        if (a[i] & b[i]) {
+            count += bitset_word_count(a[i] & b[i]);
+        }
+    }
+    return count;
+}
+
+/// Put the union of `a` and `b` in `dst`, which may be either of them.
+void bitset_or(uint16_t *dst, const uint16_t *a, const uint16_t *b, uint8_t words) {
+    for (uint8_t i=0; i<words; i++) {
+        dst[i] = a[i] | b[i];
+    }
+}
+
+/// Put the intersection of `a` and `b` in `dst`, which may be either of them.
+void bitset_and(uint16_t *dst, const uint16_t *a, const uint16_t *b, uint8_t words) {
+    for (uint8_t i=0; i<words; i++) {
+        dst[i] = a[i] & b[i];
+    }
+}
+
+/// Put what's in `a` but not in `b` in `dst`, which may be either of them.
+void bitset_andnot(uint16_t *dst, const uint16_t *a, const uint16_t *b, uint8_t words) {
+    for (uint8_t i=0; i<words; i++) {
+        dst[i] = a[i] & ~b[i];
+    }
+}
@@ -0,0 +1,32 @@
+/// Header for sets of badge IDs, and other small bitsets.
+/**
+ ** \file bitset.h
+ ** \author George Louthan
+ ** \date   2023
+ ** \copyright (c) 2023 George Louthan @duplico. MIT License.
+ */
+
+#ifndef BITSET_H_
+#define BITSET_H_
+
+#include <stdint.h>
+
+/// Bits in each word of a bitset.
+#define BITSET_WORD_BITS 16
+/// Words a bitset of `bits` bits takes.
+#define BITSET_WORDS(bits) (((bits) + BITSET_WORD_BITS - 1) / BITSET_WORD_BITS)
+/// What bitset_next() returns when there are no more bits set.
+#define BITSET_NONE 0xffff
+
+uint8_t bitset_test(const uint16_t *set, uint16_t bit);
+void bitset_set(uint16_t *set, uint16_t bit);
+void bitset_clear(uint16_t *set, uint16_t bit);
+uint16_t bitset_next(const uint16_t *set, uint8_t words, uint16_t from);
+uint8_t bitset_word_count(uint16_t word);
+uint16_t bitset_count(const uint16_t *set, uint8_t words);
+uint16_t bitset_count_and(const uint16_t *a, const uint16_t *b, uint8_t words);
+void bitset_or(uint16_t *dst, const uint16_t *a, const uint16_t *b, uint8_t words);
+void bitset_and(uint16_t *dst, const uint16_t *a, const uint16_t *b, uint8_t words);
+void bitset_andnot(uint16_t *dst, const uint16_t *a, const uint16_t *b, uint8_t words);
+
+#endif /* BITSET_H_ */
@@ -0,0 +1,97 @@
+/// Warm-boot cache of the DCO trim and the button's touch calibration.
+/**
+ ** Every reset used to trim the DCO and calibrate CapTIvate from scratch,
+ ** which nearly always comes out the same on the same badge. This keeps the
+ ** last good answer for each in FRAM, so main() can put it straight back
+ ** at boot, and only redo the work when it no longer holds up.
+ **
+ ** Each record has its own version and CRC, so an erased cache (INFOA is
+ ** erased whenever program_badge.py writes it), a half-written one, or one
+ ** from an older layout just reads as missing, and the badge calibrates
+ ** the long way. Saving a record that hasn't changed doesn't write FRAM.
+ **
+ ** \file calcache.c
+ ** \author George Louthan
+ ** \date   2023
+ ** \copyright (c) 2023 George Louthan @duplico. MIT License.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include <msp430fr2633.h>
+
+#include "badge.h"
+#include "util.h"
+#include "calcache.h"
+
+#pragma NOINIT(calcache)
+#pragma LOCATION(calcache, CALCACHE_ADDR)
+/// The cached calibrations.
+/**
+ ** Like tlc_dc_cal, this sits outside the firmware image, so reflashing the
+ ** code leaves it alone.
+ */
+calcache_t calcache;
+
+/// Return 1 if the DCO trim in the cache is good to use.
+uint8_t calcache_dco_valid() {
+    return calcache.dco.version == CALCACHE_VERSION &&
+            crc16_check_buffer((uint8_t *) &calcache.dco, sizeof(calcache_dco_t) - 2);
+}
+
+/// Save a DCO trim, from CSCTL0 and CSCTL1, if it's not the one in the cache.
+void calcache_dco_save(uint16_t csctl0, uint16_t csctl1) {
+    if (calcache_dco_valid() && calcache.dco.csctl0 == csctl0 &&
+            calcache.dco.csctl1 == csctl1) {
+        return;
+    }
+
+    fram_unlock();
+    calcache.dco.version = CALCACHE_VERSION;
+    calcache.dco.csctl0 = csctl0;
+    calcache.dco.csctl1 = csctl1;
+    crc16_append_buffer((uint8_t *) &calcache.dco, sizeof(calcache_dco_t) - 2);
+    fram_lock();
+}
+
+/// Drop the cached DCO trim, so the next boot does the full trim.
+void calcache_dco_forget() {
+    if (!calcache_dco_valid()) {
+        return;
+    }
+
+    fram_unlock();
+    calcache.dco.version = 0;
+    fram_lock();
+}
+
+/// Return 1 if the touch calibration in the cache is good to use.
+uint8_t calcache_touch_valid() {
+    return calcache.touch.version == CALCACHE_VERSION &&
+            crc16_check_buffer((uint8_t *) &calcache.touch, sizeof(calcache_touch_t) - 2);
+}
+
+/// Copy the cached touch calibration into `tuning`, and return 1, if there is one.
+uint8_t calcache_touch_load(tCaptivateElementTuning *tuning) {
+    if (!calcache_touch_valid()) {
+        return 0;
+    }
+
+    memcpy(tuning, calcache.touch.tuning, sizeof(calcache.touch.tuning));
+    return 1;
+}
+
+/// Save the touch calibration in `tuning`, if it's not the one in the cache.
+void calcache_touch_save(tCaptivateElementTuning *tuning) {
+    if (calcache_touch_valid() &&
+            !memcmp(tuning, calcache.touch.tuning, sizeof(calcache.touch.tuning))) {
+        return;
+    }
+
+    fram_unlock();
+    calcache.touch.version = CALCACHE_VERSION;
+    memcpy(calcache.touch.tuning, tuning, sizeof(calcache.touch.tuning));
+    crc16_append_buffer((uint8_t *) &calcache.touch, sizeof(calcache_touch_t) - 2);
+    fram_lock();
+}
@@ -0,0 +1,52 @@
+/// Header for the warm-boot calibration cache.
+/**
+ ** \file calcache.h
+ ** \author George Louthan
+ ** \date   2023
+ ** \copyright (c) 2023 George Louthan @duplico. MIT License.
+ */
+
+#ifndef CALCACHE_H_
+#define CALCACHE_H_
+
+#include <stdint.h>
+
+#include "captivate.h"
+
+/// Layout version of each cache record; bump it if a record changes.
+#define CALCACHE_VERSION 1
+/// Where the cache lives in INFOA, just under tlc_dc_cal.
+#define CALCACHE_ADDR 0x19D0
+
+/// The DCO trim from the last time the software trim in main.c finished.
+typedef struct {
+    uint16_t version;
+    /// DCO tap and modulation the trim settled on.
+    uint16_t csctl0;
+    /// DCO range and frequency trim the trim settled on.
+    uint16_t csctl1;
+    uint16_t crc;
+} calcache_dco_t;
+
+/// The button's CapTIvate calibration, one tuning per conversion frequency.
+typedef struct {
+    uint16_t version;
+    tCaptivateElementTuning tuning[CAPT_SELF_FREQ_CNT];
+    uint16_t crc;
+} calcache_touch_t;
+
+/// Both cached calibrations, which are saved and checked separately.
+typedef struct {
+    calcache_dco_t dco;
+    calcache_touch_t touch;
+} calcache_t;
+
+extern calcache_t calcache;
+
+uint8_t calcache_dco_valid();
+void calcache_dco_save(uint16_t csctl0, uint16_t csctl1);
+void calcache_dco_forget();
+uint8_t calcache_touch_load(tCaptivateElementTuning *tuning);
+void calcache_touch_save(tCaptivateElementTuning *tuning);
+
+#endif /* CALCACHE_H_ */
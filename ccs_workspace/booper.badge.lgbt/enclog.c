@@ -0,0 +1,366 @@
+/// Ring log of the badges we've encountered, in FRAM.
+/**
+ ** badge_conf.badges_seen only says whether we've ever heard a badge. This
+ ** keeps a record of each encounter: who, when we first and last heard
+ ** them, and how many times they booped while they were in range. radio.c
+ ** tracks the encounter in RAM while the peer's in range, which costs
+ ** nothing extra when a beacon comes in, and hands it to
+ ** enclog_encounter() when the peer ages out. Those are staged in RAM and
+ ** committed together, once per radio interval.
+ **
+ ** Each record is a tag byte, then unsigned LEB128 varints (7 bits a byte,
+ ** low bits first, top bit set on every byte but the last):
+ **
+ **     tag | last heard, minus the last record's | duration | [boops]
+ **
+ ** The tag is the peer's ID, with ENCLOG_BOOPED set if there's a boop
+ ** count; most encounters take 3 or 4 bytes. ENCLOG_BOOT on its own marks
+ ** a reset, after which times count from 0 again. Times are in radio
+ ** intervals, nominally RADIO_BEACON_INTERVAL_SECS, which is as finely as
+ ** radio.c can tell anyway.
+ **
+ ** After its header, the log is a ring of ENCLOG_BLOCKS blocks. Each one
+ ** starts with ENCLOG_BLOCK, a 16-bit sequence number one more than the
+ ** block before's, and (as a varint) the time of the record before it,
+ ** which the block's first record is relative to. A reader can start at
+ ** any block, then, and the oldest one left is where a dump starts. Records
+ ** don't span blocks. When the last block's full, the log moves on to the
+ ** next, overwriting the oldest, and the encounters lost are counted in
+ ** enclog_overwritten (until the next boot); a dump can tell how many
+ ** blocks went from the oldest one's sequence number.
+ **
+ ** That's not much: ENCLOG_BYTES holds the last 107 to 123 encounters
+ ** (`encdump -b`), not the thousands there'd be over a whole event. It's all the FRAM the
+ ** image left, going by the last map file; see enclog.h.
+ **
+ ** Records within a block are never rewritten, only added to, and
+ ** unwritten FRAM is kept at ENCLOG_END, which no record starts with. A
+ ** commit writes everything but its first byte, then a fresh ENCLOG_END
+ ** after it, then the first byte last, so a commit cut short by a brownout
+ ** still ends the log where it was. Likewise, moving on to a block clears
+ ** its tag first and writes it last. At boot, the newest block is the
+ ** valid one with the highest sequence number, and the end is wherever the
+ ** first ENCLOG_END in it, or anything else that doesn't decode, turns up.
+ **
+ ** The log is in main FRAM, which flashing the firmware erases; to read
+ ** it, dump it first, and decode it with host/encdump.
+ **
+ ** \file enclog.c
+ ** \author George Louthan
+ ** \date   2023
+ ** \copyright (c) 2023 George Louthan @duplico. MIT License.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include <msp430fr2633.h>
+
+#include "badge.h"
+#include "enclog.h"
+
+#pragma NOINIT(enclog_data)
+#pragma LOCATION(enclog_data, ENCLOG_ADDR)
+/// The log: its header, then its records, then ENCLOG_END to the end.
+uint8_t enclog_data[ENCLOG_BYTES];
+
+/// Offset in enclog_data where the next record goes.
+uint16_t enclog_len = ENCLOG_HEADER_BYTES;
+/// The block enclog_len is in.
+uint8_t enclog_block = 0;
+/// enclog_block's sequence number.
+uint16_t enclog_seq = 0;
+/// Offset of the first record in enclog_block.
+uint16_t enclog_block_first = 0;
+/// Time of the last record in the log, which the next is relative to.
+uint16_t enclog_time = 0;
+/// Encounters overwritten since boot, to make room for new ones.
+uint16_t enclog_overwritten = 0;
+/// Records waiting for enclog_commit().
+uint8_t enclog_staged[ENCLOG_STAGE_BYTES];
+/// Bytes in enclog_staged.
+uint8_t enclog_staged_len = 0;
+/// Time of the last encounter staged since boot, which the next is relative to.
+uint16_t enclog_last = 0;
+/// 1 once this boot's ENCLOG_BOOT has been staged.
+uint8_t enclog_booted = 0;
+
+/// Copy `len` bytes from `src` into the log at `offset`, with interrupts off.
+/**
+ ** If `src` is 0, it fills them with ENCLOG_END instead. This leaves
+ ** interrupts the way it found them, so it's safe before they're enabled.
+ */
+void enclog_write(uint16_t offset, const uint8_t *src, uint16_t len) {
+    uint16_t sr = __get_SR_register();
+
+    __bic_SR_register(GIE);
+    SYSCFG0 = FRWPPW | DFWP; // Main FRAM writable, INFOA still locked.
+    if (src) {
+        memcpy(&enclog_data[offset], src, len);
+    } else {
+        memset(&enclog_data[offset], ENCLOG_END, len);
+    }
+    SYSCFG0 = FRWPPW | DFWP | PFWP;
+    __bis_SR_register(sr & GIE);
+}
+
+/// Write `value` to `buf` as a varint, and return how many bytes it took.
+uint8_t enclog_varint_write(uint8_t *buf, uint16_t value) {
+    uint8_t len = 0;
+
+    while (value >= 0x80) {
+        buf[len++] = (value & 0x7f) | 0x80;
+        value >>= 7;
+    }
+    buf[len++] = value;
+    return len;
+}
+
+/// Read a varint at `*offset` in `buf` into `*value`, and move `*offset` past it.
+/**
+ ** Returns 0 if it runs past `len`, or won't fit in 16 bits.
+ */
+uint8_t enclog_varint_read(uint8_t *buf, uint16_t len, uint16_t *offset, uint16_t *value) {
+    uint8_t shift = 0;
+    uint8_t byte;
+
+    *value = 0;
+    do {
+        if (*offset >= len || shift > 14) {
+            return 0;
+        }
+        byte = buf[(*offset)++];
+        *value |= (uint16_t) (byte & 0x7f) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+    return 1;
+}
+
+/// Decode the record at `offset` in the log `buf`, and return the offset after it.
+/**
+ ** Returns 0 at the end of the log, or if the record doesn't decode.
+ ** `*time_base` carries the time of the record before from one call to
+ ** the next; start it at 0.
+ */
+uint16_t enclog_read(uint8_t *buf, uint16_t len, uint16_t offset,
+                     uint16_t *time_base, enclog_record_t *record) {
+    uint8_t tag;
+    uint16_t delta;
+
+    if (offset >= len || buf[offset] == ENCLOG_END) {
+        return 0;
+    }
+    tag = buf[offset++];
+    record->id = tag & ~ENCLOG_BOOPED;
+    record->last_heard = 0;
+    record->duration = 0;
+    record->boops = 0;
+
+    if (tag == ENCLOG_BOOT) {
+        *time_base = 0;
+        return offset;
+    }
+    if (record->id >= BADGES_IN_SYSTEM) {
+        return 0;
+    }
+    if (!enclog_varint_read(buf, len, &offset, &delta) ||
+            !enclog_varint_read(buf, len, &offset, &record->duration)) {
+        return 0;
+    }
+    if ((tag & ENCLOG_BOOPED) &&
+            !enclog_varint_read(buf, len, &offset, &record->boops)) {
+        return 0;
+    }
+    record->last_heard = *time_base + delta;
+    *time_base = record->last_heard;
+    return offset;
+}
+
+/// Decode the header of `block` in the log `buf`, and return the offset of its first record.
+/**
+ ** Returns 0 if the block hasn't been written, or is being overwritten.
+ ** Otherwise `*seq` is its sequence number, and `*time_base` what its first
+ ** record's time is relative to. Its records end at the next block.
+ */
+uint16_t enclog_block_read(uint8_t *buf, uint8_t block, uint16_t *seq, uint16_t *time_base) {
+    uint16_t offset = ENCLOG_BLOCK_OFFSET(block);
+
+    if (buf[offset] != ENCLOG_BLOCK) {
+        return 0;
+    }
+    *seq = buf[offset + 1] | (uint16_t) buf[offset + 2] << 8;
+    offset += 3;
+    if (!enclog_varint_read(buf, ENCLOG_BLOCK_OFFSET(block + 1), &offset, time_base)) {
+        return 0;
+    }
+    return offset;
+}
+
+/// Return the newest block in the log `buf`, and its sequence number in `*seq`.
+/**
+ ** Returns ENCLOG_BLOCKS if no block's been written.
+ */
+uint8_t enclog_newest(uint8_t *buf, uint16_t *seq) {
+    uint8_t newest = ENCLOG_BLOCKS;
+    uint16_t block_seq;
+    uint16_t time_base;
+
+    for (uint8_t block=0; block<ENCLOG_BLOCKS; block++) {
+        if (!enclog_block_read(buf, block, &block_seq, &time_base)) {
+            continue;
+        }
+        if (newest == ENCLOG_BLOCKS || (int16_t) (block_seq - *seq) > 0) {
+            newest = block;
+            *seq = block_seq;
+        }
+    }
+    return newest;
+}
+
+/// Move the log on to block `block`, with sequence number `seq`, overwriting what was there.
+void enclog_block_start(uint8_t block, uint16_t seq) {
+    uint8_t header[ENCLOG_BLOCK_HEADER_MAX];
+    uint16_t offset = ENCLOG_BLOCK_OFFSET(block);
+    uint16_t end = ENCLOG_BLOCK_OFFSET(block + 1);
+    uint16_t old_seq;
+    uint16_t time_base;
+    uint16_t next;
+    uint8_t len;
+    enclog_record_t record;
+
+    // Count what we're about to lose.
+    next = enclog_block_read(enclog_data, block, &old_seq, &time_base);
+    while (next && (next = enclog_read(enclog_data, end, next, &time_base, &record))) {
+        if (record.id != ENCLOG_BOOT && enclog_overwritten < UINT16_MAX) {
+            enclog_overwritten++;
+        }
+    }
+
+    header[0] = ENCLOG_BLOCK;
+    header[1] = seq & 0xff;
+    header[2] = seq >> 8;
+    len = 3 + enclog_varint_write(&header[3], enclog_time);
+
+    // The tag goes first and comes back last, so a block's never valid
+    //  with half of what used to be there, or half its header.
+    enclog_write(offset, 0, ENCLOG_BLOCK_BYTES);
+    enclog_write(offset + 1, &header[1], len - 1);
+    enclog_write(offset, header, 1);
+
+    enclog_block = block;
+    enclog_seq = seq;
+    enclog_block_first = offset + len;
+    enclog_len = enclog_block_first;
+}
+
+/// Find the end of the log, formatting it first if it's not a log yet.
+/**
+ ** Formatting writes the whole log with interrupts off, which only happens
+ ** the first boot after it's been erased, so call this before they're on.
+ */
+void enclog_init() {
+    uint8_t header[ENCLOG_HEADER_BYTES] = {
+        ENCLOG_MAGIC & 0xff, ENCLOG_MAGIC >> 8,
+        ENCLOG_VERSION & 0xff, ENCLOG_VERSION >> 8,
+    };
+    enclog_record_t record;
+    uint16_t time_base = 0;
+    uint16_t next;
+
+    enclog_time = 0;
+    if (memcmp(enclog_data, header, ENCLOG_HEADER_BYTES)) {
+        enclog_write(ENCLOG_HEADER_BYTES, 0, ENCLOG_BYTES - ENCLOG_HEADER_BYTES);
+        enclog_block_start(0, 0);
+        enclog_write(0, header, ENCLOG_HEADER_BYTES);
+    }
+
+    enclog_block = enclog_newest(enclog_data, &enclog_seq);
+    if (enclog_block == ENCLOG_BLOCKS) {
+        // Every block was cut short; start again.
+        enclog_block_start(0, 0);
+        return;
+    }
+    enclog_block_first = enclog_block_read(enclog_data, enclog_block, &enclog_seq, &time_base);
+    enclog_len = enclog_block_first;
+    while ((next = enclog_read(enclog_data, ENCLOG_BLOCK_OFFSET(enclog_block + 1),
+                               enclog_len, &time_base, &record))) {
+        enclog_len = next;
+    }
+    enclog_time = time_base;
+}
+
+/// Stage an encounter with `id`, between the times `first_heard` and `last_heard`.
+/**
+ ** Times are in radio intervals since boot, and each encounter's
+ ** `last_heard` must be no earlier than the one before. It's committed
+ ** at the next enclog_commit().
+ */
+void enclog_encounter(uint8_t id, uint16_t first_heard, uint16_t last_heard, uint8_t boops) {
+    uint8_t *out;
+
+    if (enclog_staged_len > ENCLOG_STAGE_BYTES - 1 - ENCLOG_RECORD_MAX) {
+        enclog_commit();
+    }
+
+    out = &enclog_staged[enclog_staged_len];
+    if (!enclog_booted) {
+        *out++ = ENCLOG_BOOT;
+        enclog_booted = 1;
+    }
+    *out++ = boops ? id | ENCLOG_BOOPED : id;
+    out += enclog_varint_write(out, last_heard - enclog_last);
+    out += enclog_varint_write(out, last_heard - first_heard);
+    if (boops) {
+        out += enclog_varint_write(out, boops);
+    }
+
+    enclog_last = last_heard;
+    enclog_staged_len = out - enclog_staged;
+}
+
+/// Append the staged encounters to the log, moving on to the next block as it fills.
+void enclog_commit() {
+    uint16_t block_end;
+    uint16_t start = 0;
+    uint16_t end;
+    uint16_t next;
+    uint16_t time_base;
+    uint16_t record_time;
+    enclog_record_t record;
+
+    while (start < enclog_staged_len) {
+        block_end = ENCLOG_BLOCK_OFFSET(enclog_block + 1);
+
+        // As many whole records as fit in this block.
+        end = start;
+        time_base = enclog_time;
+        for (;;) {
+            record_time = time_base;
+            next = enclog_read(enclog_staged, enclog_staged_len, end, &record_time, &record);
+            if (!next || enclog_len + next - start > block_end) {
+                break;
+            }
+            end = next;
+            time_base = record_time;
+        }
+        if (end == start) {
+            if (enclog_len == enclog_block_first) {
+                break; // Doesn't decode, or won't fit even on its own.
+            }
+            enclog_block_start((enclog_block + 1) % ENCLOG_BLOCKS, enclog_seq + 1);
+            continue;
+        }
+
+        // The first byte goes last, so the rest is never part of the log
+        //  without the new end after it.
+        enclog_write(enclog_len + 1, &enclog_staged[start + 1], end - start - 1);
+        if (enclog_len + end - start < block_end) {
+            enclog_write(enclog_len + end - start, 0, 1);
+        }
+        enclog_write(enclog_len, &enclog_staged[start], 1);
+        enclog_len += end - start;
+        enclog_time = time_base;
+        start = end;
+    }
+    enclog_staged_len = 0;
+}
@@ -0,0 +1,81 @@
+/// Header for the encounter log.
+/**
+ ** \file enclog.h
+ ** \author George Louthan
+ ** \date   2023
+ ** \copyright (c) 2023 George Louthan @duplico. MIT License.
+ */
+
+#ifndef ENCLOG_H_
+#define ENCLOG_H_
+
+#include <stdint.h>
+
+/// Where the log lives: the top of main FRAM, kept out of FRAM in the linker command file.
+#define ENCLOG_ADDR 0xFD80
+// The image used 0x362a of main FRAM's 0x3b80 bytes before there was a log,
+//  so it's a small one, which holds only the last hundred or so encounters.
+//  Nothing since has been linked for the MSP430: check the map file before
+//  growing it.
+/// Size of the log, including its header; must match ENCLOG in the linker command file.
+#define ENCLOG_BYTES 0x0200
+/// Marks a formatted log, at the start of its header.
+#define ENCLOG_MAGIC 0x4C45
+/// Layout version of the log; bump it if the records change.
+#define ENCLOG_VERSION 2
+/// Bytes of header (magic and version) before the first block.
+#define ENCLOG_HEADER_BYTES 4
+/// Blocks in the ring; when the log's full, the oldest is overwritten.
+#define ENCLOG_BLOCKS 8
+/// Bytes in each block, including its own header.
+#define ENCLOG_BLOCK_BYTES ((ENCLOG_BYTES - ENCLOG_HEADER_BYTES) / ENCLOG_BLOCKS)
+/// Offset of block `n` in the log.
+#define ENCLOG_BLOCK_OFFSET(n) (ENCLOG_HEADER_BYTES + (n) * ENCLOG_BLOCK_BYTES)
+/// Most bytes a block's header takes: its tag, sequence number, and a 16-bit varint.
+#define ENCLOG_BLOCK_HEADER_MAX 6
+/// Most bytes one encounter takes: its tag and three 16-bit varints.
+#define ENCLOG_RECORD_MAX 10
+/// Bytes of records that can be staged in RAM between commits.
+#define ENCLOG_STAGE_BYTES 64
+
+// Record tags. An encounter's tag is the peer's ID, which is always under
+//  BADGES_IN_SYSTEM, with ENCLOG_BOOPED set if a boop count follows.
+/// Tag that starts a block's header, and nothing else.
+#define ENCLOG_BLOCK 0x7e
+/// Tag for the boot marker: the time base of the records after it restarts.
+#define ENCLOG_BOOT 0x7f
+/// Tag bit for an encounter that has a boop count.
+#define ENCLOG_BOOPED 0x80
+/// Tag where the log ends: unwritten (erased) FRAM.
+#define ENCLOG_END 0xff
+
+/// One record of the log, as enclog_read() decodes it.
+/**
+ ** Times are in radio intervals (RADIO_BEACON_INTERVAL_SECS each) since
+ ** the last boot marker. An encounter is logged once the peer ages out,
+ ** so encounters are in order of when they were last heard.
+ */
+typedef struct {
+    /// The peer's badge ID, or ENCLOG_BOOT.
+    uint8_t id;
+    /// When the peer was last heard.
+    uint16_t last_heard;
+    /// How long the peer was in range, from first heard to last heard.
+    uint16_t duration;
+    /// Boops heard from the peer while it was in range.
+    uint16_t boops;
+} enclog_record_t;
+
+extern uint8_t enclog_data[ENCLOG_BYTES];
+extern uint16_t enclog_len;
+extern uint16_t enclog_overwritten;
+
+void enclog_init();
+void enclog_encounter(uint8_t id, uint16_t first_heard, uint16_t last_heard, uint8_t boops);
+void enclog_commit();
+uint16_t enclog_read(uint8_t *buf, uint16_t len, uint16_t offset,
+                     uint16_t *time_base, enclog_record_t *record);
+uint16_t enclog_block_read(uint8_t *buf, uint8_t block, uint16_t *seq, uint16_t *time_base);
+uint8_t enclog_newest(uint8_t *buf, uint16_t *seq);
+
+#endif /* ENCLOG_H_ */
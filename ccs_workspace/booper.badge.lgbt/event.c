@@ -0,0 +1,172 @@
+/// The main loop's event queue, with priorities and latency accounting.
+/**
+ ** Interrupts (and anything else) post events here, and the main loop
+ ** takes them off the queue one at a time, highest priority first, and
+ ** handles them. The queue is just a bit per event type, so posting one
+ ** that's already pending merges the two, the same as the flags it
+ ** replaces; the handlers all deal with however much has piled up.
+ **
+ ** The main loop sleeps through event_sleep(), which checks the queue and
+ ** sleeps in one step with interrupts off, so an event posted just before
+ ** it sleeps can't be missed until the next wake.
+ **
+ ** Every event is timed, on Timer_A1 counting SMCLK/8 (1 us), from its
+ ** post to its handler starting (its queueing delay), and from there to
+ ** event_done() (its run time). The longest of each, and histograms of
+ ** both, are in event_stats for tuning, e.g. from the debugger's memory
+ ** browser. An event is always handled before we sleep again, so neither
+ ** time ever spans a sleep, and Timer_A1 is stopped while we're asleep;
+ ** otherwise its request for SMCLK would keep the DCO running in LPM3.
+ **
+ ** event_now() is a separate, slower clock, on Timer_A0 counting ACLK,
+ ** which keeps counting through every LPM we use, for timing the boot.
+ **
+ ** \file event.c
+ ** \author George Louthan
+ ** \date   2023
+ ** \copyright (c) 2023 George Louthan @duplico. MIT License.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include <msp430fr2633.h>
+
+#include "event.h"
+
+/// One bit per pending event type, by its priority.
+volatile uint16_t event_pending = 0;
+/// What's been measured about each event type.
+event_stats_t event_stats[EVENT_COUNT];
+/// Timer count when each pending event was first posted.
+uint16_t event_posted_at[EVENT_COUNT];
+/// Timer count when the handler for the current event started.
+uint16_t event_started_at = 0;
+
+/// Start the timers event_now() and the event timings are counted on.
+void event_init() {
+    // Continuous mode on ACLK, which runs in every LPM we use. It has no
+    //  interrupts; we just read the count.
+    TA0CTL = TASSEL__ACLK | MC__CONTINUOUS | TACLR;
+    // Likewise on SMCLK/8, until we first sleep.
+    TA1CTL = TASSEL__SMCLK | ID__8 | MC__CONTINUOUS | TACLR;
+    event_stats_clear();
+}
+
+/// Keep the event timings in microseconds, with SMCLK divided by 2 to the power of `shift`.
+void event_smclk_div_shift(uint8_t shift) {
+    TA1CTL = (TA1CTL & ~ID) | (ID__8 - (shift << 6));
+}
+
+/// Zero every event's stats.
+void event_stats_clear() {
+    memset(event_stats, 0, sizeof(event_stats));
+}
+
+/// Read the event timings' timer, in microseconds.
+uint16_t event_timer() {
+    return TA1R; // It counts in step with MCLK, so it reads in one go.
+}
+
+/// Read Timer_A0, in ACLK counts; it counts asynchronously to MCLK.
+uint16_t event_now() {
+    uint16_t count;
+
+    // Read it until it holds still, per the family user's guide.
+    do {
+        count = TA0R;
+    } while (count != TA0R);
+    return count;
+}
+
+/// Add one to `count`, unless it's full.
+void event_count(uint16_t *count) {
+    if (*count != 0xffff) {
+        (*count)++;
+    }
+}
+
+/// Put `counts` into `hist` (see event_stats_t), and into `max` if it's longer.
+void event_record(uint16_t *hist, uint16_t *max, uint16_t counts) {
+    uint8_t bucket = 0;
+
+    while (counts >> bucket && bucket < EVENT_HIST_BUCKETS - 1) {
+        bucket++;
+    }
+    event_count(&hist[bucket]);
+    if (counts > *max) {
+        *max = counts;
+    }
+}
+
+/// Post `event` to the queue; this is safe from an ISR or the main loop.
+/**
+ ** An ISR still has to wake the main loop itself, as it always did.
+ */
+void event_post(uint8_t event) {
+    uint16_t sr = __get_SR_register();
+
+    __bic_SR_register(GIE);
+    TA1CTL |= MC__CONTINUOUS; // If we just woke, it's been stopped.
+    if (event_pending & (1 << event)) {
+        event_count(&event_stats[event].merged);
+    } else {
+        event_posted_at[event] = event_timer();
+        event_pending |= 1 << event;
+        event_count(&event_stats[event].queued);
+    }
+    __bis_SR_register(sr & GIE);
+}
+
+/// Take the highest priority event off the queue, or return EVENT_NONE.
+/**
+ ** Call event_done() with it once it's been handled.
+ */
+uint8_t event_next() {
+    uint16_t sr = __get_SR_register();
+    uint8_t event = 0;
+    uint16_t delay;
+
+    __bic_SR_register(GIE);
+    if (!event_pending) {
+        __bis_SR_register(sr & GIE);
+        return EVENT_NONE;
+    }
+
+    while (!(event_pending & (1 << event))) {
+        event++;
+    }
+    event_pending &= ~(1 << event);
+    event_started_at = event_timer();
+    // Once it's off the queue, an ISR can post it again over its post time.
+    delay = event_started_at - event_posted_at[event];
+    __bis_SR_register(sr & GIE);
+
+    event_record(event_stats[event].delay_hist, &event_stats[event].delay_max,
+                 delay);
+    return event;
+}
+
+/// Record how long the handler for `event`, from event_next(), ran.
+void event_done(uint8_t event) {
+    event_record(event_stats[event].run_hist, &event_stats[event].run_max,
+                 event_timer() - event_started_at);
+}
+
+/// Sleep in the low-power mode `lpm_bits` if, and only if, no event is pending.
+/**
+ ** Interrupts go off to check the queue, and come back on with the same
+ ** write to SR that puts us to sleep, so any ISR that posts an event after
+ ** the check runs after we're asleep, and wakes us back up. They can be
+ ** off already, if the caller has its own checks to make first.
+ */
+void event_sleep(uint16_t lpm_bits) {
+    __bic_SR_register(GIE);
+    if (event_pending) {
+        __bis_SR_register(GIE);
+        return;
+    }
+    TA1CTL &= ~MC; // Nothing to time until the next post.
+    __bis_SR_register(GIE | lpm_bits);
+    __no_operation();
+}
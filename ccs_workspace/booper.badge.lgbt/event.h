@@ -0,0 +1,72 @@
+/// Header for the main loop's event queue.
+/**
+ ** \file event.h
+ ** \author George Louthan
+ ** \date   2023
+ ** \copyright (c) 2023 George Louthan @duplico. MIT License.
+ */
+
+#ifndef EVENT_H_
+#define EVENT_H_
+
+#include <stdint.h>
+
+// Event types, highest priority first.
+
+/// The RFM75's IRQ pin: a packet, or the end of a transmission.
+#define EVENT_RADIO 0
+/// The sniffer's UART is done with a chunk (sniffer builds only).
+#define EVENT_SNIFFER 1
+/// CapTIvate's scan timer: time to update the touch button (posted by main.c).
+#define EVENT_TOUCH 2
+/// The RTC's period ended: time to catch up and run the timers.
+#define EVENT_TICK 3
+/// A second boundary went by: the 1 Hz housekeeping.
+#define EVENT_SECOND 4
+/// Number of event types.
+#define EVENT_COUNT 5
+/// What event_next() returns when nothing is pending.
+#define EVENT_NONE 0xff
+
+/// Timer counts per second for the event timings: SMCLK/8, 1 us each.
+#define EVENT_COUNTS_PER_SEC 1000000
+/// Buckets in each histogram, in powers of 2 counts; see event_stats_t.
+#define EVENT_HIST_BUCKETS 16
+
+/// What's been measured about one type of event, since event_stats_clear().
+/**
+ ** Times are in microseconds (EVENT_COUNTS_PER_SEC). Histogram bucket 0 is
+ ** for times under 1 us, bucket 1 for 1 us, and each bucket `i` after
+ ** that for 2^(i-1) up to 2^i us, except the last, which takes everything
+ ** longer (16 ms and up). The timer wraps every 65.5 ms, so anything
+ ** longer than that is counted short. The counters all stick at 0xffff
+ ** rather than wrapping.
+ */
+typedef struct {
+    /// Times it was posted while it wasn't already pending.
+    uint16_t queued;
+    /// Times it was posted while it already was, and merged into that one.
+    uint16_t merged;
+    /// Longest it's waited in the queue, from its post to its handler.
+    uint16_t delay_max;
+    /// Longest its handler has run.
+    uint16_t run_max;
+    /// How long it's waited in the queue.
+    uint16_t delay_hist[EVENT_HIST_BUCKETS];
+    /// How long its handler has run.
+    uint16_t run_hist[EVENT_HIST_BUCKETS];
+} event_stats_t;
+
+extern volatile uint16_t event_pending;
+extern event_stats_t event_stats[EVENT_COUNT];
+
+void event_init();
+void event_smclk_div_shift(uint8_t shift);
+uint16_t event_now();
+void event_post(uint8_t event);
+uint8_t event_next();
+void event_done(uint8_t event);
+void event_sleep(uint16_t lpm_bits);
+void event_stats_clear();
+
+#endif /* EVENT_H_ */
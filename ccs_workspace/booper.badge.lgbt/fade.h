@@ -0,0 +1,39 @@
+/// Header for the fixed-point LED fade engine.
+/**
+ ** \file fade.h
+ ** \author George Louthan
+ ** \date   2023
+ ** \copyright (c) 2023 George Louthan @duplico. MIT License.
+ */
+
+#ifndef FADE_H_
+#define FADE_H_
+
+#include <stdint.h>
+
+/// Longest fade, in ticks, that fade_to() will do; longer ones are clamped.
+#define FADE_MAX_TICKS 100
+/// Perceptual level of a channel that's all the way on.
+#define FADE_LEVEL_ON 0xff
+
+/// One channel's fade, in perceptual levels rather than grayscale.
+typedef struct {
+    /// Current level, in 8.8 fixed point; the integer part is 0..255.
+    uint16_t level;
+    /// Amount added to `level` every tick, while `ticks` is nonzero.
+    int16_t step;
+    /// Ticks left in the fade; it lands exactly on `target` on the last.
+    uint8_t ticks;
+    /// Level we're fading to.
+    uint8_t target;
+} fade_t;
+
+extern const uint16_t fade_gamma[256];
+
+void fade_to(fade_t *fade, uint8_t target, uint8_t ticks);
+uint8_t fade_step(fade_t *fades, uint8_t count);
+uint8_t fade_next_change(fade_t *fades, uint8_t count);
+void fade_skip(fade_t *fades, uint8_t count, uint8_t ticks);
+uint16_t fade_gs(uint16_t level, uint16_t brightness);
+
+#endif /* FADE_H_ */
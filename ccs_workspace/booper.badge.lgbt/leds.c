@@ -11,148 +11,506 @@
  ** \copyright (c) 2023 George Louthan @duplico. MIT License.
  */
 
-#include <stdlib.h>
+#include <string.h>
+
+#include <msp430fr2633.h>
 
 #include "badge.h"
 #include "leds.h"
 #include "tlc5948a.h"
 #include "animations.h"
 #include "eyes.h"
+#include "fade.h"
+#include "persist.h"
+#include "rng.h"
 
 // General configuration of the 7-segs
-/// The standard brightness of the LEDs.
-uint16_t leds_brightness = BADGE_BRIGHTNESS_1;
+/// Grayscale for a fully lit LED at the current brightness level.
+uint16_t leds_brightness = 0;
+/// The current level of leds_brightness_ladder.
+uint8_t leds_brightness_level = BADGE_BRIGHTNESS_1;
+
+// The levels are evenly spaced to the eye. Each one comes down in LED current
+//  first, and only then in grayscale, so even the dim levels fade over
+//  thousands of codes. Generated by programming/gen_brightness_ladder.py.
+
+/// BC, DC scale and grayscale ceiling for each brightness level.
+const leds_brightness_t leds_brightness_ladder[LEDS_BRIGHTNESS_LEVELS] = {
+        {0x00,  32, 0x0ff0}, //  0:   0.39% light,   6.25% current
+        {0x00,  32, 0x16f9}, //  1:   0.56% light,   6.25% current
+        {0x00,  32, 0x211d}, //  2:   0.81% light,   6.25% current
+        {0x00,  32, 0x2fbb}, //  3:   1.17% light,   6.25% current
+        {0x00,  32, 0x44cd}, //  4:   1.68% light,   6.25% current
+        {0x00,  32, 0x632c}, //  5:   2.42% light,   6.25% current
+        {0x00,  32, 0x8ef3}, //  6:   3.49% light,   6.25% current
+        {0x00,  32, 0xce0e}, //  7:   5.03% light,   6.25% current
+        {0x00,  38, 0xfa1d}, //  8:   7.25% light,   7.42% current
+        {0x00,  54, 0xfdb4}, //  9:  10.45% light,  10.55% current
+        {0x00,  78, 0xfd2c}, // 10:  15.07% light,  15.23% current
+        {0x00, 112, 0xfe26}, // 11:  21.72% light,  21.88% current
+        {0x0b, 128, 0xfe6f}, // 12:  31.30% light,  31.50% current
+        {0x23, 128, 0xfcee}, // 13:  45.12% light,  45.67% current
+        {0x44, 128, 0xff89}, // 14:  65.04% light,  65.16% current
+        {0x75, 128, 0xff10}, // 15:  93.75% light,  94.09% current
+};
 
 // Eye animations
 /// The current display configuration of the eyes.
 eye_t leds_eyes_curr[2] = {0, }; // Start all off
 
-#pragma PERSISTENT(leds_eyes_ambient)
 /// The ambient eye display to return to after an animation completes.
+/**
+ ** This is persistent, loaded and saved by persist.c.
+ */
 uint8_t leds_eyes_ambient = EYES_NORMAL;
 /// The current animation, or null if there is no current animation.
 eye_anim_t *eye_anim_curr = 0x0000;
-/// The number of loops left to do in the current animation.
-uint8_t eye_anim_curr_loops;
-/// The current frame number of the current animation.
-uint8_t eye_anim_curr_frame;
-/// The number of LED timesteps remaining in the current animation frame.
-uint8_t eye_anim_curr_ticks;
+/// The next op to run in the current animation.
+eye_anim_t *eye_anim_pc;
+/// How long each frame of the current animation shows, in LED timesteps.
+uint8_t eye_anim_dur;
+/// Where each repeat that we're inside of starts.
+eye_anim_t *eye_anim_repeat_start[ANIM_REPEAT_DEPTH];
+/// How many more times to play each repeat we're inside of.
+uint8_t eye_anim_repeat_left[ANIM_REPEAT_DEPTH];
+/// How many repeats we're inside of.
+uint8_t eye_anim_repeat_depth;
 /// Whether to blink between the end of this animation and ambient eyes.
 uint8_t eye_anim_blink_transition;
 
-/// The temporary ambient eyes
-eye_t leds_eyes_ambient_temp[2] = {0, };
-/// How many more ticks to show the temporary ambient eyes
-uint16_t leds_eyes_ambient_temp_ticks = 0;
+/// The segments around each eye, clockwise from the top left.
+const uint8_t leds_eye_ring[6] = {0, 5, 6, 7, 2, 1};
+/// The figure-eight round both eyes, as eye*8 + segment.
+const uint8_t leds_chase_path[10] = {1, 2, 7, 10, 15, 14, 13, 8, 5, 0};
 
-/// Number of LED timesteps remaining in the current blink animation
-uint8_t eye_blinking = 0;
+// Compositor
+/// The eye display layers, from LEDS_LAYER_AMBIENT up to LEDS_LAYER_ALERT.
+/**
+ ** The eyes show the highest active layer, and the scan dot goes over
+ ** everything but an alert. Only the shown layer's ticks count down; the
+ ** layers under it wait their turn, the same way an animation waits for
+ ** the blink in front of it to finish.
+ */
+leds_layer_t leds_layers[LEDS_LAYER_COUNT] = {{{{0,}}}};
+/// Bitmask of the layers that have changed since the eyes were composed.
+uint8_t leds_layers_dirty = 0;
 
 // Dot-scanner animations
 /// Current scan speed, where 0 is off but otherwise higher is slower. 80 = about 1 second.
 uint16_t leds_scan_speed = 0; // 8..80 inclusive is a good range here.
-/// The brightness of the scan dots, although this can be overridden by leds_eyes_curr.
-uint16_t leds_dot_level[] = {0x0000, 0x0000};
+/// The scan dots, although leds_eyes_curr can override them.
+fade_t leds_scan_fades[2] = {{0,}};
 /// Which eye's scan dot is currently on (and fading out).
 uint8_t scan_dot_curr = 0;
 
+// Fades
+/// Every channel's fade toward what leds_eyes_curr says.
+fade_t leds_fades[16] = {{0,}};
+/// Ticks to crossfade from one frame to the next; 0 for a hard cut.
+/**
+ ** This starts out at 0, so that anything shown before the main loop is
+ ** ticking the fades shows up right away.
+ */
+uint8_t leds_fade_ticks = 0;
+
+/// Number of grayscale frames computed by leds_load_gs().
+uint32_t leds_frames_computed = 0;
+/// Number of those frames that differed from the last, and were sent.
+uint32_t leds_frames_sent = 0;
+
+// Current budget
+/// Each channel's current at full grayscale and the current brightness, in uA.
+uint16_t leds_channel_ua[16] = {0, };
+/// The most current we let the LEDs draw, in uA, or 0 for no limit.
+/**
+ ** Any frame that would go over this is dimmed, every LED in proportion,
+ ** until it fits. That keeps a face full of lit segments at the top
+ ** brightness from drawing down the battery far faster than the rest.
+ */
+uint32_t leds_budget_ua = LEDS_BUDGET_UA;
+/// The estimated current of the last frame computed, after any limiting.
+uint32_t leds_current_ua = 0;
+/// Number of frames computed that went over budget, and were dimmed.
+uint32_t leds_frames_limited = 0;
+/// Estimated charge drawn by the LEDs since power-on.
+leds_charge_t leds_charge_used = {0, };
+/// Charge the LEDs would have drawn at leds_budget_ua the whole time.
+leds_charge_t leds_charge_budget = {0, };
+
 /// Helper function to return what the current ambient eye display should be.
 eye_t eye_ambient(uint8_t eye_index) {
-    if (leds_eyes_ambient_temp_ticks) {
-        return leds_eyes_ambient_temp[eye_index];
+    if (leds_layers[LEDS_LAYER_TEMP].active) {
+        return leds_layers[LEDS_LAYER_TEMP].eyes[eye_index];
     }
 
-    return EYES_DISP[leds_eyes_ambient][eye_index];
+    return leds_layers[LEDS_LAYER_AMBIENT].eyes[eye_index];
 }
 
-/// Stage the eye data into the TLC grayscale data, and send it to the LED driver.
+/// Turn the fades into grayscale data, and send it to the LED driver.
+/**
+ ** tlc_gs_data always holds the last frame we sent, so if the new frame is
+ ** the same (say, a scan step that didn't change anything we can see), we
+ ** skip the transfer altogether. This is also where the frame's current
+ ** is estimated, and held to leds_budget_ua.
+ */
+void leds_render() {
+    uint16_t gs[16];
+    uint32_t ua = 0;
+    uint8_t scanning = leds_scan_speed && !leds_layers[LEDS_LAYER_ALERT].active;
+
+    for (uint8_t i=0; i<16; i++) {
+        uint16_t level = leds_fades[i].level;
+
+        if ((i & 7) == 4 && scanning && leds_scan_fades[i >> 3].level > level) {
+            // The dot: the scanner's, unless the eyes want it brighter.
+            level = leds_scan_fades[i >> 3].level;
+        }
+        gs[i] = level ? fade_gs(level, leds_brightness) : 0;
+        ua += ((uint32_t) leds_channel_ua[i] * gs[i]) >> 16;
+    }
+    leds_frames_computed++;
+
+    if (leds_budget_ua && ua > leds_budget_ua) {
+        // Grayscale is linear in current, so scale it all by budget/ua.
+        uint32_t budget = leds_budget_ua;
+        uint16_t scale;
+
+        while (ua > 0xffff) {
+            ua >>= 1;
+            budget >>= 1;
+        }
+        scale = (budget << 16) / ua;
+        for (uint8_t i=0; i<16; i++) {
+            gs[i] = ((uint32_t) gs[i] * scale) >> 16;
+        }
+        ua = leds_budget_ua;
+        leds_frames_limited++;
+    }
+    leds_current_ua = ua;
+
+    if (!memcmp(gs, tlc_gs_data, sizeof(gs))) {
+        return; // Nothing to see here.
+    }
+
+    memcpy(tlc_gs_data, gs, sizeof(gs));
+    leds_frames_sent++;
+    tlc_set_gs();
+}
+
+/// Add `ticks` timesteps of drawing `ua` to a charge tally.
+void leds_charge_add(leds_charge_t *charge, uint32_t ua, uint16_t ticks) {
+    // A second at a time, so a long skip at full current can't overflow.
+    while (ticks) {
+        uint8_t step = ticks > 100 ? 100 : ticks;
+
+        charge->uacsecs += ua * step;
+        if (charge->uacsecs >= LEDS_UACSECS_PER_UAH) {
+            charge->uah += charge->uacsecs / LEDS_UACSECS_PER_UAH;
+            charge->uacsecs %= LEDS_UACSECS_PER_UAH;
+        }
+        ticks -= step;
+    }
+}
+
+/// Tally the charge the LEDs draw, and could have drawn, over `ticks`.
+void leds_charge_tally(uint16_t ticks) {
+    leds_charge_add(&leds_charge_used, leds_current_ua, ticks);
+    leds_charge_add(&leds_charge_budget, leds_budget_ua, ticks);
+}
+
+/// Fade to the eye data in leds_eyes_curr, and send the first step of it.
 void leds_load_gs() {
     for (uint8_t eye = 0; eye <= 1; eye++) {
-        tlc_gs_data[eye*8 + 0] = leds_eyes_curr[eye].tl ? leds_brightness : 0;
-        tlc_gs_data[eye*8 + 1] = leds_eyes_curr[eye].l ? leds_brightness : 0;
-        tlc_gs_data[eye*8 + 2] = leds_eyes_curr[eye].bl ? leds_brightness : 0;
-        tlc_gs_data[eye*8 + 3] = leds_eyes_curr[eye].m ? leds_brightness : 0;
-        // Index offset 4 is the dot - handled below.
-        tlc_gs_data[eye*8 + 5] = leds_eyes_curr[eye].tr ? leds_brightness : 0;
-        tlc_gs_data[eye*8 + 6] = leds_eyes_curr[eye].r ? leds_brightness : 0;
-        tlc_gs_data[eye*8 + 7] = leds_eyes_curr[eye].br ? leds_brightness : 0;
-
-        // Handle the dot:
-        if (leds_eyes_curr[eye].dot) {
-            // If the current eye setup says it should be on, then force it on.
-            tlc_gs_data[eye*8 + 4] = leds_brightness;
-        } else if (leds_scan_speed) {
-            // Otherwise, follow their dot level variable.
-            tlc_gs_data[eye*8 + 4] = leds_dot_level[eye];
-        } else {
-            tlc_gs_data[eye*8 + 4] = 0x0000;
+        // In channel order; index offset 4 is the dot.
+        uint8_t on[8] = {
+            leds_eyes_curr[eye].tl, leds_eyes_curr[eye].l,
+            leds_eyes_curr[eye].bl, leds_eyes_curr[eye].m,
+            leds_eyes_curr[eye].dot, leds_eyes_curr[eye].tr,
+            leds_eyes_curr[eye].r, leds_eyes_curr[eye].br,
+        };
+
+        for (uint8_t i=0; i<8; i++) {
+            uint8_t target = on[i] ? FADE_LEVEL_ON : 0;
+
+            if (leds_fades[eye*8 + i].target != target) {
+                fade_to(&leds_fades[eye*8 + i], target, leds_fade_ticks);
+            }
         }
     }
 
-    tlc_set_gs();
+    leds_render();
+}
+
+/// Move every fade along a tick, and send the result if anything changed.
+/**
+ ** leds_timestep() does this itself; call this at 100 Hz instead of it when
+ ** the rest of the LED animation system isn't running.
+ */
+void leds_fade_timestep() {
+    leds_charge_tally(1);
+    if (fade_step(leds_fades, 16) | fade_step(leds_scan_fades, 2)) {
+        leds_render();
+    }
+}
+
+/// Return the highest active layer, which is the one on the eyes.
+uint8_t leds_layer_top() {
+    uint8_t layer = LEDS_LAYER_COUNT - 1;
+
+    while (layer && !leds_layers[layer].active) {
+        layer--;
+    }
+
+    return layer;
+}
+
+/// Take down a layer, uncovering whatever is under it.
+void leds_layer_hide(uint8_t layer) {
+    if (leds_layers[layer].active) {
+        leds_layers[layer].active = 0;
+        leds_layers_dirty |= BIT0 << layer;
+    }
+}
+
+/// Show a layer for `ticks` timesteps while it's on top, or LEDS_LAYER_HOLD.
+/**
+ ** A held alert is only there until something else comes along, so
+ ** showing anything on a lower layer takes it down.
+ */
+void leds_layer_show(uint8_t layer, eye_t left, eye_t right, uint16_t ticks) {
+    leds_layers[layer].eyes[0] = left;
+    leds_layers[layer].eyes[1] = right;
+    leds_layers[layer].ticks = ticks;
+    leds_layers[layer].active = 1;
+    leds_layers_dirty |= BIT0 << layer;
+
+    if (layer < LEDS_LAYER_ALERT && leds_layers[LEDS_LAYER_ALERT].ticks == LEDS_LAYER_HOLD) {
+        leds_layer_hide(LEDS_LAYER_ALERT);
+    }
+}
+
+/// Put the top layer on the eyes, if any layer that shows has changed.
+/**
+ ** \return 1 if it sent a new frame, 0 if there was nothing new to see.
+ */
+uint8_t leds_compose() {
+    uint8_t top = leds_layer_top();
+    // Changes under the top layer don't show.
+    uint8_t changed = (leds_layers_dirty >> top) != 0;
+
+    leds_layers_dirty = 0;
+    if (!changed) {
+        return 0;
+    }
+
+    leds_eyes_curr[0] = leds_layers[top].eyes[0];
+    leds_eyes_curr[1] = leds_layers[top].eyes[1];
+    leds_load_gs();
+    return 1;
 }
 
 /// Blink the eyes.
 void do_blink() {
-    eye_blinking = BLINK_TICKS;
-    leds_eyes_curr[0] = EYE_OFF;
-    leds_eyes_curr[1] = EYE_OFF;
+    eye_t closed[2] = {EYE_OFF, EYE_OFF};
 
     for (uint8_t eye=0; eye<2; eye++) {
         if (eye_ambient(eye).bl || eye_ambient(eye).l || eye_ambient(eye).tl) {
-            leds_eyes_curr[eye].bl = 1;
+            closed[eye].bl = 1;
         }
         if (eye_ambient(eye).br || eye_ambient(eye).r || eye_ambient(eye).tr) {
-            leds_eyes_curr[eye].br = 1;
+            closed[eye].br = 1;
         }
     }
 
-    leds_load_gs();
+    leds_layer_show(LEDS_LAYER_BLINK, closed[0], closed[1], BLINK_TICKS);
+}
+
+/// An eye_t as the byte that animations use.
+typedef union {
+    eye_t eye;
+    uint8_t bits; // Both compilers put the first bitfield in bit 0.
+} eye_bits_t;
+
+/// Turn an eye's outer ring `steps` segments clockwise.
+uint8_t leds_eye_rotate(uint8_t bits, uint8_t steps) {
+    uint8_t out = bits & (BIT3 | BIT4); // The middle and the dot stay put.
+
+    for (uint8_t i=0; i<6; i++) {
+        if (bits & (BIT0 << leds_eye_ring[i])) {
+            out |= BIT0 << leds_eye_ring[(i + steps) % 6];
+        }
+    }
+
+    return out;
+}
+
+/// Flip an eye left-to-right.
+uint8_t leds_eye_mirror(uint8_t bits) {
+    return (bits & (BIT3 | BIT4)) | ((bits & 0x07) << 5) | ((bits & 0xe0) >> 5);
 }
 
-/// Cycle through the available brightness levels, one per function call.
+/// Move every lit segment on the figure-eight a step along it.
+void leds_eyes_chase(uint8_t *bits) {
+    uint16_t eyes = bits[0] | (bits[1] << 8);
+    uint16_t out = eyes;
+
+    for (uint8_t i=0; i<10; i++) {
+        out &= ~(BIT0 << leds_chase_path[i]);
+    }
+    for (uint8_t i=0; i<10; i++) {
+        if (eyes & (BIT0 << leds_chase_path[i])) {
+            out |= BIT0 << leds_chase_path[i == 9 ? 0 : i + 1];
+        }
+    }
+
+    bits[0] = out & 0xff;
+    bits[1] = out >> 8;
+}
+
+/// Run the current animation up to its next frame and show it, or end it.
+void leds_anim_next() {
+    eye_bits_t eyes[2];
+    uint8_t bits[2];
+
+    eyes[0].eye = leds_layers[LEDS_LAYER_ANIM].eyes[0];
+    eyes[1].eye = leds_layers[LEDS_LAYER_ANIM].eyes[1];
+    bits[0] = eyes[0].bits;
+    bits[1] = eyes[1].bits;
+
+    while (1) {
+        uint8_t op = *eye_anim_pc++;
+
+        if (op & ANIM_DUR_SHORT) {
+            eye_anim_dur = op & ~ANIM_DUR_SHORT;
+            continue;
+        }
+        if (op & ANIM_ROTATE) {
+            bits[0] = leds_eye_rotate(bits[0], op & ~ANIM_ROTATE);
+            bits[1] = leds_eye_rotate(bits[1], op & ~ANIM_ROTATE);
+            break;
+        }
+
+        switch (op) {
+        case ANIM_REPEAT:
+            eye_anim_repeat_left[eye_anim_repeat_depth] = *eye_anim_pc++;
+            eye_anim_repeat_start[eye_anim_repeat_depth] = eye_anim_pc;
+            eye_anim_repeat_depth++;
+            continue;
+        case ANIM_NEXT:
+            if (--eye_anim_repeat_left[eye_anim_repeat_depth-1]) {
+                eye_anim_pc = eye_anim_repeat_start[eye_anim_repeat_depth-1];
+            } else {
+                eye_anim_repeat_depth--;
+            }
+            continue;
+        case ANIM_DUR:
+            eye_anim_dur = *eye_anim_pc++;
+            continue;
+        case ANIM_SHOW:
+            bits[0] = *eye_anim_pc++;
+            bits[1] = *eye_anim_pc++;
+            break;
+        case ANIM_BOTH:
+            bits[0] = bits[1] = *eye_anim_pc++;
+            break;
+        case ANIM_LEFT:
+            bits[0] = *eye_anim_pc++;
+            break;
+        case ANIM_RIGHT:
+            bits[1] = *eye_anim_pc++;
+            break;
+        case ANIM_TOGGLE:
+            bits[0] ^= *eye_anim_pc++;
+            bits[1] ^= *eye_anim_pc++;
+            break;
+        case ANIM_MIRROR:
+            bits[0] = leds_eye_mirror(bits[0]);
+            bits[1] = leds_eye_mirror(bits[1]);
+            break;
+        case ANIM_CHASE:
+            leds_eyes_chase(bits);
+            break;
+        default: // ANIM_END, or something we don't know
+            eye_anim_curr = 0x0000;
+            leds_layer_hide(LEDS_LAYER_ANIM);
+            if (eye_anim_blink_transition) {
+                do_blink();
+            }
+            return;
+        }
+        break; // Every op that gets here is a frame.
+    }
+
+    eyes[0].bits = bits[0];
+    eyes[1].bits = bits[1];
+    leds_layer_show(LEDS_LAYER_ANIM, eyes[0].eye, eyes[1].eye, eye_anim_dur);
+}
+
+/// Set the LED current and grayscale for a level of leds_brightness_ladder.
+void leds_set_brightness(uint8_t level) {
+    const leds_brightness_t *step = &leds_brightness_ladder[level];
+
+    leds_brightness_level = level;
+    leds_brightness = step->gs;
+    tlc_stage_bc(step->bc);
+    tlc_stage_dc(step->dc_scale);
+    tlc_set_fun();
+
+    // The TLC's BC takes the current from 25% at 0x00 to 100% at 0x7f, and
+    //  each channel's DC takes that from 0 to 100% at 0x7f.
+    for (uint8_t i=0; i<16; i++) {
+        leds_channel_ua[i] = (uint32_t) LEDS_CHANNEL_FULL_UA * (0x7f + 3 * step->bc) / (4 * 0x7f)
+                             * tlc_get_dc(i) / 0x7f;
+    }
+
+    // There's plenty of PWM period to spare for the dimmest level.
+    smclk_set_div_shift(level == BADGE_BRIGHTNESS_0 ? BADGE_DIM_SMCLK_DIV_SHIFT : 0);
+    leds_render();
+}
+
+/// Cycle through the button's brightness levels, one per function call.
 void leds_next_brightness() {
-    switch(leds_brightness) {
+    switch(leds_brightness_level) {
     case BADGE_BRIGHTNESS_0:
-        leds_brightness = BADGE_BRIGHTNESS_1;
+        leds_set_brightness(BADGE_BRIGHTNESS_1);
         break;
     case BADGE_BRIGHTNESS_1:
-        leds_brightness = BADGE_BRIGHTNESS_2;
+        leds_set_brightness(BADGE_BRIGHTNESS_2);
         break;
-    case BADGE_BRIGHTNESS_2:
-        leds_brightness = BADGE_BRIGHTNESS_0;
+    default:
+        leds_set_brightness(BADGE_BRIGHTNESS_0);
         break;
     }
     do_blink();
+    leds_compose();
 }
 
 /// Start an animation in the eyes, optionally blinking before and after.
 void leds_anim_start(eye_anim_t *animation, uint8_t blink_transition) {
     eye_anim_curr = animation;
-    eye_anim_curr_frame = 0;
-    eye_anim_curr_ticks = 0;
-    eye_anim_curr_loops = eye_anim_curr->loop_count;
+    eye_anim_pc = animation;
+    eye_anim_dur = 1;
+    eye_anim_repeat_depth = 0;
     eye_anim_blink_transition = blink_transition;
 
-    eye_blinking = 0; // Clear any current blink
+    leds_layer_hide(LEDS_LAYER_BLINK); // Clear any current blink
+    // Animations start from blank eyes.
+    leds_layers[LEDS_LAYER_ANIM].eyes[0] = EYE_OFF;
+    leds_layers[LEDS_LAYER_ANIM].eyes[1] = EYE_OFF;
+    leds_anim_next();
 
     if (blink_transition) {
+        // The first frame waits under the blink.
         do_blink();
-    } else {
-        leds_eyes_curr[0] = animation->frames[0].eyes[0];
-        leds_eyes_curr[1] = animation->frames[0].eyes[1];
-        leds_load_gs();
     }
+    leds_compose();
 }
 
 /// Display the boop animation.
 void leds_boop() {
-    if (eye_anim_curr != &anim_boop) {
-        leds_eyes_ambient_temp[0] = HAPPY_RIGHT;
-        leds_eyes_ambient_temp[1] = HAPPY_LEFT;
-        leds_eyes_ambient_temp_ticks = BADGE_BOOP_FACE_LEN_CSECS;
-        leds_anim_start(&anim_boop, 0);
+    if (eye_anim_curr != anim_boop) {
+        leds_layer_show(LEDS_LAYER_TEMP, HAPPY_RIGHT, HAPPY_LEFT, BADGE_BOOP_FACE_LEN_CSECS);
+        leds_anim_start(anim_boop, 0);
     }
 }
 
@@ -160,10 +518,10 @@ void leds_boop() {
 void leds_queerdar_alert(uint8_t type) {
     switch(type) {
     case LEDS_QUEERDAR_NEWBADGE:
-        leds_anim_start(&anim_new_badge, 1);
+        leds_anim_start(anim_new_badge, 1);
         break;
     case LEDS_QUEERDAR_OLDBADGE:
-        leds_anim_start(&anim_seen_badge, 1);
+        leds_anim_start(anim_seen_badge, 1);
         break;
     case LEDS_QUEERDAR_PAIRBADGE:
         // Not implemented
@@ -175,77 +533,80 @@ void leds_queerdar_alert(uint8_t type) {
 void leds_error_code(uint8_t code) {
     switch(code) {
     case BADGE_POST_ERR_NONE:
-        leds_eyes_curr[0] = CHAR_VERT_D_OR_O;
-        leds_eyes_curr[1] = CHAR_VERT_K;
+        leds_layer_show(LEDS_LAYER_ALERT, CHAR_VERT_D_OR_O, CHAR_VERT_K, LEDS_LAYER_HOLD);
         break;
     case BADGE_POST_ERR_NOID:
-        leds_eyes_curr[0] = CHAR_VERT_I;
-        leds_eyes_curr[1] = CHAR_VERT_D_LOWER;
+        leds_layer_show(LEDS_LAYER_ALERT, CHAR_VERT_I, CHAR_VERT_D_LOWER, LEDS_LAYER_HOLD);
         break;
     case BADGE_POST_ERR_NORF:
-        leds_eyes_curr[0] = CHAR_VERT_R;
-        leds_eyes_curr[1] = CHAR_VERT_F;
+        leds_layer_show(LEDS_LAYER_ALERT, CHAR_VERT_R, CHAR_VERT_F, LEDS_LAYER_HOLD);
         break;
     case BADGE_POST_ERR_FREQ:
-        leds_eyes_curr[0] = CHAR_VERT_F;
-        leds_eyes_curr[1] = CHAR_VERT_R_LOWER;
+        leds_layer_show(LEDS_LAYER_ALERT, CHAR_VERT_F, CHAR_VERT_R_LOWER, LEDS_LAYER_HOLD);
         break;
+    case BADGE_POST_ERR_LEDS:
+        // How many LEDs failed; the serial report says which.
+        leds_show_number(bitset_word_count(tlc_leds_open | tlc_leds_shorted), 0);
+        return;
     }
-    leds_load_gs();
+    leds_compose();
 }
 
 /// Display a number [00..100], oriented 90 degrees from our usual angle.
+/**
+ ** The number stays up for `make_temp_ambient` timesteps, or if that's 0,
+ ** until the eyes do something else.
+ */
 void leds_show_number(uint8_t number, uint16_t make_temp_ambient) {
+    uint16_t ticks = make_temp_ambient ? make_temp_ambient : LEDS_LAYER_HOLD;
+
     if (number == 100) {
-        leds_eyes_curr[0] = (eye_t) {0,1,0,1,0,1,1,1}; // i o
-        leds_eyes_curr[1] = (eye_t) {1,1,1,1,0,0,0,0};//      o
+        leds_layer_show(LEDS_LAYER_ALERT,
+                        (eye_t) {0,1,0,1,0,1,1,1}, // i o
+                        (eye_t) {1,1,1,1,0,0,0,0}, //      o
+                        ticks);
     } else {
-        leds_eyes_curr[0] = EYES_DIGITS[number/10];
-        leds_eyes_curr[1] = EYES_DIGITS[number%10];
-    }
-    leds_load_gs();
-
-    if (make_temp_ambient) {
-        leds_eyes_ambient_temp_ticks = make_temp_ambient;
-        leds_eyes_ambient_temp[0] = leds_eyes_curr[0];
-        leds_eyes_ambient_temp[1] = leds_eyes_curr[1];
+        leds_layer_show(LEDS_LAYER_ALERT, EYES_DIGITS[number/10], EYES_DIGITS[number%10], ticks);
     }
+    leds_compose();
 }
 
 /// Cycle through the LEDs, roughly left to right, to test them all.
 void leds_post_step() {
     static uint8_t eye_index = 0;
     static uint8_t led_index = 0;
+    eye_t eyes[2];
 
-    leds_eyes_curr[!eye_index] = EYE_OFF;
+    eyes[!eye_index] = EYE_OFF;
     switch(led_index) {
     case 0:
-        leds_eyes_curr[eye_index] = ONLY_L;
+        eyes[eye_index] = ONLY_L;
         break;
     case 1:
-        leds_eyes_curr[eye_index] = ONLY_UL;
+        eyes[eye_index] = ONLY_UL;
         break;
     case 2:
-        leds_eyes_curr[eye_index] = ONLY_LL;
+        eyes[eye_index] = ONLY_LL;
         break;
     case 3:
-        leds_eyes_curr[eye_index] = ONLY_M;
+        eyes[eye_index] = ONLY_M;
         break;
     case 4:
-        leds_eyes_curr[eye_index] = ONLY_UR;
+        eyes[eye_index] = ONLY_UR;
         break;
     case 5:
-        leds_eyes_curr[eye_index] = ONLY_LR;
+        eyes[eye_index] = ONLY_LR;
         break;
     case 6:
-        leds_eyes_curr[eye_index] = ONLY_R;
+        eyes[eye_index] = ONLY_R;
         break;
     case 7:
-        leds_eyes_curr[eye_index] = ONLY_DOT;
+        eyes[eye_index] = ONLY_DOT;
         break;
     }
 
-    leds_load_gs();
+    leds_layer_show(LEDS_LAYER_ALERT, eyes[0], eyes[1], LEDS_LAYER_HOLD);
+    leds_compose();
 
     led_index++;
     if (led_index > 7) {
@@ -256,113 +617,118 @@ void leds_post_step() {
 
 /// Perform a single timestep of the LED system. Call this at about 100 Hz.
 void leds_timestep() {
-    uint8_t update_eyes = 0;
+    uint8_t faded = fade_step(leds_fades, 16) | fade_step(leds_scan_fades, 2);
+
+    leds_charge_tally(1);
 
     if (leds_scan_speed) {
-        if (leds_dot_level[scan_dot_curr] > leds_brightness || leds_dot_level[!scan_dot_curr] > leds_brightness) {
-            leds_dot_level[scan_dot_curr] = leds_brightness;
-            leds_dot_level[!scan_dot_curr] = 0;
+        fade_t *dot_out = &leds_scan_fades[scan_dot_curr];
+        fade_t *dot_in = &leds_scan_fades[!scan_dot_curr];
+
+        // Each dot fades over leds_scan_speed ticks, and the other dot
+        //  starts coming up once the active one is dim enough.
+        if (dot_out->target) {
+            fade_to(dot_out, 0, leds_scan_speed);
+        } else if (!dot_in->target && dot_out->level < LEDS_SCAN_OVERLAP_LEVEL) {
+            fade_to(dot_in, FADE_LEVEL_ON, leds_scan_speed);
+        } else if (dot_in->target && !dot_in->ticks) {
+            // It's all the way in, so now it's the active one.
+            scan_dot_curr = !scan_dot_curr;
         }
+    }
 
-        // Handle the scan transition
-        uint16_t led_scan_step = leds_brightness / leds_scan_speed;
-
-        // First decrement the active light
-        if (led_scan_step >= leds_dot_level[scan_dot_curr]) {
-            leds_dot_level[scan_dot_curr] = 0;
+    // Count down the layer that's showing.
+    uint8_t top = leds_layer_top();
+    if (leds_layers[top].ticks > 1 && leds_layers[top].ticks != LEDS_LAYER_HOLD) {
+        leds_layers[top].ticks--;
+    } else if (leds_layers[top].ticks != LEDS_LAYER_HOLD) {
+        if (top == LEDS_LAYER_ANIM) {
+            leds_anim_next();
         } else {
-            leds_dot_level[scan_dot_curr] -= led_scan_step;
-        }
-        // Then handle the target light, which doesn't start turning on
-        //  until the active light is below a certain brightness
-        if (leds_dot_level[scan_dot_curr] < leds_brightness/4) {
-            // We need to increase the brightness
-            if (leds_brightness - leds_scan_speed <= leds_dot_level[!scan_dot_curr]) {
-                // Done increasing the brightness.
-                // This is the last step, need to toggle the other way.
-                scan_dot_curr = !scan_dot_curr;
-                leds_dot_level[scan_dot_curr] = leds_brightness;
-            } else {
-                leds_dot_level[!scan_dot_curr] += led_scan_step;
-            }
+            leds_layer_hide(top);
         }
+    }
 
-        update_eyes = 1;
+    if (!leds_compose() && faded) {
+        leds_render();
     }
+}
 
-    if (eye_blinking == 1) {
-        // Just finished a blink
-        eye_blinking = 0;
+/// Return how many timesteps until the scan dots next do anything but fade.
+/**
+ ** That's the next turn of the handoff in leds_timestep(): the active dot
+ ** starting to fade out, the other starting to fade in once it's dim
+ ** enough, or the two swapping once that's done.
+ */
+uint16_t leds_scan_deadline() {
+    fade_t *dot_out = &leds_scan_fades[scan_dot_curr];
+    fade_t *dot_in = &leds_scan_fades[!scan_dot_curr];
+    uint16_t above;
 
-        // Restore either the ambient eyes or the first frame of the animation.
-        if (!eye_anim_curr) {
-            // Ambient
-            leds_eyes_curr[0] = eye_ambient(0);
-            leds_eyes_curr[1] = eye_ambient(1);
-            update_eyes = 1;
-        } else {
-            // Animation
-            leds_eyes_curr[0] = eye_anim_curr->frames[eye_anim_curr_frame].eyes[0];
-            leds_eyes_curr[1] = eye_anim_curr->frames[eye_anim_curr_frame].eyes[1];
-            update_eyes = 1;
-        }
-    } else if (eye_blinking) {
-        // Tick down the blink timer.
-        eye_blinking--;
-    } else if (eye_anim_curr) {
-        // We're not blinking, but we are animating.
-        // Are we done with the current frame?
-        if (eye_anim_curr_ticks >= eye_anim_curr->frames[eye_anim_curr_frame].dur) {
-            // Yes, done with the current frame.
-            eye_anim_curr_ticks = 0;
-            // Is this the last frame?
-            if (eye_anim_curr_frame+1 == eye_anim_curr->length && eye_anim_curr_loops) {
-                // Yes, but we have loops left to do.
-                eye_anim_curr_loops--;
-                eye_anim_curr_frame = 0;
-                eye_anim_curr_ticks = 0;
-                leds_eyes_curr[0] = eye_anim_curr->frames[eye_anim_curr_frame].eyes[0];
-                leds_eyes_curr[1] = eye_anim_curr->frames[eye_anim_curr_frame].eyes[1];
-                // Update the eyes.
-                update_eyes = 1;
-            } else if (eye_anim_curr_frame+1 == eye_anim_curr->length) {
-                // Yes, and there are no (more) loops to do.
-                eye_anim_curr = 0x0000;
-                if (eye_anim_blink_transition) {
-                    do_blink();
-                    // Don't update the eyes.
-                    update_eyes = 0;
-                } else {
-                    leds_eyes_curr[0] = eye_ambient(0);
-                    leds_eyes_curr[1] = eye_ambient(1);
-                    // Update the eyes.
-                    update_eyes = 1;
-                }
-            } else {
-                // Not done with the animation, so load next frame.
-                eye_anim_curr_frame++;
-                leds_eyes_curr[0] = eye_anim_curr->frames[eye_anim_curr_frame].eyes[0];
-                leds_eyes_curr[1] = eye_anim_curr->frames[eye_anim_curr_frame].eyes[1];
-                // Update the eyes.
-                update_eyes = 1;
-            }
-        } else {
-            // Not done with the current frame. Nothing to do.
-        }
-        // Regardless, we increment the ticks.
-        eye_anim_curr_ticks++;
-    } else {
-        // We're just ambient.
-        // Are we temp-ambient?
-        if (leds_eyes_ambient_temp_ticks == 1) {
-            leds_eyes_ambient_temp_ticks = 0;
-        } else if (leds_eyes_ambient_temp_ticks) {
-            leds_eyes_ambient_temp_ticks--;
-        }
+    if (dot_out->target) {
+        return 1;
+    }
+    if (dot_in->target) {
+        return dot_in->ticks ? dot_in->ticks : 1;
     }
 
-    if (update_eyes) {
-        leds_load_gs();
+    // The active dot is fading out; when does it get under the overlap?
+    if (dot_out->level < LEDS_SCAN_OVERLAP_LEVEL) {
+        return 1;
+    }
+    if (!dot_out->ticks) {
+        return LEDS_DEADLINE_NONE;
+    }
+    above = dot_out->level - LEDS_SCAN_OVERLAP_LEVEL;
+    if (dot_out->step >= 0 || above / -dot_out->step >= dot_out->ticks) {
+        return dot_out->ticks; // It lands on 0.
+    }
+    return above / -dot_out->step + 1;
+}
+
+/// Return how many timesteps until the next one that changes anything.
+/**
+ ** Until then, the main loop can skip leds_timestep() and tell leds_skip()
+ ** how many it skipped instead. A fade only counts on the ticks it moves a
+ ** whole level (see fade_next_change()), and the scan dots on those and
+ ** on their handoffs. This is LEDS_DEADLINE_NONE if nothing will change
+ ** until something new is shown. Before the badge is bootstrapped, only
+ ** the fades move (see leds_fade_timestep()), so only they count.
+ */
+uint16_t leds_next_deadline() {
+    uint16_t ticks = leds_layers[leds_layer_top()].ticks;
+    uint16_t next = LEDS_DEADLINE_NONE;
+    uint16_t due;
+
+    if ((due = fade_next_change(leds_fades, 16))) {
+        next = due;
+    }
+    if ((due = fade_next_change(leds_scan_fades, 2)) && due < next) {
+        next = due;
+    }
+    if (!badge_conf.bootstrapped) {
+        return next;
+    }
+    if (leds_scan_speed && (due = leds_scan_deadline()) < next) {
+        next = due;
+    }
+    if (ticks != LEDS_LAYER_HOLD && (ticks ? ticks : 1) < next) {
+        next = ticks ? ticks : 1;
+    }
+
+    return next;
+}
+
+/// Account for timesteps skipped, which must be fewer than leds_next_deadline().
+void leds_skip(uint16_t ticks) {
+    uint8_t top = leds_layer_top();
+
+    leds_charge_tally(ticks);
+    fade_skip(leds_fades, 16, ticks);
+    fade_skip(leds_scan_fades, 2, ticks);
+
+    if (leds_layers[top].ticks != LEDS_LAYER_HOLD && badge_conf.bootstrapped) {
+        leds_layers[top].ticks -= ticks;
     }
 }
 
@@ -380,26 +746,26 @@ void leds_blink_or_bling() {
     if (eye_anim_curr)
         return;
 
-    if (rand() % BADGE_ANIM_CHANCE_ONE_IN == 0) {
+    if (rng_below(BADGE_ANIM_CHANCE_ONE_IN) == 0) {
         // Make an animated face!
-        leds_anim_start(animations[rand() % ANIMATION_COUNT], 1);
-        if (rand() % BADGE_FACE_CHANCE_ONE_IN == 0) {
+        leds_anim_start(animations[rng_below(ANIMATION_COUNT)], 1);
+        if (rng_below(BADGE_FACE_CHANCE_ONE_IN) == 0) {
             // Decide to change our ambient face
-            fram_unlock();
-            leds_eyes_ambient = rand() % EYES_COUNT;
-            fram_lock();
+            leds_eyes_ambient = rng_below(EYES_COUNT);
+            persist_changed();
+            leds_layer_show(LEDS_LAYER_AMBIENT, EYES_DISP[leds_eyes_ambient][0], EYES_DISP[leds_eyes_ambient][1], LEDS_LAYER_HOLD);
         }
     } else {
         do_blink();
+        leds_compose();
     }
 }
 
 /// Initialize the LED driver system, including the low-level TLC5948A driver.
 void leds_init() {
     tlc_init();
+    leds_set_brightness(leds_brightness_level);
 
-    leds_eyes_curr[0] = (eye_t) {0, 0, 0, 1, 0, 1, 1, 1};
-    leds_eyes_curr[1] = (eye_t) {1, 1, 1, 1, 0, 0, 0, 0};
-
-    leds_load_gs();
+    leds_layer_show(LEDS_LAYER_AMBIENT, EYES_DISP[leds_eyes_ambient][0], EYES_DISP[leds_eyes_ambient][1], LEDS_LAYER_HOLD);
+    leds_compose();
 }
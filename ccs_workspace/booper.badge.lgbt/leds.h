@@ -28,32 +28,133 @@ typedef struct {
     uint8_t br : 1;
 } eye_t;
 
-/// A frame in an animation, with two eyes and a duration.
+/// An animation's bytecode, which programming/anim_compile.py generates.
+/**
+ ** An animation is a series of ops, each an opcode byte and its arguments,
+ ** ending with ANIM_END. An eye argument is a byte with bit 0 for tl, in
+ ** the order of eye_t's fields. The ops from ANIM_SHOW through ANIM_ROTATE
+ ** each show one frame, for the duration that the last ANIM_DUR set.
+ */
+typedef const uint8_t eye_anim_t;
+
+/// End of the animation.
+#define ANIM_END 0x00
+/// Play up to the matching ANIM_NEXT (count) times: ANIM_REPEAT, count.
+#define ANIM_REPEAT 0x01
+/// End of a repeat.
+#define ANIM_NEXT 0x02
+/// Frame with both eyes: ANIM_SHOW, left, right.
+#define ANIM_SHOW 0x03
+/// Frame with the same shape in both eyes: ANIM_BOTH, eye.
+#define ANIM_BOTH 0x04
+/// Frame changing only the left eye: ANIM_LEFT, eye.
+#define ANIM_LEFT 0x05
+/// Frame changing only the right eye: ANIM_RIGHT, eye.
+#define ANIM_RIGHT 0x06
+/// Frame flipping these segments: ANIM_TOGGLE, left, right.
+#define ANIM_TOGGLE 0x07
+/// Frame with each eye flipped left-to-right.
+#define ANIM_MIRROR 0x08
+/// Frame with every lit segment a step further round both eyes.
+#define ANIM_CHASE 0x09
+/// Set the duration of the following frames: ANIM_DUR, ticks.
+#define ANIM_DUR 0x0a
+/// Frame with each eye's outer ring turned (steps) clockwise: ANIM_ROTATE | steps.
+#define ANIM_ROTATE 0x10
+/// ANIM_DUR in one byte, for up to 63 ticks: ANIM_DUR_SHORT | ticks.
+#define ANIM_DUR_SHORT 0x40
+/// How deep ANIM_REPEATs can nest.
+#define ANIM_REPEAT_DEPTH 2
+
+/// A layer of the eye display, which shows while nothing above it is active.
 typedef struct {
     eye_t eyes[2];
-    uint8_t dur;
-} eye_anim_frame_t;
+    /// Timesteps left on top before it moves on, or LEDS_LAYER_HOLD.
+    uint16_t ticks;
+    uint8_t active;
+} leds_layer_t;
+
+// Eye display layers, lowest priority first.
+#define LEDS_LAYER_AMBIENT 0
+#define LEDS_LAYER_TEMP 1
+#define LEDS_LAYER_ANIM 2
+#define LEDS_LAYER_BLINK 3
+#define LEDS_LAYER_ALERT 4
+#define LEDS_LAYER_COUNT 5
+/// Layer ticks for a layer that stays up until something replaces it.
+#define LEDS_LAYER_HOLD 0xffff
+/// leds_next_deadline() when nothing is scheduled to change.
+#define LEDS_DEADLINE_NONE 0xffff
+
+/// How the TLC makes one level of brightness: its current, then grayscale.
+typedef struct {
+    /// Global brightness control, 0x00 (25% current) to 0x7f (100%).
+    uint8_t bc;
+    /// Scale for every LED's dot correction, out of TLC_DC_SCALE_FULL.
+    uint8_t dc_scale;
+    /// Grayscale for a fully lit LED.
+    uint16_t gs;
+} leds_brightness_t;
 
-/// An animation definition pointing to a series of frames.
+/// Number of levels in leds_brightness_ladder.
+#define LEDS_BRIGHTNESS_LEVELS 16
+
+/// Charge the LEDs have drawn, or could have, since power-on.
 typedef struct {
-    eye_anim_frame_t *frames;
-    uint8_t loop_count;
-    uint8_t length;
-} eye_anim_t;
+    /// Whole microamp-hours.
+    uint32_t uah;
+    /// And the microamp-centiseconds left over.
+    uint32_t uacsecs;
+} leds_charge_t;
+
+/// One LED's current at full grayscale, BC and DC, in uA.
+/**
+ ** This is set by the resistor on the TLC's IREF pin; the figure here is
+ ** the usual 20 mA for these LEDs, not a measurement of the badge.
+ */
+#define LEDS_CHANNEL_FULL_UA 20000
+/// Default cap on the estimated total LED current, in uA.
+/**
+ ** This is enough for the usual faces, with up to eight segments lit, at
+ ** the top brightness; the bigger ones get dimmed to fit.
+ */
+#define LEDS_BUDGET_UA (8UL * LEDS_CHANNEL_FULL_UA)
+/// Microamp-centiseconds in a microamp-hour.
+#define LEDS_UACSECS_PER_UAH 360000
+
+/// Ticks to crossfade between frames, once the main loop is running.
+#define LEDS_FADE_TICKS 4
+/// 8.8 level the active scan dot fades to before the other starts to rise.
+#define LEDS_SCAN_OVERLAP_LEVEL 0x8000
 
 extern uint16_t leds_brightness;
+extern uint8_t leds_brightness_level;
 extern uint16_t leds_scan_speed;
+extern uint8_t leds_fade_ticks;
+extern uint8_t leds_eyes_ambient;
+extern uint32_t leds_frames_computed;
+extern uint32_t leds_frames_sent;
+extern uint32_t leds_frames_limited;
+extern uint32_t leds_budget_ua;
+extern uint32_t leds_current_ua;
+extern leds_charge_t leds_charge_used;
+extern leds_charge_t leds_charge_budget;
 
 #define LEDS_QUEERDAR_NEWBADGE 0
 #define LEDS_QUEERDAR_OLDBADGE 1
 #define LEDS_QUEERDAR_PAIRBADGE 2
 
 void leds_post_step();
+void leds_set_brightness(uint8_t level);
 void leds_next_brightness();
 void leds_error_code(uint8_t code);
 void leds_show_number(uint8_t number, uint16_t make_temp_ambient);
 void leds_timestep();
+void leds_fade_timestep();
+uint16_t leds_next_deadline();
+void leds_skip(uint16_t ticks);
 void leds_blink_or_bling();
+void leds_anim_start(eye_anim_t *animation, uint8_t blink_transition);
 void leds_boop();
 void leds_queerdar_alert(uint8_t type);
 void leds_init();
@@ -7,8 +7,9 @@
  ** (primarily) the badge.c module.
  **
  ** The basic split in responsibility between the badge.c and main.c modules
- ** is that main.c detects, prioritizes, and clears flags set from
- ** interrupts; it then calls the appropriate function in badge.c so that
+ ** is that main.c takes the events posted from interrupts off the queue,
+ ** highest priority first (see event.c); it then calls the appropriate
+ ** function in badge.c so that
  ** badge.c can behave in a more event-driven way, with the underlying MSP430
  ** hardware and registers abstracted away by main.c for the most part.
  **
@@ -38,101 +39,239 @@
 #include "rfm75.h"
 #include "leds.h"
 #include "util.h"
+#include "sniffer.h"
+#include "timer.h"
+#include "event.h"
+#include "calcache.h"
+#include "persist.h"
+#include "enclog.h"
+#include "rng.h"
 
 /// Current button state (1 for pressed, 2 for long-pressed, 0 not pressed).
 volatile uint8_t button_state;
 
-/// Interrupt flag for the system clock tick.
-volatile uint8_t f_time_loop;
-/// Interrupt flag for the button being held for over 1 second.
-volatile uint8_t f_button_press_long;
-/// Interrupt flag that ticks every second.
-volatile uint8_t f_second;
 /// Signal to do a radio boop
 uint8_t s_boop_radio = 0;
+/// Whatever the power-on self test found wrong, to show once we've calibrated.
+uint8_t bootstrap_error = BADGE_POST_ERR_NONE;
+
+void button_long_press();
+
+/// Comes due every BUTTON_LONG_PRESS_CSECS that the button is held down.
+sw_timer_t button_long_timer = {.fire = button_long_press};
+/// Wakes us for the LEDs' next deadline.
+sw_timer_t leds_wake = {0,};
+/// Wakes us for the radio's next boop report deadline.
+sw_timer_t radio_wake = {0,};
+/// Wakes us for the next second the 1 Hz loop has anything to do in.
+sw_timer_t second_wake = {0,};
+/// Wakes us for our beacon's time in its slot.
+sw_timer_t beacon_wake = {0,};
+
+/// How far the FLL can pull the DCO tap from 256 before we trim again.
+/**
+ ** That's halfway to either end of its range. Past there, the FLL is
+ ** running out of room to track temperature and voltage.
+ */
+#define DCO_TAP_MARGIN 128
+/// boot_warm bit for booting on the cached DCO trim.
+#define BOOT_WARM_DCO BIT0
+/// boot_warm bit for booting on the cached touch calibration.
+#define BOOT_WARM_TOUCH BIT1
+
+/// What the last DCO trim settled on, for the calibration cache.
+uint16_t dco_trim_csctl0 = 0;
+uint16_t dco_trim_csctl1 = 0;
+/// Which calibrations this boot took from the cache (BOOT_WARM_*).
+uint8_t boot_warm = 0;
+/// ACLK counts from reset to the main loop, to compare warm and cold boots.
+uint16_t boot_ready_counts = 0;
+
+/// The button's tuning, in CAPT_UserConfig.c, which is generated.
+extern tCaptivateElementTuning B1_E00_Tuning[CAPT_SELF_FREQ_CNT];
+/// The button's latest raw counts, also in CAPT_UserConfig.c.
+extern uint16_t B1_E00_RawCnts[CAPT_SELF_FREQ_CNT];
+
+/// The DCO trim isn't running.
+#define DCO_TRIM_IDLE 0
+/// The DCO trim has tried a DCOFTRIM, and is waiting for the FLL to lock on it.
+#define DCO_TRIM_SEARCH 1
+/// The DCO trim has put back the best DCOFTRIM, and is waiting for the FLL to lock on it.
+#define DCO_TRIM_FINAL 2
+
+void dco_trim_step();
+
+/// Steps the DCO trim along, a tick at a time.
+sw_timer_t dco_trim_timer = {.fire = dco_trim_step};
+/// Where the DCO trim is up to (DCO_TRIM_*).
+uint8_t dco_trim_state = DCO_TRIM_IDLE;
+/// DCOTAP from the trim's last try and the one before, or 0xffff if none.
+uint16_t dco_trim_new_tap;
+uint16_t dco_trim_old_tap;
+/// How far from 256 the best try's DCOTAP was, and its CSCTL0 and CSCTL1.
+uint16_t dco_trim_best_delta;
+uint16_t dco_trim_best_csctl0;
+uint16_t dco_trim_best_csctl1;
+
+/// Try the DCOFTRIM that's in CSCTL1, and step the trim once the FLL has had time to lock.
+void dco_trim_try() {
+    CSCTL0 = 0x100; // DCO Tap = 256
+    do {
+        CSCTL7 &= ~DCOFFG; // Clear DCO fault flag
+    } while (CSCTL7 & DCOFFG);
+    // A tick is longer than the 3 ms the FLLUNLOCK bits take to be stable.
+    timer_start(&dco_trim_timer, 1);
+}
 
-/// Perform the TI-recommended software trim of the DCO per TI demo code.
-void dco_software_trim()
-{
-    unsigned int oldDcoTap = 0xffff;
-    unsigned int newDcoTap = 0xffff;
-    unsigned int newDcoDelta = 0xffff;
-    unsigned int bestDcoDelta = 0xffff;
-    unsigned int csCtl0Copy = 0;
-    unsigned int csCtl1Copy = 0;
-    unsigned int csCtl0Read = 0;
-    unsigned int csCtl1Read = 0;
-    unsigned int dcoFreqTrim = 3;
-    unsigned char endLoop = 0;
-
-    do
-    {
-        CSCTL0 = 0x100;                         // DCO Tap = 256
-        do
-        {
-            CSCTL7 &= ~DCOFFG;                  // Clear DCO fault flag
-        }while (CSCTL7 & DCOFFG);               // Test DCO fault flag
-
-        __delay_cycles((unsigned int)3000 * MCLK_FREQ_MHZ);// Wait FLL lock status (FLLUNLOCK) to be stable
-                                                           // Suggest to wait 24 cycles of divided FLL reference clock
-        while((CSCTL7 & (FLLUNLOCK0 | FLLUNLOCK1)) && ((CSCTL7 & DCOFFG) == 0));
-
-        csCtl0Read = CSCTL0;                   // Read CSCTL0
-        csCtl1Read = CSCTL1;                   // Read CSCTL1
-
-        oldDcoTap = newDcoTap;                 // Record DCOTAP value of last time
-        newDcoTap = csCtl0Read & 0x01ff;       // Get DCOTAP value of this time
-        dcoFreqTrim = (csCtl1Read & 0x0070)>>4;// Get DCOFTRIM value
-
-        if(newDcoTap < 256)                    // DCOTAP < 256
-        {
-            newDcoDelta = 256 - newDcoTap;     // Delta value between DCPTAP and 256
-            if((oldDcoTap != 0xffff) && (oldDcoTap >= 256)) // DCOTAP cross 256
-                endLoop = 1;                   // Stop while loop
-            else
-            {
-                dcoFreqTrim--;
-                CSCTL1 = (csCtl1Read & (~(DCOFTRIM0+DCOFTRIM1+DCOFTRIM2))) | (dcoFreqTrim<<4);
-            }
+/// Start the TI-recommended software trim of the DCO, in the background.
+/**
+ ** This is the search from TI's demo code, stepped from the timer service
+ ** instead of busy-waiting on the FLL: starting from DCOFTRIM in CSCTL1, it
+ ** moves DCOFTRIM one step at a time, waiting a tick each for the FLL to
+ ** lock, until the DCO tap crosses 256, and then keeps the closest. That's
+ ** usually a few ticks. The DCO, and everything clocked from it, wanders
+ ** a little while it runs, which only the sniffer's UART would notice.
+ ** When it's done, dco_trim_csctl0 and dco_trim_csctl1 are the result,
+ ** and the calibration cache has it.
+ */
+void dco_trim_start() {
+    if (dco_trim_state != DCO_TRIM_IDLE) {
+        return;
+    }
+    dco_trim_new_tap = 0xffff;
+    dco_trim_best_delta = 0xffff;
+    dco_trim_state = DCO_TRIM_SEARCH;
+    dco_trim_try();
+}
+
+/// Take the DCO trim a step further, once the FLL has locked.
+void dco_trim_step() {
+    uint16_t csctl0;
+    uint16_t csctl1;
+    uint16_t delta;
+    uint8_t trim;
+    uint8_t done = 0;
+
+    if ((CSCTL7 & (FLLUNLOCK0 | FLLUNLOCK1)) && !(CSCTL7 & DCOFFG)) {
+        timer_start(&dco_trim_timer, 1); // Not locked yet.
+        return;
+    }
+
+    if (dco_trim_state == DCO_TRIM_FINAL) {
+        dco_trim_state = DCO_TRIM_IDLE;
+        dco_trim_csctl0 = dco_trim_best_csctl0;
+        dco_trim_csctl1 = dco_trim_best_csctl1;
+        calcache_dco_save(dco_trim_csctl0, dco_trim_csctl1);
+        return;
+    }
+
+    csctl0 = CSCTL0;
+    csctl1 = CSCTL1;
+    dco_trim_old_tap = dco_trim_new_tap;
+    dco_trim_new_tap = csctl0 & 0x01ff;
+    trim = (csctl1 & 0x0070) >> 4;
+
+    if (dco_trim_new_tap < 256) {
+        delta = 256 - dco_trim_new_tap;
+        if (dco_trim_old_tap != 0xffff && dco_trim_old_tap >= 256) {
+            done = 1; // DCOTAP crossed 256
+        } else {
+            trim--;
         }
-        else                                   // DCOTAP >= 256
-        {
-            newDcoDelta = newDcoTap - 256;     // Delta value between DCPTAP and 256
-            if(oldDcoTap < 256)                // DCOTAP cross 256
-                endLoop = 1;                   // Stop while loop
-            else
-            {
-                dcoFreqTrim++;
-                CSCTL1 = (csCtl1Read & (~(DCOFTRIM0+DCOFTRIM1+DCOFTRIM2))) | (dcoFreqTrim<<4);
-            }
+    } else {
+        delta = dco_trim_new_tap - 256;
+        if (dco_trim_old_tap < 256) {
+            done = 1; // DCOTAP crossed 256
+        } else {
+            trim++;
         }
+    }
 
-        if(newDcoDelta < bestDcoDelta)         // Record DCOTAP closest to 256
-        {
-            csCtl0Copy = csCtl0Read;
-            csCtl1Copy = csCtl1Read;
-            bestDcoDelta = newDcoDelta;
-        }
+    if (delta < dco_trim_best_delta) {
+        dco_trim_best_csctl0 = csctl0;
+        dco_trim_best_csctl1 = csctl1;
+        dco_trim_best_delta = delta;
+    }
+
+    if (!done) {
+        CSCTL1 = (csctl1 & ~(DCOFTRIM0 + DCOFTRIM1 + DCOFTRIM2)) | ((trim & 0x07) << 4);
+        dco_trim_try();
+        return;
+    }
+
+    CSCTL0 = dco_trim_best_csctl0; // Reload locked DCOTAP
+    CSCTL1 = dco_trim_best_csctl1; // Reload locked DCOFTRIM
+    dco_trim_state = DCO_TRIM_FINAL;
+    timer_start(&dco_trim_timer, 1);
+}
 
-    }while(endLoop == 0);                      // Poll until endLoop == 1
+/// Return 1 if the DCO is running, with its tap comfortably inside its range.
+/**
+ ** The FLL unlocks for a moment whenever it moves the tap, so that's not
+ ** checked here; the tap's distance from the middle is what says the trim
+ ** has gone stale.
+ */
+uint8_t dco_trim_ok() {
+    uint16_t tap = CSCTL0 & 0x01ff;
 
-    CSCTL0 = csCtl0Copy;                       // Reload locked DCOTAP
-    CSCTL1 = csCtl1Copy;                       // Reload locked DCOFTRIM
-    while(CSCTL7 & (FLLUNLOCK0 | FLLUNLOCK1)); // Poll until FLL is locked
+    if (CSCTL7 & DCOFFG) {
+        return 0;
+    }
+    return tap > 256 - DCO_TAP_MARGIN && tap < 256 + DCO_TAP_MARGIN;
+}
+
+/// Put back the DCO trim from the calibration cache, and return 1 if it holds.
+/**
+ ** This is the last step of the DCO trim, without the search before it:
+ ** one wait for the FLL to lock, instead of one per trim it tries. It's
+ ** the only wait for the FLL at boot.
+ */
+uint8_t dco_cached_trim() {
+    if (!calcache_dco_valid()) {
+        return 0;
+    }
+
+    CSCTL0 = calcache.dco.csctl0;
+    CSCTL1 = calcache.dco.csctl1;
+    do {
+        CSCTL7 &= ~DCOFFG;
+    } while (CSCTL7 & DCOFFG);
+    __delay_cycles((unsigned int)3000 * MCLK_FREQ_MHZ); // Wait FLL lock status (FLLUNLOCK) to be stable
+    while ((CSCTL7 & (FLLUNLOCK0 | FLLUNLOCK1)) && !(CSCTL7 & DCOFFG));
+
+    if ((CSCTL7 & (FLLUNLOCK0 | FLLUNLOCK1)) || !dco_trim_ok()) {
+        return 0;
+    }
+    dco_trim_csctl0 = calcache.dco.csctl0;
+    dco_trim_csctl1 = calcache.dco.csctl1;
+    return 1;
 }
 
 /// Prepare to write to FRAM by disabling interrupts and unlocking write access to INFOA.
-volatile void fram_unlock() {
+void fram_unlock() {
     __bic_SR_register(GIE);
     SYSCFG0 = FRWPPW | PFWP;
 }
 
 /// Finish writing to FRAM by locking write access to INFOA and enabling interrupts.
-volatile void fram_lock() {
+void fram_lock() {
     SYSCFG0 = FRWPPW | DFWP | PFWP;
     __bis_SR_register(GIE);
 }
 
+/// Set FRAM write protection to `protect` (DFWP and PFWP), leaving interrupts on.
+/**
+ ** For writes that are safe to interrupt, like persist_commit()'s: only
+ ** the write to SYSCFG0 itself has interrupts off.
+ */
+void fram_protect(uint16_t protect) {
+    uint16_t sr = __get_SR_register();
+
+    __bic_SR_register(GIE);
+    SYSCFG0 = FRWPPW | protect;
+    __bis_SR_register(sr & GIE);
+}
+
 /// Initialize clock signals and the three system clocks.
 /**
  ** We'll take the DCO to 8 MHz, and divide it by 1 for MCLK = 8MHz.
@@ -163,13 +302,34 @@ void init_clocks() {
     CSCTL2 = FLLD_0 + 243; // DCODIV = 8MHz
     __delay_cycles(3); // Documentation says to wait at least 3 cycles
     __bic_SR_register(SCG0); // enable FLL
-    dco_software_trim(); // Software Trim to get the best DCOFTRIM value
+    // Without a cached trim, the FLL locks as best it can from DCOFTRIM=3,
+    //  and main() starts the trim, to run in the background.
+    if (dco_cached_trim()) {
+        boot_warm |= BOOT_WARM_DCO;
+    }
 
     CSCTL4 = SELMS__DCOCLKDIV | SELA__REFOCLK; // set default REFO(~32768Hz) as ACLK source, ACLK = 32768Hz
 
     // default DCODIV as MCLK and SMCLK source, SMCLKOFF=0; no need to modify CSCTL5.
 }
 
+/// Divide SMCLK by 2 to the power of `shift`.
+/**
+ ** SMCLK is also the TLC's grayscale clock, out on P1.7, so a slower SMCLK
+ ** gives the LEDs a longer PWM period for the same duty cycle, and costs
+ ** less current on both sides of the pin. Both SPI ports are clocked from
+ ** it too, and just get slower. The sniffer's UART can't, so sniffer
+ ** builds stay at full speed. The RTC runs from ACLK, so it doesn't care.
+ */
+void smclk_set_div_shift(uint8_t shift) {
+    if (RADIO_SNIFFER) {
+        return;
+    }
+
+    CSCTL5 = (CSCTL5 & ~DIVS) | (shift << 4);
+    event_smclk_div_shift(shift);
+}
+
 /// Apply the initial configuration of the GPIO and peripheral pins.
 /**
  **
@@ -181,10 +341,10 @@ void init_io() {
     // P1.1     UCB0CLK     (SEL 01; DIR 1)
     // P1.2     UCB0SIMO    (SEL 01; DIR 1)
     // P1.3     UCB0SOMI    (SEL 01; DIR 0)
-    // P1.4     Unused      (SEL 00; DIR 1)
+    // P1.4     Unused      (SEL 00; DIR 1) UCA0TXD for the POST report, and in sniffer builds
     // P1.5     GPIO CE     (SEL 00; DIR 1) Initially LOW
     // P1.6     GPIO IRQ    (SEL 00; DIR 0)
-    // P1.7     SMCLK out   (SEL 10; DIR 1)
+    // P1.7     SMCLK out   (SEL 10; DIR 1) GSCLK; gated to GPIO LOW when dark
 
     // P2.0     Unused      (SEL 00; DIR 1)
     // P2.1     Unused      (SEL 00; DIR 1)
@@ -224,6 +384,13 @@ void init_io() {
     PM5CTL0 &= ~LOCKLPM5;
 }
 
+/// Fire a long press, and another each time the button is held that long again.
+void button_long_press() {
+    button_state = 2;
+    timer_start(&button_long_timer, BUTTON_LONG_PRESS_CSECS);
+    badge_button_press_long();
+}
+
 /// Callback from CapTIvate for a change in the button state.
 void button_cb(tSensor *pSensor) {
 
@@ -232,7 +399,7 @@ void button_cb(tSensor *pSensor) {
         long_presses = 0;
         // Button press
          button_state = 1;
-         rtc_button_csecs = 0;
+         timer_start(&button_long_timer, BUTTON_LONG_PRESS_CSECS);
     }
 
     if((pSensor->bSensorTouch == false) && (pSensor->bSensorPrevTouch == true))
@@ -246,6 +413,7 @@ void button_cb(tSensor *pSensor) {
              badge_button_press_short();
          }
          button_state = 0;
+         timer_stop(&button_long_timer);
     }
 }
 
@@ -253,6 +421,8 @@ void post_display() {
     if (!rfm75_post()) {
         // Radio appears broken.
         leds_error_code(BADGE_POST_ERR_NORF);
+    } else if (tlc_leds_open | tlc_leds_shorted) {
+        leds_error_code(BADGE_POST_ERR_LEDS);
     } else if (badge_conf.badge_id == BADGE_ID_UNASSIGNED) {
         leds_error_code(BADGE_POST_ERR_NOID);
     } else if (!radio_frequency_done) {
@@ -262,38 +432,227 @@ void post_display() {
     }
 }
 
+/// Send the LED test results out P1.4, for the factory to check.
+/**
+ ** This goes at the sniffer's 250 kbaud, as a BADGE_POST_REPORT_SYNC
+ ** record, by polling: it's seven bytes, once. Afterward the eUSCI is held
+ ** in reset, which leaves the line idling high, unless the sniffer is
+ ** about to take it over.
+ */
+void post_report() {
+    EUSCI_A_UART_initParam param = {0};
+    uint8_t report[6] = {
+            BADGE_POST_REPORT_SYNC,
+            tlc_leds_open & 0xff, tlc_leds_open >> 8,
+            tlc_leds_shorted & 0xff, tlc_leds_shorted >> 8,
+            0,
+    };
+
+    for (uint8_t i=1; i<5; i++) {
+        report[5] -= report[i];
+    }
+
+    param.selectClockSource = EUSCI_A_UART_CLOCKSOURCE_SMCLK;
+    param.clockPrescalar = SNIFFER_UART_BR;
+    param.firstModReg = SNIFFER_UART_BRF;
+    param.secondModReg = SNIFFER_UART_BRS;
+    param.parity = EUSCI_A_UART_NO_PARITY;
+    param.msborLsbFirst = EUSCI_A_UART_LSB_FIRST;
+    param.numberofStopBits = EUSCI_A_UART_ONE_STOP_BIT;
+    param.uartMode = EUSCI_A_UART_MODE;
+    param.overSampling = EUSCI_A_UART_OVERSAMPLING_BAUDRATE_GENERATION;
+    EUSCI_A_UART_init(EUSCI_A0_BASE, &param);
+    EUSCI_A_UART_enable(EUSCI_A0_BASE);
+    P1SEL0 |= BIT4; // P1.4 goes from unused GPIO to UCA0TXD.
+
+    for (uint8_t i=0; i<sizeof(report); i++) {
+        while (!(UCA0IFG & UCTXIFG));
+        UCA0TXBUF = report[i];
+    }
+    while (UCA0STATW & UCBUSY);
+
+    if (!RADIO_SNIFFER) {
+        UCA0CTLW0 |= UCSWRST;
+    }
+}
+
+/// Post EVENT_TOUCH if CapTIvate's scan timer has gone off since we last looked.
+/**
+ ** The CapTIvate library's own ISR just sets g_bConvTimerFlag and wakes
+ ** us, so the main loop calls this before it drains the queue, and again
+ ** with interrupts off right before it sleeps, so a scan that comes due
+ ** in between can't be slept through. The touch's queueing delay in
+ ** event_stats counts from here, not from the interrupt.
+ */
+void main_post_touch() {
+    if (g_bConvTimerFlag) {
+        g_bConvTimerFlag = 0;
+        event_post(EVENT_TOUCH);
+    }
+}
+
+/// Count in the ticks since the last pass, and catch the LEDs and radio up on them.
+/**
+ ** Whatever woke us, this does exactly what a timestep every tick would
+ ** have, but only steps the LEDs and radio on the ticks that need it.
+ */
+void main_catch_up() {
+    static uint32_t ticks_done = 0;
+    uint32_t now;
+
+    rtc_catch_up();
+    now = rtc_get_ticks();
+
+    timer_catch_up(now - ticks_done, leds_next_deadline, leds_skip,
+                   badge_conf.bootstrapped ? leds_timestep : leds_fade_timestep);
+    timer_catch_up(now - ticks_done, radio_next_deadline, radio_skip,
+                   radio_timestep);
+    ticks_done = now;
+}
+
+/// Set the timers that only wake us up, and have the RTC wake us for the first due.
+void main_schedule() {
+    timer_start(&leds_wake, leds_next_deadline());
+    timer_start(&radio_wake, radio_next_deadline());
+    timer_start(&second_wake,
+                radio_next_second() * 100 - rtc_centiseconds);
+    rtc_set_wake(timer_next());
+}
+
+/// Seconds left to listen on the frequency we're calibrating on.
+uint8_t radio_calibration_freq_seconds_left = BADGE_RADIO_CALIBRATION_SECS_PER_FREQ;
+
+/// Take the radio frequency calibration one second further.
+/**
+ ** Called from the 1 Hz housekeeping until radio_frequency_done, while
+ ** the radio and the rest of the badge run as usual. It listens on each
+ ** frequency in turn for a few seconds, then settles on the one that heard
+ ** the most, or starts over if none heard anything.
+ */
+void main_calibrate_second() {
+    leds_post_step();
+    // Still calibrating our radio frequency.
+    if (!radio_calibration_freq_seconds_left) {
+        // Done with a frequency.
+        radio_frequency++;
+
+        if (radio_frequency == FREQ_MIN+FREQ_NUM) {
+            // Just finished the last frequency. Decide which is the best.
+            uint16_t cnt = 0;
+            for (uint8_t i=FREQ_MIN; i<FREQ_MIN+FREQ_NUM; i++) {
+                if (rx_cnt[i-FREQ_MIN] > cnt) {
+                    // New best frequency
+                    cnt = rx_cnt[i-FREQ_MIN];
+                    radio_frequency = i;
+                }
+            }
+            if (cnt || badge_conf.bootstrapped) { // If it's already bootstrapped we only want to try once.
+                // If we got anything at all on our best frequency, conclude our search.
+                radio_frequency_done = 1;
+                radio_set_channel(radio_frequency);
+
+                // Display our selected frequency.
+                leds_show_number(radio_frequency, 400);
+                if (bootstrap_error) {
+                    // frequency calibration completed; if there was a POST error, show it.
+                    post_display();
+                }
+            } else {
+                // Nothing received - start over.
+                radio_frequency = FREQ_MIN;
+            }
+        }
+        persist_changed();
+        radio_set_channel(radio_frequency);
+        radio_calibration_freq_seconds_left = badge_conf.bootstrapped ? BADGE_RADIO_CALIBRATION_SECS_PER_FREQ : BADGE_RADIO_CALIBRATION_SECS_PER_FREQ_INITIAL;
+    } else {
+        // Decrement seconds left on the current frequency.
+        radio_calibration_freq_seconds_left--;
+    }
+}
+
+/// Check the calibrations are still good, and keep the cache up to date.
+/**
+ ** Called from the 1 Hz housekeeping. If the FLL has pulled the DCO tap
+ ** too far from the middle, the DCO is trimmed again, in the background,
+ ** and the cache gets the new trim when that's done. CAPT_updateUI() recalibrates
+ ** the button itself whenever its counts drift out of range, which is how
+ ** a cached calibration that's gone stale gets replaced; this just saves
+ ** the new one.
+ */
+void main_check_calibration() {
+    if (dco_trim_state == DCO_TRIM_IDLE && !dco_trim_ok()) {
+        // Don't boot on it again if we brown out before the trim's done.
+        calcache_dco_forget();
+        dco_trim_start();
+    }
+
+    if (!B1.bCalibrationError) {
+        calcache_touch_save(B1_E00_Tuning);
+    }
+}
+
+/// Return the deepest low-power mode the badge can sleep in right now.
+/**
+ ** LPM3 stops SMCLK, and with it GSCLK, so it's only for when the LEDs are
+ ** dark and the TLC has nothing left to send. In normal use they never
+ ** are (the blinks keep something lit), so in practice this is LPM0. A
+ ** static frame can't go without SMCLK either: GSCLK comes out of P1.7,
+ ** whose only other functions are UCA0STE and TDO, so there's no slower
+ ** clock that could drive it through LPM3 on this board. The radio's SPI is only used
+ ** synchronously, so it's always done by now, and the RTC, the CapTIvate
+ ** timer and the radio's IRQ pin all wake us from LPM3. The sniffer's UART
+ ** runs from SMCLK, so sniffer builds never go below LPM0. LPM3 stops the
+ ** FLL too, so we don't go there while the DCO trim is waiting for it.
+ */
+uint16_t main_sleep_bits() {
+    if (!RADIO_SNIFFER && tlc_dark && tlc_send_type == TLC_SEND_IDLE &&
+            dco_trim_state == DCO_TRIM_IDLE) {
+        return LPM3_bits;
+    }
+    return LPM0_bits;
+}
+
 /// Make snafucated
 int main(void)
 {
 	WDTCTL = WDTPW | WDTHOLD;	// stop watchdog timer
 	
 	// Board basics initialization
+	event_init(); // Its timer times the boot, too.
 	init_clocks();
 	init_io();
+	persist_init();
+	enclog_init();
 
 	badge_init();
+	rng_harvest_clocks(RNG_CLOCK_SAMPLES);
 
 	__bis_SR_register(GIE);
 
     // Mid-level drivers initialization
     leds_init();
-
-    // If we have something to show, go ahead and count our badges.
-	if (badge_conf.bootstrapped && badge_conf.badges_seen_count > 1) {
-	    for (uint8_t i=0; i<=(badge_conf.badges_seen_count < 100 ? badge_conf.badges_seen_count : 100); i++) {
-	        leds_show_number(i, 0);
-	        delay_millis(80);
-	    }
-	    delay_millis(6000);
-	}
+    tlc_test_leds();
+    post_report();
 
 	// Application-level drivers initialization
     rtc_init();
 	radio_init(badge_conf.badge_id);
+#if RADIO_SNIFFER
+	sniffer_init();
+#endif
 
 	// CapTIvate initialization and startup
     MAP_CAPT_initUI(&g_uiApp);
-    MAP_CAPT_calibrateUI(&g_uiApp);
+    if (calcache_touch_load(B1_E00_Tuning)) {
+        // Start from the cached calibration, with the filters seeded from
+        //  the first scan, and let CAPT_updateUI() judge whether it holds.
+        MAP_CAPT_flagAllElementsForReseed(&B1);
+        boot_warm |= BOOT_WARM_TOUCH;
+    } else {
+        MAP_CAPT_calibrateUI(&g_uiApp);
+    }
+    rng_stir(B1_E00_RawCnts[0]);
     MAP_CAPT_registerCallback(&B1, &button_cb);
 
     MAP_CAPT_stopTimer();
@@ -306,16 +665,17 @@ int main(void)
 
 	// Application functionality initialization
 
-    // Set up WDT, and we're off to see the wizard.
-    WDTCTL = WDTPW | WDTSSEL__ACLK | WDTIS__32K | WDTCNTCL; // 1 second WDT
+    // Set up WDT, and we're off to see the wizard. We can sleep for up to
+    //  RTC_WAKE_MAX_CSECS at a time, so it's comfortably longer than that.
+    WDTCTL = WDTPW | WDTSSEL__ACLK | WDTIS__512K | WDTCNTCL; // 16 second WDT
 
-    uint8_t my_beacon_tick = badge_conf.badge_id % 8;
+    uint8_t my_beacon_tick = badge_conf.badge_id % RADIO_BEACON_INTERVAL_SECS;
     uint8_t s_beacon = 0;
-    uint8_t next_blink = 1;
 
-    uint8_t bootstrap_error = BADGE_POST_ERR_NONE;
     if (badge_conf.badge_id == BADGE_ID_UNASSIGNED)
         bootstrap_error = BADGE_ID_UNASSIGNED;
+    if (tlc_leds_open | tlc_leds_shorted)
+        bootstrap_error = BADGE_POST_ERR_LEDS;
     if (!rfm75_post())
         bootstrap_error = BADGE_POST_ERR_NORF;
 
@@ -325,113 +685,81 @@ int main(void)
         badge_block_radio_game = 1;
     }
 
-	while (1) {
-	    // The 100 Hz loop
-	    if (f_time_loop) {
-            f_time_loop = 0;
-
-	        // pat pat pat
-	        WDTCTL = WDTPW | WDTSSEL__ACLK | WDTIS__32K | WDTCNTCL; // 1 second WDT
+    // Crossfade from here on, now that the main loop will tick the fades.
+    leds_fade_ticks = LEDS_FADE_TICKS;
 
-	        if (badge_conf.bootstrapped)
-	            leds_timestep();
-	    }
-
-	    if (f_button_press_long) {
-            f_button_press_long = 0;
-
-	        badge_button_press_long();
-	    }
+    // If we have something to show, go ahead and count our badges, while
+    //  the radio and the button get on with it.
+    badge_count_start();
 
-	    if (f_rfm75_interrupt) {
-	        rfm75_deferred_interrupt();
-	    }
-
-	    // Check whether CapTIvate needs to be serviced.
-	    if (g_bConvTimerFlag) {
-            g_bConvTimerFlag = 0;
+    if (!(boot_warm & BOOT_WARM_DCO)) {
+        dco_trim_start();
+    }
 
-	        CAPT_updateUI(&g_uiApp);
-	    }
+    boot_ready_counts = event_now();
 
-        // The 1 Hz loop - lower priority
-        if (f_second) {
-            f_second = 0;
-
-            if (!radio_frequency_done) {
-                leds_post_step();
-                // Still calibrating our radio frequency.
-                static uint8_t radio_calibration_freq_seconds_left = BADGE_RADIO_CALIBRATION_SECS_PER_FREQ;
-                if (!radio_calibration_freq_seconds_left) {
-                    // Done with a frequency.
-                    fram_unlock();
-                    radio_frequency++;
-                    fram_lock();
-
-                    if (radio_frequency == FREQ_MIN+FREQ_NUM) {
-                        // Just finished the last frequency. Decide which is the best.
-                        uint16_t cnt = 0;
-                        for (uint8_t i=FREQ_MIN; i<FREQ_MIN+FREQ_NUM; i++) {
-                            if (rx_cnt[i-FREQ_MIN] > cnt) {
-                                // New best frequency
-                                cnt = rx_cnt[i-FREQ_MIN];
-                                fram_unlock();
-                                radio_frequency = i;
-                                fram_lock();
-                            }
-                        }
-                        if (cnt || badge_conf.bootstrapped) { // If it's already bootstrapped we only want to try once.
-                            // If we got anything at all on our best frequency, conclude our search.
-                            fram_unlock();
-                            radio_frequency_done = 1;
-                            fram_lock();
-                            rfm75_write_reg(0x05, radio_frequency);
-
-                            // Display our selected frequency.
-                            leds_show_number(radio_frequency, 400);
-                            if (bootstrap_error) {
-                                // frequency calibration completed; if there was a POST error, show it.
-                                post_display();
-                            }
-                        } else {
-                            // Nothing received - start over.
-                            fram_unlock();
-                            radio_frequency = FREQ_MIN;
-                            fram_lock();
-                        }
-                    }
-                    rfm75_write_reg(0x05, radio_frequency);
-                    radio_calibration_freq_seconds_left = badge_conf.bootstrapped ? BADGE_RADIO_CALIBRATION_SECS_PER_FREQ : BADGE_RADIO_CALIBRATION_SECS_PER_FREQ_INITIAL;
-                } else {
-                    // Decrement seconds left on the current frequency.
-                    radio_calibration_freq_seconds_left--;
+	while (1) {
+	    uint8_t event;
+
+	    // pat pat pat
+	    WDTCTL = WDTPW | WDTSSEL__ACLK | WDTIS__512K | WDTCNTCL; // 16 second WDT
+
+	    // Handle everything that's been posted, most urgent first, catching
+	    //  up on the ticks we slept through before each.
+	    main_post_touch();
+	    while ((event = event_next()) != EVENT_NONE) {
+	        main_catch_up();
+
+	        switch (event) {
+	        case EVENT_RADIO:
+	            // When packets turn up is a little noisy.
+	            rng_stir(event_now());
+	            rfm75_deferred_interrupt();
+	            break;
+#if RADIO_SNIFFER
+	        case EVENT_SNIFFER:
+	            sniffer_service();
+	            break;
+#endif
+	        case EVENT_TOUCH:
+	            CAPT_updateUI(&g_uiApp);
+	            // So are the low bits of every scan.
+	            rng_stir(B1_E00_RawCnts[0]);
+	            break;
+	        case EVENT_TICK:
+	            // Run the timers that came due.
+	            timer_run();
+	            break;
+	        case EVENT_SECOND:
+                main_check_calibration();
+                if (!radio_frequency_done) {
+                    main_calibrate_second();
                 }
-            }
 
-            if (badge_block_radio_game) {
-                continue;
-            }
+                if (badge_block_radio_game) {
+                    break;
+                }
 
-            if (rtc_seconds % 8 == my_beacon_tick) {
-                // Time to send a radio beacon
-                s_beacon = 1;
-            }
+                radio_second();
 
-            if (!next_blink) {
-                    leds_blink_or_bling();
-                next_blink = rand() % BADGE_SECS_PER_BLINK_AVG;
-            } else {
-                next_blink--;
-            }
+                if (rtc_seconds % RADIO_BEACON_INTERVAL_SECS == my_beacon_tick) {
+                    // Time to send a radio beacon
+                    s_beacon = 1;
+                }
+	            break;
+	        }
 
-            if (badge_boop_radio_cooldown) {
-                badge_boop_radio_cooldown--;
-            }
-        }
+	        event_done(event);
+	    }
 
-	    if (s_beacon) {
+	    if (s_beacon && rfm75_tx_avail()) {
 	        // It's been 8 seconds, time to process the queerdar.
-	        if (rfm75_tx_avail()) {
+	        uint8_t wait = radio_tx_slot_wait();
+
+	        if (wait) {
+	            // Come back for it when our time in the slot comes.
+	            timer_start(&beacon_wake, wait);
+	        } else {
 	            s_beacon = 0;
 	            if (!badge_block_radio_game)
 	                radio_interval();
@@ -444,15 +772,15 @@ int main(void)
                 radio_boop(badge_conf.badge_id, BADGE_BOOP_RADIO_HOPS);
 	    }
 
-	    // Enter sleep mode if we have no unserviced flags.
-	    if (
-	            !f_time_loop &&
-	            !f_second &&
-	            !f_button_press_long &&
-	            !f_rfm75_interrupt &&
-	            !g_bConvTimerFlag
-	    ) {
-	        __bis_SR_register(LPM0_bits);
-	    }
+	    // Commit any settings that have changed, now that we're idle.
+	    persist_idle();
+
+	    // Enter sleep mode until the next timer is due, if nothing's been
+	    //  posted since we emptied the queue.
+	    main_catch_up();
+	    main_schedule();
+	    __bic_SR_register(GIE);
+	    main_post_touch();
+	    event_sleep(main_sleep_bits());
 	}
 }
@@ -0,0 +1,176 @@
+/// The badge's persistent settings, committed to FRAM crash-consistently.
+/**
+ ** The settings that outlive a reset (badge_conf, the radio frequency and
+ ** whether it's calibrated, and the ambient face) are plain variables in
+ ** RAM, in the modules that use them. Changing one just calls
+ ** persist_changed(), and persist_idle() commits them all together, once
+ ** PERSIST_COMMIT_CSECS have gone by and the main loop has nothing else to
+ ** do. So a burst of new badges costs one FRAM write, not one each.
+ **
+ ** Commits alternate between two records in INFOA, each with a version, a
+ ** sequence number and a CRC, and boot takes the newest good one. A commit
+ ** cut off by a brownout leaves a record that fails its CRC, and the other
+ ** one, from the commit before, still stands. That's also why the record
+ ** can be copied into FRAM with interrupts on: if one comes along and the
+ ** badge browns out before the copy is done, it's just another torn
+ ** commit. Interrupts are only off for the writes to SYSCFG0 that unlock
+ ** INFOA and lock it again, a few cycles each. No interrupt handler
+ ** writes FRAM.
+ **
+ ** The settings program_badge.py provisions a badge with are still written
+ ** to the start of INFOA, in the same layout as always, and are only read
+ ** when neither record is good: when INFOA has just been flashed (which
+ ** erases the records too), or on the first boot after an update from
+ ** firmware that kept its settings there.
+ **
+ ** \file persist.c
+ ** \author George Louthan
+ ** \date   2023
+ ** \copyright (c) 2023 George Louthan @duplico. MIT License.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include <msp430fr2633.h>
+
+#include "badge.h"
+#include "radio.h"
+#include "leds.h"
+#include "eyes.h"
+#include "util.h"
+#include "timer.h"
+#include "event.h"
+#include "persist.h"
+
+void persist_due();
+
+#pragma PERSISTENT(persist_provision)
+#pragma LOCATION(persist_provision, PERSIST_PROVISION_ADDR)
+/// The settings program_badge.py provisions the badge with.
+/**
+ ** This is the firmware image's INFOA, so these defaults must match
+ ** INFOA_TXT in program_badge.py. Nothing writes it at runtime.
+ */
+persist_data_t persist_provision = {
+    .badge_conf = {
+        .badge_id = BADGE_ID_UNASSIGNED,
+        .badges_seen = {0,},
+        .badges_seen_count = 1, // I've seen myself.
+    },
+    .radio_frequency = FREQ_MIN,
+    .radio_frequency_done = 0,
+    .leds_eyes_ambient = EYES_NORMAL,
+};
+
+#pragma NOINIT(persist_records)
+#pragma LOCATION(persist_records, PERSIST_RECORDS_ADDR)
+/// The two most recent commits, written alternately.
+persist_record_t persist_records[2];
+
+/// Index in persist_records of the newest good record.
+uint8_t persist_current = 1;
+/// The next record to write, built in RAM.
+persist_record_t persist_staged;
+/// Comes due PERSIST_COMMIT_CSECS after the first uncommitted change.
+sw_timer_t persist_timer = {.fire = persist_due};
+/// Set when there are changes ready for persist_idle() to commit.
+uint8_t persist_ready = 0;
+/// What's been measured about commits.
+persist_stats_t persist_stats = {0,};
+
+/// Return 1 if `record` is complete, and in this firmware's layout.
+uint8_t persist_valid(persist_record_t *record) {
+    return record->version == PERSIST_VERSION &&
+            crc16_check_buffer((uint8_t *) record, sizeof(persist_record_t) - 2);
+}
+
+/// Load the newest good record, or the provisioned settings, into RAM.
+/**
+ ** Call this before anything reads the settings. If there's no good record,
+ ** the provisioned settings are committed as one at the first chance.
+ */
+void persist_init() {
+    uint8_t valid0 = persist_valid(&persist_records[0]);
+    uint8_t valid1 = persist_valid(&persist_records[1]);
+    persist_data_t *data;
+
+    if (valid0 && valid1) {
+        // Both good: the newer one, allowing for the sequence wrapping.
+        persist_current = (int16_t) (persist_records[1].sequence -
+                                     persist_records[0].sequence) > 0;
+    } else if (valid0 || valid1) {
+        persist_current = valid1;
+    }
+
+    if (valid0 || valid1) {
+        data = &persist_records[persist_current].data;
+        persist_staged.sequence = persist_records[persist_current].sequence;
+    } else {
+        data = &persist_provision;
+        persist_ready = 1;
+    }
+
+    memcpy((void *) &badge_conf, &data->badge_conf, sizeof(badge_conf_t));
+    radio_frequency = data->radio_frequency;
+    radio_frequency_done = data->radio_frequency_done;
+    leds_eyes_ambient = data->leds_eyes_ambient;
+}
+
+/// Note that the settings have changed, so they'll be committed soon.
+void persist_changed() {
+    if (persist_stats.changes != 0xffff) {
+        persist_stats.changes++;
+    }
+
+    // The first change starts the wait; the rest ride along with it.
+    if (!persist_ready && !timer_running(&persist_timer)) {
+        timer_start(&persist_timer, PERSIST_COMMIT_CSECS);
+    }
+}
+
+/// persist_timer's callback: the changes have waited long enough.
+void persist_due() {
+    persist_ready = 1;
+}
+
+/// Commit the settings if they're ready. Call this from the main loop before it sleeps.
+void persist_idle() {
+    if (persist_ready && !event_pending) {
+        persist_commit();
+    }
+}
+
+/// Write the settings to the older record now, and make it the newest.
+void persist_commit() {
+    uint16_t start;
+    uint16_t counts;
+
+    persist_staged.version = PERSIST_VERSION;
+    persist_staged.sequence++;
+    memcpy(&persist_staged.data.badge_conf, (void *) &badge_conf, sizeof(badge_conf_t));
+    persist_staged.data.radio_frequency = radio_frequency;
+    persist_staged.data.radio_frequency_done = radio_frequency_done;
+    persist_staged.data.leds_eyes_ambient = leds_eyes_ambient;
+    crc16_append_buffer((uint8_t *) &persist_staged, sizeof(persist_record_t) - 2);
+
+    fram_protect(PFWP); // INFOA writable, main FRAM still locked.
+    start = event_now();
+    memcpy(&persist_records[!persist_current], &persist_staged, sizeof(persist_record_t));
+    counts = event_now() - start;
+    fram_protect(DFWP | PFWP);
+
+    persist_current = !persist_current;
+    persist_ready = 0;
+    timer_stop(&persist_timer);
+
+    if (persist_stats.commits != 0xffff) {
+        persist_stats.commits++;
+    }
+    if (counts > persist_stats.write_max) {
+        persist_stats.write_max = counts;
+    }
+    if (persist_stats.write_total <= 0xffffffff - counts) {
+        persist_stats.write_total += counts;
+    }
+}
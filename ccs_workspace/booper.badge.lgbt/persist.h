@@ -0,0 +1,70 @@
+/// Header for the badge's persistent settings.
+/**
+ ** \file persist.h
+ ** \author George Louthan
+ ** \date   2023
+ ** \copyright (c) 2023 George Louthan @duplico. MIT License.
+ */
+
+#ifndef PERSIST_H_
+#define PERSIST_H_
+
+#include <stdint.h>
+
+#include "badge.h"
+
+/// Layout version of persist_record_t; bump it if the record changes.
+#define PERSIST_VERSION 1
+/// Where program_badge.py writes the provisioned settings: the start of INFOA.
+#define PERSIST_PROVISION_ADDR 0x1800
+/// Where the two committed records live in INFOA.
+#define PERSIST_RECORDS_ADDR 0x1900
+/// Ticks from the first change until it's committed, to batch up any more.
+#define PERSIST_COMMIT_CSECS 6000
+
+/// The persistent settings, laid out the way program_badge.py writes them.
+/**
+ ** This matches INFOA_TXT in program_badge.py byte for byte, since it's
+ ** what used to be the separate PERSISTENT variables, in link order.
+ */
+typedef struct {
+    badge_conf_t badge_conf;
+    uint8_t radio_frequency;
+    uint8_t radio_frequency_done;
+    uint8_t leds_eyes_ambient;
+} persist_data_t;
+
+/// One committed copy of the persistent settings.
+typedef struct {
+    /// PERSIST_VERSION when it was written.
+    uint16_t version;
+    /// Up by one with each commit, so the newer of two good records wins.
+    uint16_t sequence;
+    persist_data_t data;
+    uint16_t crc;
+} persist_record_t;
+
+/// What's been measured about commits, for tuning from the debugger.
+/**
+ ** Times are in ACLK counts (EVENT_COUNTS_PER_SEC), so a commit that's
+ ** done inside one count reads as 0. The counters stick at their maximum.
+ */
+typedef struct {
+    /// Changes to the settings; each of these used to be its own FRAM write.
+    uint16_t changes;
+    /// Records written, each covering every change since the last one.
+    uint16_t commits;
+    /// Longest one commit's copy into FRAM has taken.
+    uint16_t write_max;
+    /// Total time commits have spent copying into FRAM.
+    uint32_t write_total;
+} persist_stats_t;
+
+extern persist_stats_t persist_stats;
+
+void persist_init();
+void persist_changed();
+void persist_idle();
+void persist_commit();
+
+#endif /* PERSIST_H_ */
@@ -17,25 +17,341 @@
 #include "rfm75.h"
 #include "rtc.h"
 #include "leds.h"
+#include "sniffer.h"
+#include "persist.h"
+#include "enclog.h"
+#include "rng.h"
 
 /// An array of all badges and we can currently see.
 badge_info_t ids_in_range[BADGES_IN_SYSTEM] = {0};
+/// Bitset of the badges in ids_in_range that are in range.
+uint16_t radio_in_range[BADGES_SET_WORDS] = {0,};
 /// The current radio packet we're sending (or just sent).
 radio_proto_t curr_packet_tx;
 
 uint16_t rx_cnt[FREQ_NUM] = {0,};
 
-#pragma PERSISTENT(radio_frequency)
+// These two are persistent, loaded and saved by persist.c.
 uint8_t radio_frequency = FREQ_MIN; // Our target will be FREQ_MIN + FREQ_NUM / 2
-#pragma PERSISTENT(radio_frequency_done)
 uint8_t radio_frequency_done = 0;
 
 /// Current count of badges in range, not including ourself.
 uint8_t radio_badges_in_range = 0;
+/// Calls to radio_interval() since boot: the encounter log's clock.
+uint16_t radio_intervals = 0;
+
+/// The channel the radio is currently tuned to.
+uint8_t radio_channel = 0xff;
+/// The RF_PWR level the radio is currently set to.
+uint8_t radio_tx_power = RADIO_TX_POWER_MAX;
+/// Sequence number of our latest boop.
+uint8_t radio_boop_seq = 0;
+
+#if RADIO_TPC
+// Transmit power control
+//
+// In a crowded room, a full-power beacon reaches (and collides with) far
+// more badges than it needs to. So, every beacon interval we count how
+// many badges we've heard recently, and step our power down a level when
+// that's over the limit for our current level, or back up a level when
+// it's comfortably under the limit for the level above. Boop relays get
+// their own, stingier limits: in a crowd there are plenty of other badges
+// relaying the same boop. Our own boops always go out at full power.
+
+/// Nearby-badge counts above which beacons step down from each power level.
+const uint8_t radio_tpc_beacon_limits[RADIO_TX_POWER_MAX+1] = {0, 24, 16, 8};
+/// Nearby-badge counts above which boop relays step down from each power level.
+const uint8_t radio_tpc_relay_limits[RADIO_TX_POWER_MAX+1] = {0, 16, 10, 4};
+/// Power level for our beacons.
+uint8_t radio_tx_power_beacon = RADIO_TX_POWER_MAX;
+/// Power level for relaying other badges' boops.
+uint8_t radio_tx_power_relay = RADIO_TX_POWER_MAX;
+/// Beacon intervals to wait before the next power change.
+uint8_t radio_tpc_hold = 0;
+/// Number of badges heard in the last RADIO_TPC_WINDOW_INTERVALS intervals.
+uint8_t radio_badges_nearby = 0;
+
+/// Return the power level one step from `level` toward the right one for `nearby`.
+/**
+ ** Stepping back up requires being a quarter under the limit for the level
+ ** above, so that we don't flap between two levels.
+ */
+uint8_t radio_tpc_step(uint8_t level, const uint8_t *limits, uint8_t nearby) {
+    if (level && nearby > limits[level]) {
+        return level - 1;
+    }
+    if (level < RADIO_TX_POWER_MAX &&
+            nearby < limits[level+1] - (limits[level+1] >> 2)) {
+        return level + 1;
+    }
+    return level;
+}
+
+/// Update our transmit power levels from the number of badges nearby.
+void radio_tpc_update() {
+    uint8_t beacon_power;
+    uint8_t relay_power;
+
+    if (radio_tpc_hold) {
+        radio_tpc_hold--;
+        return;
+    }
+
+    beacon_power = radio_tpc_step(radio_tx_power_beacon,
+                                  radio_tpc_beacon_limits, radio_badges_nearby);
+    relay_power = radio_tpc_step(radio_tx_power_relay,
+                                 radio_tpc_relay_limits, radio_badges_nearby);
+
+    if (beacon_power != radio_tx_power_beacon || relay_power != radio_tx_power_relay) {
+        // Give the neighborhood time to settle at the new level.
+        radio_tpc_hold = RADIO_TPC_HOLD_INTERVALS;
+    }
+
+    radio_tx_power_beacon = beacon_power;
+    radio_tx_power_relay = relay_power;
+}
+#endif
+
+#if RADIO_HOPPING
+// Channel hopping
+//
+// Every badge in sync shares one clock, carried in every beacon. Time is
+// divided into frames of RADIO_BEACON_INTERVAL_SECS seconds, and each badge
+// beacons in the one-second slot of each frame given by its ID. The badges
+// that share a slot are given different channel offsets, so in any one
+// slot they transmit on different channels instead of all piling onto
+// one. The channel for offset `o` in frame `f` is entry (f + o) of the
+// hopping sequence. A listener walks through the offsets, one per frame,
+// so it still hears everyone, just on different frames.
+//
+// Badges that aren't in sync (yet) just sit on their home channel, which
+// is always in the sequence. That's where newcomers find their first
+// beacon to sync with.
+//
+// Channels that are busy with something else get skipped, but only if
+// every badge skips them, or badges would listen where their neighbors
+// aren't sending. So the skipped channels only change at the start of an
+// assessment period, on the shared clock. In the first half of a period,
+// beacons carry the channels skipped now. Halfway through, each badge
+// proposes the channels its own carrier-detect samples found busy, and
+// for the rest of the period beacons carry the union of every proposal
+// heard so far, flagged RADIO_HOP_PAYLOAD_NEXT. At the start of the next
+// period, everybody switches to the union they've ended up with. A badge
+// that missed a proposal hears the difference early in the period and
+// skips the extra channels from the next frame on. Newcomers take the
+// skipped channels, as well as the clock, from the badge they sync to.
+
+/// Hopping sequence. Entry 0 is replaced by our calibrated home channel, and
+///  the rest sit in the gaps around Wi-Fi channels 1, 6, and 11, scrambled
+///  so that consecutive hops land far apart. Those are nominal channels;
+///  radio_hop_channel() corrects them for our crystal, like the home one.
+const uint8_t radio_hop_channels[RADIO_HOP_CHANNEL_COUNT] = {0, 49, 78, 24, 80, 74};
+/// Bitfield of hopping sequence entries currently skipped as congested.
+uint8_t radio_hop_mask = 0;
+/// The skipped entries to switch to at the start of the next frame.
+uint8_t radio_hop_mask_pending = 0;
+/// The skipped entries proposed so far for the next assessment period.
+uint8_t radio_hop_proposal = 0;
+/// Whether we know which entries the badges around us are skipping.
+uint8_t radio_hop_agreed = 0;
+/// Which half of which assessment period we last handled.
+uint8_t radio_hop_half = 0;
+/// The hopping sequence entries in use, after skipping congested channels.
+uint8_t radio_hop_list[RADIO_HOP_CHANNEL_COUNT];
+/// Number of valid entries in radio_hop_list.
+uint8_t radio_hop_len = 0;
+/// Whether we're following the shared clock and hopping.
+uint8_t radio_hop_synced = 0;
+/// Frames left before we give up on the shared clock and return home.
+uint8_t radio_hop_sync_frames_left = 0;
+/// Which entry of radio_hop_channels we're listening to.
+uint8_t radio_hop_listen_index = 0;
+/// The centisecond within our beacon slot that we'll transmit in.
+uint8_t radio_hop_tx_csecs = 0;
+/// The next radio_hop_list entry to repeat the current boop on.
+uint8_t radio_hop_boop_next = 0;
+/// Number of carrier-detect samples taken per channel this period.
+uint16_t radio_hop_samples[RADIO_HOP_CHANNEL_COUNT] = {0,};
+/// Number of carrier-detect samples that were busy per channel this period.
+uint16_t radio_hop_busy[RADIO_HOP_CHANNEL_COUNT] = {0,};
+
+/// Rebuild the hopping sequence from the congested channel mask.
+void radio_hop_build() {
+    uint8_t mask = radio_hop_mask & ~BIT0; // Never skip home.
+
+    if (RADIO_HOP_CHANNEL_COUNT - bitset_word_count(mask) < RADIO_HOP_MIN_CHANNELS) {
+        // Too much is congested to skip it all. Use everything.
+        mask = 0;
+    }
+
+    radio_hop_len = 0;
+    for (uint8_t i=0; i<RADIO_HOP_CHANNEL_COUNT; i++) {
+        if (!(mask & (BIT0 << i))) {
+            radio_hop_list[radio_hop_len++] = i;
+        }
+    }
+}
+
+/// Return the channel number of hopping sequence entry `index`.
+uint8_t radio_hop_channel(uint8_t index) {
+    int16_t channel;
+
+    if (!index) {
+        return radio_frequency;
+    }
+
+    // The calibration moved our home channel off FREQ_NOMINAL to make up
+    //  for our crystal's offset, and every other channel is off by as much.
+    channel = radio_hop_channels[index] + radio_frequency - FREQ_NOMINAL;
+    if (channel < 0) {
+        return 0;
+    }
+    if (channel > RADIO_CHANNEL_MAX) {
+        return RADIO_CHANNEL_MAX;
+    }
+    return channel;
+}
+
+/// Return 1 if we're hopping, or 0 if we're staying on our home channel.
+uint8_t radio_hopping() {
+    return radio_hop_synced && radio_hop_agreed && radio_frequency_done;
+}
+
+/// Return the half-period of the shared clock, whose low bit is 1 in the second half.
+uint8_t radio_hop_half_now() {
+    return ((uint16_t) rtc_seconds) / (RADIO_HOP_ASSESS_SECS / 2);
+}
+
+/// Return the current frame number of the shared clock.
+uint16_t radio_hop_frame() {
+    return ((uint16_t) rtc_seconds) / RADIO_BEACON_INTERVAL_SECS;
+}
+
+/// Return the hopping sequence entry that badge `id` is listening to right now.
+uint8_t radio_hop_listen_entry(uint16_t id) {
+    // The listening offset is (frame + badge_id), which walks through all
+    //  the offsets, and is added to the frame number to get the entry.
+    return radio_hop_list[(2*radio_hop_frame() + id) % radio_hop_len];
+}
+
+/// Return the channel we should be listening to right now.
+uint8_t radio_listen_channel() {
+    if (!radio_hopping()) {
+        radio_hop_listen_index = 0;
+        return radio_frequency;
+    }
+
+#if RADIO_SNIFFER
+    // A sniffer wants to see every channel equally, so it takes them in turn.
+    radio_hop_listen_index = radio_hop_list[radio_hop_frame() % radio_hop_len];
+#else
+    radio_hop_listen_index = radio_hop_listen_entry(badge_conf.badge_id);
+#endif
+    return radio_hop_channel(radio_hop_listen_index);
+}
+
+/// Return the channel our beacon should go out on right now.
+uint8_t radio_beacon_channel() {
+    if (!radio_hopping()) {
+        return radio_frequency;
+    }
+
+    // Badges sharing our slot differ in badge_id / RADIO_BEACON_INTERVAL_SECS.
+    return radio_hop_channel(radio_hop_list[
+        (radio_hop_frame() + badge_conf.badge_id / RADIO_BEACON_INTERVAL_SECS) % radio_hop_len
+    ]);
+}
+
+/// Follow the shared clock in a beacon, if appropriate.
+/**
+ ** Everybody follows whichever clock is ahead, which converges a whole room
+ ** on the fastest clock in it. A badge that is in sync never follows one
+ ** that isn't; the newcomer will follow us once it hears us. A newcomer,
+ ** however, always follows a badge that's in sync, even if it's "behind."
+ ** Only the lower 16 bits of the seconds are shared, so going forward to
+ ** a clock that's behind is just a matter of wrapping around.
+ **
+ ** The badge whose clock we take up is where we take the skipped channels
+ ** from, too. Otherwise their proposals for the next period are merged
+ ** with ours in the second half of the period, and in the first half,
+ ** channels they skip that we don't are skipped from the next frame.
+ */
+void radio_hop_sync(radio_proto_t *msg) {
+    uint8_t their_sync = msg->msg_payload & RADIO_HOP_PAYLOAD_SYNCED;
+    uint8_t their_next = msg->msg_payload & RADIO_HOP_PAYLOAD_NEXT;
+    uint8_t their_mask = msg->msg_payload & RADIO_HOP_PAYLOAD_MASK;
+    uint8_t half;
+    int32_t diff = (int16_t) (msg->clock_secs - (uint16_t) rtc_seconds);
+    diff = diff*100 + msg->clock_csecs - rtc_centiseconds;
+
+    if (radio_hop_synced && !their_sync) {
+        return;
+    }
+
+    if (diff < 0 && their_sync && !radio_hop_synced) {
+        diff += 6553600; // Wrap forward to their clock.
+    }
+
+    if (diff > 0) {
+        rtc_advance(diff);
+    } else if (diff < -RADIO_HOP_SYNC_TOLERANCE_CSECS) {
+        // They're behind us; they'll come to us.
+        return;
+    }
+
+    // We're now on the same clock as they are.
+    half = radio_hop_half_now();
+    if (!radio_hop_synced || (uint8_t) (half - radio_hop_half) > 1) {
+        // It's a new clock to us, so what we were skipping doesn't count.
+        radio_hop_half = half;
+        radio_hop_proposal = their_mask;
+        if (their_next && (half & 1)) {
+            // They're skipping something, but all we know is what's next.
+            radio_hop_agreed = 0;
+        } else {
+            // Either that's what they skip now, or what they were about to
+            //  switch to when they sent it.
+            radio_hop_mask = their_mask;
+            radio_hop_mask_pending = their_mask;
+            radio_hop_agreed = 1;
+            radio_hop_build();
+        }
+    } else if (half == radio_hop_half) {
+        // (If it isn't, radio_second() has yet to start the new half.)
+        if (their_next && (half & 1)) {
+            radio_hop_proposal |= their_mask;
+        } else if (!their_next && !(half & 1)) {
+            // They've heard a proposal that we missed. Catch up next frame.
+            radio_hop_mask_pending |= their_mask;
+        }
+    }
+
+    radio_hop_synced = 1;
+    radio_hop_sync_frames_left = RADIO_HOP_SYNC_TIMEOUT_FRAMES;
+}
+
+/// Propose skipping the channels our own carrier-detect samples found busy.
+/**
+ ** Our own beacons use a tiny fraction of the airtime, so a channel where
+ ** carrier detect is set most of the time that we sample it is busy with
+ ** something else, like Wi-Fi.
+ */
+void radio_hop_propose() {
+    radio_hop_proposal = 0;
+    for (uint8_t i=0; i<RADIO_HOP_CHANNEL_COUNT; i++) {
+        if (radio_hop_samples[i] >= 8 && radio_hop_busy[i] > radio_hop_samples[i] / 2) {
+            radio_hop_proposal |= BIT0 << i;
+        }
+        radio_hop_samples[i] = 0;
+        radio_hop_busy[i] = 0;
+    }
+    radio_hop_proposal &= RADIO_HOP_PAYLOAD_MASK;
+}
+#endif
 
 uint8_t validate(radio_proto_t *msg, uint8_t len) {
     if (len != sizeof(radio_proto_t)) {
-        // PROBLEM
+        // PROBLEM, or a version 1 badge (see RADIO_PROTO_VER).
         return 0;
     }
 
@@ -62,13 +378,184 @@ void radio_handle_beacon(uint16_t id) {
         // This badge is not currently in range.
         // Tell the badge system to mark it as newly in range.
         radio_badges_in_range++;
+        bitset_set(radio_in_range, id);
         badge_update_queerdar_count(radio_badges_in_range);
         badge_set_seen(id);
+        ids_in_range[id].first_heard = radio_intervals;
+        ids_in_range[id].boops = 0;
     }
     // Mark it as recently seen.
     ids_in_range[id].intervals_left = RADIO_WINDOW_BEACON_COUNT;
 }
 
+/// Tune the radio to `channel`, if it isn't there already.
+void radio_set_channel(uint8_t channel) {
+    if (channel == radio_channel) {
+        return;
+    }
+    radio_channel = channel;
+    rfm75_write_reg(RF_CH, channel);
+}
+
+/// Set the radio's transmit power level, if it isn't there already.
+void radio_set_power(uint8_t level) {
+    if (level == radio_tx_power) {
+        return;
+    }
+    radio_tx_power = level;
+    rfm75_write_reg(RF_SETUP, RADIO_RF_SETUP_BASE | (level << 1));
+}
+
+/// Stamp and send curr_packet_tx on `channel` at power level `power`.
+void radio_tx_curr(uint8_t channel, uint8_t power) {
+    if (RADIO_SNIFFER || !rfm75_tx_avail()) {
+        return; // Busy, or a sniffer, which never transmits.
+    }
+
+    curr_packet_tx.proto_version = RADIO_PROTO_VER;
+    if (curr_packet_tx.msg_type == RADIO_MSG_TYPE_BEACON) {
+        // Everything else uses the clock's place for its own purposes.
+        curr_packet_tx.clock_csecs = rtc_centiseconds;
+        curr_packet_tx.clock_secs = (uint16_t) rtc_seconds;
+    }
+    crc16_append_buffer((uint8_t *)&curr_packet_tx, sizeof(radio_proto_t)-2);
+
+    radio_set_channel(channel);
+    radio_set_power(power);
+    rfm75_tx(RFM75_BROADCAST_ADDR, 1, (uint8_t *)&curr_packet_tx,
+             RFM75_PAYLOAD_SIZE);
+}
+
+#if RADIO_BOOP_REPORTS
+// Boop reports
+//
+// Every badge that relays a boop remembers which badge it first heard the
+// boop from, its parent. The relays form a tree rooted at the booper, and
+// once a relay has given its own children time to report, it sends its
+// parent one report with the number of badges reached through it. So the
+// booper hears one report from each of its children, rather than one from
+// every badge the boop reached.
+//
+// A badge with `h` hops of the boop left to go reports `h` hop windows
+// after it hears the boop, and its children, who have `h-1` hops left,
+// report a window before that. Each report goes out on the channel its
+// parent is listening to.
+
+/// Boops we're relaying or have booped, and are waiting to report on.
+radio_boop_t radio_boops[RADIO_BOOP_TABLE_SIZE] = {0,};
+
+/// Value of radio_boop_t.parent once we've reported on the boop.
+#define RADIO_BOOP_REPORTED 0xff
+
+/// Return our entry for `origin`'s boop `seq`, or a free one if we have none.
+/**
+ ** Returns 0 if there's no entry for the boop and the table is full.
+ */
+radio_boop_t *radio_boop_find(uint8_t origin, uint8_t seq) {
+    radio_boop_t *free_entry = 0;
+
+    for (uint8_t i=0; i<RADIO_BOOP_TABLE_SIZE; i++) {
+        if (!radio_boops[i].csecs_left) {
+            if (!free_entry) {
+                free_entry = &radio_boops[i];
+            }
+        } else if (radio_boops[i].origin == origin && radio_boops[i].seq == seq) {
+            return &radio_boops[i];
+        }
+    }
+    return free_entry;
+}
+
+/// Start keeping track of a boop we've just heard for the first time.
+/**
+ ** Returns 1 if this is the first copy we've heard of it, and 0 otherwise.
+ ** If the table is full, we still relay the boop, but we won't report on it.
+ */
+uint8_t radio_boop_join(radio_proto_t *msg) {
+    radio_boop_t *boop;
+
+    if (msg->proto_version != RADIO_PROTO_VER) {
+        // A version 2 boop, with the booper's clock where we'd look for its
+        //  sequence number: relay it, but don't report on it. (Version 1
+        //  boops are the wrong size, and validate() never lets them in.)
+        return 1;
+    }
+
+    boop = radio_boop_find(msg->badge_id, RADIO_BOOP_SEQ(msg));
+    if (!boop) {
+        return 1;
+    }
+    if (boop->csecs_left) {
+        return 0;
+    }
+
+    boop->origin = msg->badge_id;
+    boop->seq = RADIO_BOOP_SEQ(msg);
+    boop->parent = RADIO_BOOP_FROM(msg);
+    boop->count = 1; // Ourself.
+    boop->csecs_left = 1 + msg->msg_payload * RADIO_BOOP_REPORT_CSECS_PER_HOP +
+            rng_below(RADIO_BOOP_REPORT_JITTER_CSECS);
+    return 1;
+}
+
+/// Add a child's report to our count for its boop.
+void radio_boop_report_rx(radio_proto_t *msg) {
+    radio_boop_t *boop;
+
+    if (RADIO_BOOP_TO(msg) != badge_conf.badge_id) {
+        return; // Not our child.
+    }
+
+    boop = radio_boop_find(msg->badge_id, RADIO_BOOP_SEQ(msg));
+    if (!boop || !boop->csecs_left || boop->parent == RADIO_BOOP_REPORTED) {
+        return; // Too late.
+    }
+
+    if (boop->count > UINT8_MAX - msg->msg_payload) {
+        boop->count = UINT8_MAX;
+    } else {
+        boop->count += msg->msg_payload;
+    }
+}
+
+/// Report on `boop` to its parent, or show its reach if it's ours.
+/**
+ ** Returns 0 if the radio is busy and we need to try again later.
+ */
+uint8_t radio_boop_report_tx(radio_boop_t *boop) {
+    uint8_t channel = radio_frequency;
+
+    if (boop->origin == badge_conf.badge_id) {
+        // Our own boop. We don't count ourself.
+        leds_show_number(boop->count > 101 ? 100 : boop->count - 1,
+                         RADIO_BOOP_REACH_SHOW_CSECS);
+        return 1;
+    }
+
+    if (!rfm75_tx_avail()) {
+        return 0;
+    }
+
+    curr_packet_tx.badge_id = boop->origin;
+    curr_packet_tx.msg_type = RADIO_MSG_TYPE_ACK;
+    curr_packet_tx.msg_payload = boop->count;
+    RADIO_BOOP_SEQ(&curr_packet_tx) = boop->seq;
+    curr_packet_tx.clock_secs = badge_conf.badge_id | ((uint16_t) boop->parent << 8);
+
+#if RADIO_HOPPING
+    if (radio_hopping()) {
+        channel = radio_hop_channel(radio_hop_listen_entry(boop->parent));
+    }
+#endif
+#if RADIO_TPC
+    radio_tx_curr(channel, radio_tx_power_relay);
+#else
+    radio_tx_curr(channel, RADIO_TX_POWER_MAX);
+#endif
+    return 1;
+}
+#endif
+
 /// Called when the transmission of `curr_packet` has either finished or failed.
 void radio_tx_done(uint8_t ack) {
     switch(curr_packet_tx.msg_type) {
@@ -76,7 +563,22 @@ void radio_tx_done(uint8_t ack) {
             // We just sent a beacon.
             // There's no state that needs to be cleared at this point.
             break;
+#if RADIO_HOPPING
+        case RADIO_MSG_TYPE_BOOP:
+            // Listeners are spread over every channel, so repeat boops on all.
+            if (radio_hopping() && radio_hop_boop_next < radio_hop_len) {
+                radio_tx_curr(radio_hop_channel(radio_hop_list[radio_hop_boop_next++]),
+                              radio_tx_power);
+                return;
+            }
+            break;
+#endif
     }
+
+#if RADIO_HOPPING
+    // Go back to where we're supposed to be listening.
+    radio_set_channel(radio_listen_channel());
+#endif
 }
 
 /// Start a radio frequency calibration.
@@ -89,21 +591,173 @@ void radio_tx_done(uint8_t ack) {
  * should happen after assembly and prior to shipping.
  */
 void radio_start_calibration() {
-    fram_unlock();
     radio_frequency_done = 0;
     radio_frequency = FREQ_MIN;
-    fram_lock();
+    persist_changed();
 
     for (uint8_t i=0; i<FREQ_NUM; i++) {
-        rx_cnt[FREQ_MIN + i] = 0;
+        rx_cnt[i] = 0;
+    }
+    radio_set_channel(radio_frequency);
+}
+
+/// Do our once-per-second radio housekeeping. Call this from the 1 Hz loop.
+void radio_second() {
+#if RADIO_HOPPING
+    uint16_t secs = (uint16_t) rtc_seconds;
+
+    if (!radio_frequency_done) {
+        return; // The calibration owns the channel for now.
+    }
+
+    if (radio_hop_synced && rfm75_tx_avail()) {
+        // Sample carrier detect on the channel we've been listening to.
+        radio_hop_samples[radio_hop_listen_index]++;
+        if (rfm75_read_reg(CD) & BIT0) {
+            radio_hop_busy[radio_hop_listen_index]++;
+        }
+    }
+
+    if (radio_hop_half_now() != radio_hop_half) {
+        radio_hop_half = radio_hop_half_now();
+        if (radio_hop_half & 1) {
+            // Halfway through the period. Time to propose the next one.
+            radio_hop_propose();
+        } else {
+            // New period. Everybody switches to what was proposed.
+            radio_hop_mask = radio_hop_proposal;
+            radio_hop_mask_pending = radio_hop_proposal;
+            radio_hop_agreed = 1;
+            radio_hop_build();
+        }
+    }
+
+    if (secs % RADIO_BEACON_INTERVAL_SECS == 0 && radio_hop_mask != radio_hop_mask_pending) {
+        radio_hop_mask = radio_hop_mask_pending;
+        radio_hop_build();
+    }
+
+    if (secs % RADIO_BEACON_INTERVAL_SECS == 0 && radio_hop_synced) {
+        // New frame.
+        radio_hop_sync_frames_left--;
+        if (!radio_hop_sync_frames_left) {
+            // Haven't heard anybody on our clock in ages. Go home.
+            radio_hop_synced = 0;
+        }
     }
-    rfm75_write_reg(0x05, radio_frequency);
+
+    if (secs % RADIO_BEACON_INTERVAL_SECS == badge_conf.badge_id % RADIO_BEACON_INTERVAL_SECS) {
+        // Our beacon slot. Pick a random time in it, clear of its edges.
+        radio_hop_tx_csecs = RADIO_HOP_GUARD_CSECS +
+                rng_below(100 - 2*RADIO_HOP_GUARD_CSECS);
+    }
+
+    if (rfm75_tx_avail()) {
+        // If we're mid-transmission, radio_tx_done() will take care of this.
+        radio_set_channel(radio_listen_channel());
+    }
+#endif
+}
+
+/// Do our 100 Hz radio housekeeping. Call this from the 100 Hz loop.
+void radio_timestep() {
+#if RADIO_BOOP_REPORTS
+    for (uint8_t i=0; i<RADIO_BOOP_TABLE_SIZE; i++) {
+        radio_boop_t *boop = &radio_boops[i];
+
+        if (boop->csecs_left > 1) {
+            boop->csecs_left--;
+        } else if (boop->csecs_left && boop->parent == RADIO_BOOP_REPORTED) {
+            boop->csecs_left = 0; // Done holding it; forget it.
+        } else if (boop->csecs_left && radio_boop_report_tx(boop)) {
+            boop->parent = RADIO_BOOP_REPORTED;
+            boop->csecs_left = RADIO_BOOP_HOLD_CSECS;
+        }
+    }
+#endif
+}
+
+/// Return how many timesteps until radio_timestep() next has anything to do.
+/**
+ ** This is RADIO_DEADLINE_NONE if there are no boops to report on.
+ */
+uint16_t radio_next_deadline() {
+    uint16_t csecs = RADIO_DEADLINE_NONE;
+
+#if RADIO_BOOP_REPORTS
+    for (uint8_t i=0; i<RADIO_BOOP_TABLE_SIZE; i++) {
+        if (radio_boops[i].csecs_left && radio_boops[i].csecs_left < csecs) {
+            csecs = radio_boops[i].csecs_left;
+        }
+    }
+#endif
+
+    return csecs;
+}
+
+/// Account for timesteps skipped, which must be fewer than radio_next_deadline().
+void radio_skip(uint16_t csecs) {
+#if RADIO_BOOP_REPORTS
+    for (uint8_t i=0; i<RADIO_BOOP_TABLE_SIZE; i++) {
+        if (radio_boops[i].csecs_left) {
+            radio_boops[i].csecs_left -= csecs;
+        }
+    }
+#endif
+}
+
+/// Return how many seconds from this one until the radio next needs the 1 Hz loop.
+/**
+ ** That's the next second that radio_second() has something to do in, or
+ ** that our beacon is due in. While we're calibrating, or following the
+ ** shared clock (when we sample carrier detect every second), that's every
+ ** second. Otherwise it's just frame boundaries and our own slot.
+ */
+uint8_t radio_next_second() {
+    uint8_t sec = rtc_seconds % RADIO_BEACON_INTERVAL_SECS;
+    uint8_t slot = badge_conf.badge_id % RADIO_BEACON_INTERVAL_SECS;
+    uint8_t secs;
+
+#if RADIO_HOPPING
+    if (!radio_frequency_done || radio_hop_synced) {
+        return 1;
+    }
+#endif
+
+    for (secs = 1; secs < RADIO_BEACON_INTERVAL_SECS; secs++) {
+        uint8_t next = (sec + secs) % RADIO_BEACON_INTERVAL_SECS;
+
+        if (next == slot || (RADIO_HOPPING && !next)) {
+            break;
+        }
+    }
+    return secs;
+}
+
+/// Return how many csecs until it's time to send a beacon that's due in this slot.
+uint8_t radio_tx_slot_wait() {
+#if RADIO_HOPPING
+    if (radio_hop_synced && rtc_centiseconds < radio_hop_tx_csecs) {
+        return radio_hop_tx_csecs - rtc_centiseconds;
+    }
+#endif
+    return 0;
+}
+
+/// Return 1 if it's time to send a beacon that's due in this slot.
+uint8_t radio_tx_slot_open() {
+    return !radio_tx_slot_wait();
 }
 
 /// Callback function for when the RFM75 module receives a valid radio packet.
 void radio_rx_done(uint8_t* data, uint8_t len, uint8_t pipe) {
     radio_proto_t *msg = (radio_proto_t *) data;
 
+#if RADIO_SNIFFER
+    // Everything goes out the serial port, valid or not.
+    sniffer_record(radio_channel, pipe, data, len);
+#endif
+
     if (!radio_frequency_done) {
         rx_cnt[radio_frequency - FREQ_MIN]++;
     }
@@ -116,35 +770,98 @@ void radio_rx_done(uint8_t* data, uint8_t len, uint8_t pipe) {
     if (badge_block_radio_game)
         return; // Not ready to play the game yet.
 
+#if RADIO_HOPPING
+    if (msg->msg_type == RADIO_MSG_TYPE_BEACON) {
+        radio_hop_sync(msg);
+    }
+#endif
+
     switch(msg->msg_type) {
     case RADIO_MSG_TYPE_BOOP:
         if (msg->badge_id == badge_conf.badge_id)
             break; // Retransmission of our own message
+#if RADIO_BOOP_REPORTS
+        if (!radio_boop_join(msg))
+            break; // We've already heard this one, on another channel.
+#endif
         leds_boop();
 
         // Also, retransmit if appropriate:
         if (msg->msg_payload) {
-            radio_boop(msg->badge_id, msg->msg_payload-1);
+            radio_boop_relay(msg);
+        }
+        // Also handle this as a beacon, which puts the booper in range if
+        //  it wasn't, and count the boop toward our encounter with it.
+        radio_handle_beacon(msg->badge_id);
+        if (msg->badge_id < BADGES_IN_SYSTEM &&
+                ids_in_range[msg->badge_id].intervals_left &&
+                ids_in_range[msg->badge_id].boops < UINT8_MAX) {
+            ids_in_range[msg->badge_id].boops++;
         }
-        // Fall through and also handle this as a beacon.
+        break;
     case RADIO_MSG_TYPE_BEACON:
         // Handle a beacon.
         radio_handle_beacon(msg->badge_id);
         break;
+#if RADIO_BOOP_REPORTS
+    case RADIO_MSG_TYPE_ACK:
+        radio_boop_report_rx(msg);
+        break;
+#endif
     }
 }
 
-/// Send a radio message that we've done a boop.
-void radio_boop(uint8_t badge_id, uint8_t seq) {
-    curr_packet_tx.proto_version = RADIO_PROTO_VER;
+/// Send the boop in curr_packet_tx, on every channel we're hopping over.
+void radio_boop_tx(uint8_t power) {
+#if RADIO_HOPPING
+    if (radio_hopping()) {
+        // Start at the top of the sequence; radio_tx_done() does the rest.
+        radio_hop_boop_next = 1;
+        radio_tx_curr(radio_hop_channel(radio_hop_list[0]), power);
+        return;
+    }
+#endif
+    radio_tx_curr(radio_frequency, power);
+}
+
+/// Pass along a boop that we've just heard, with one fewer hop left.
+void radio_boop_relay(radio_proto_t *msg) {
+    curr_packet_tx.badge_id = msg->badge_id;
+    curr_packet_tx.msg_type = RADIO_MSG_TYPE_BOOP;
+    curr_packet_tx.msg_payload = msg->msg_payload - 1;
+    RADIO_BOOP_SEQ(&curr_packet_tx) = RADIO_BOOP_SEQ(msg);
+    // We're the parent of anyone who hears it first from us.
+    curr_packet_tx.clock_secs = (uint8_t) badge_conf.badge_id;
+
+#if RADIO_TPC
+    radio_boop_tx(radio_tx_power_relay);
+#else
+    radio_boop_tx(RADIO_TX_POWER_MAX);
+#endif
+}
+
+/// Send a radio message that we've done a boop, to go `hops` hops.
+void radio_boop(uint8_t badge_id, uint8_t hops) {
     curr_packet_tx.badge_id = badge_id;
     curr_packet_tx.msg_type = RADIO_MSG_TYPE_BOOP;
-    curr_packet_tx.msg_payload = seq;
-    crc16_append_buffer((uint8_t *)&curr_packet_tx, sizeof(radio_proto_t)-2);
+    curr_packet_tx.msg_payload = hops;
+    RADIO_BOOP_SEQ(&curr_packet_tx) = ++radio_boop_seq;
+    curr_packet_tx.clock_secs = (uint8_t) badge_id;
 
-    // Send our boop.
-    rfm75_tx(RFM75_BROADCAST_ADDR, 1, (uint8_t *)&curr_packet_tx,
-             RFM75_PAYLOAD_SIZE);
+#if RADIO_BOOP_REPORTS
+    radio_boop_t *boop = radio_boop_find(badge_id, radio_boop_seq);
+    if (boop) {
+        // Our children report a window before we would, so give them
+        //  until then, and then show how far the boop got.
+        boop->origin = badge_id;
+        boop->seq = radio_boop_seq;
+        boop->parent = badge_id;
+        boop->count = 1;
+        boop->csecs_left = (hops + 1) * RADIO_BOOP_REPORT_CSECS_PER_HOP;
+    }
+#endif
+
+    radio_boop_tx(RADIO_TX_POWER_MAX);
 }
 
 /// Do our regular radio and queerdar interval actions.
@@ -155,33 +872,75 @@ void radio_boop(uint8_t badge_id, uint8_t seq) {
  * this function has MANY side effects. Use rfm75_tx_avail() for this.
  */
 void radio_interval() {
-    for (uint16_t i=0; i<BADGES_IN_SYSTEM; i++) {
-        if (ids_in_range[i].intervals_left) {
-            // Currently in range.
-            ids_in_range[i].intervals_left--;
-            if (!ids_in_range[i].intervals_left) {
-                // Just aged out.
-                radio_badges_in_range--;
-                badge_update_queerdar_count(radio_badges_in_range);
-            }
+    uint8_t power = RADIO_TX_POWER_MAX;
+
+    radio_intervals++;
+#if RADIO_TPC
+    radio_badges_nearby = 0;
+#endif
+    // Only the badges in range, skipping the rest a word at a time.
+    for (uint16_t i = bitset_next(radio_in_range, BADGES_SET_WORDS, 0);
+            i != BITSET_NONE;
+            i = bitset_next(radio_in_range, BADGES_SET_WORDS, i + 1)) {
+        ids_in_range[i].intervals_left--;
+        if (!ids_in_range[i].intervals_left) {
+            // Just aged out, RADIO_WINDOW_BEACON_COUNT after we last heard it.
+            radio_badges_in_range--;
+            bitset_clear(radio_in_range, i);
+            badge_update_queerdar_count(radio_badges_in_range);
+            enclog_encounter(i, ids_in_range[i].first_heard,
+                             radio_intervals - RADIO_WINDOW_BEACON_COUNT,
+                             ids_in_range[i].boops);
         }
+#if RADIO_TPC
+        if (ids_in_range[i].intervals_left > RADIO_WINDOW_BEACON_COUNT - RADIO_TPC_WINDOW_INTERVALS) {
+            // Heard recently enough to count toward the crowd.
+            radio_badges_nearby++;
+        }
+#endif
     }
 
+    enclog_commit();
+
+#if RADIO_TPC
+    radio_tpc_update();
+#endif
+
     // Also, at each radio interval, we do need to do a beacon.
-    curr_packet_tx.proto_version = RADIO_PROTO_VER;
     curr_packet_tx.badge_id = badge_conf.badge_id;
     curr_packet_tx.msg_type = RADIO_MSG_TYPE_BEACON;
+#if RADIO_HOPPING
+    // Beacons carry the shared clock and which channels we're skipping,
+    //  or in the second half of the period, which we'll skip next.
+    if (radio_hop_half & 1) {
+        curr_packet_tx.msg_payload = RADIO_HOP_PAYLOAD_NEXT | radio_hop_proposal;
+    } else {
+        curr_packet_tx.msg_payload = radio_hop_mask_pending;
+    }
+    if (radio_hop_synced) {
+        curr_packet_tx.msg_payload |= RADIO_HOP_PAYLOAD_SYNCED;
+    }
+#else
     curr_packet_tx.msg_payload = 0;
-    crc16_append_buffer((uint8_t *)&curr_packet_tx, sizeof(radio_proto_t)-2);
+#endif
 
-    // Send our beacon.
-    rfm75_tx(RFM75_BROADCAST_ADDR, 1, (uint8_t *)&curr_packet_tx,
-             RFM75_PAYLOAD_SIZE);
+#if RADIO_TPC
+    power = radio_tx_power_beacon;
+#endif
+#if RADIO_HOPPING
+    radio_tx_curr(radio_beacon_channel(), power);
+#else
+    radio_tx_curr(radio_frequency, power);
+#endif
 }
 
 /// Initialize the radio module, including the low-level driver.
 void radio_init(uint16_t addr) {
     rfm75_init(addr, &radio_rx_done, &radio_tx_done);
     rfm75_post();
-    rfm75_write_reg(0x05, radio_frequency);
+#if RADIO_HOPPING
+    radio_hop_half = radio_hop_half_now();
+    radio_hop_build();
+#endif
+    radio_set_channel(radio_frequency);
 }
@@ -17,20 +17,107 @@
 
 #define RADIO_MSG_TYPE_BEACON 1
 #define RADIO_MSG_TYPE_BOOP 2
+/// Boop report: how many badges a boop reached, on its way back to the booper.
 #define RADIO_MSG_TYPE_ACK 3
 
-#define RADIO_PROTO_VER 1
+/// Protocol version we send.
+/**
+ ** Version 1 badges sent 8-byte packets; since version 2, packets carry the
+ ** sender's clock and are 10 bytes. The RFM75 runs with a static payload
+ ** width of RFM75_PAYLOAD_SIZE, so the two can't hear each other at all:
+ ** each radio drops the other's packets before we see them, and validate()
+ ** would reject them anyway. Badges must all be updated together.
+ */
+#define RADIO_PROTO_VER 3
+
+/// Number of seconds between our beacons, which is one hopping frame.
+#define RADIO_BEACON_INTERVAL_SECS 8
 
 // We beacon every 8 seconds, so our sliding window will be 112*8 seconds = about 15 minutes
 #define RADIO_WINDOW_BEACON_COUNT 112
 
 #define FREQ_MIN 14
 #define FREQ_NUM 6
+/// The channel the calibration picks on a module whose crystal is spot on.
+#define FREQ_NOMINAL (FREQ_MIN + FREQ_NUM/2)
+/// Highest channel inside the 2.4 GHz ISM band, at 2483 MHz.
+#define RADIO_CHANNEL_MAX 83
+
+/// Set to 1 to spread beacons over several channels, or 0 for a single channel.
+#define RADIO_HOPPING 1
+/// Number of channels in the hopping sequence. Must be 6 or fewer.
+#define RADIO_HOP_CHANNEL_COUNT 6
+/// Never skip so many congested channels that fewer than this are left.
+#define RADIO_HOP_MIN_CHANNELS 3
+/// Don't transmit within this many csecs of a slot boundary.
+#define RADIO_HOP_GUARD_CSECS 20
+/// Clocks within this many csecs of each other are considered in sync.
+#define RADIO_HOP_SYNC_TOLERANCE_CSECS 3
+/// Frames without hearing an in-sync packet before we fall back to home.
+#define RADIO_HOP_SYNC_TIMEOUT_FRAMES 16
+/// Seconds per congestion assessment period. Must divide 65536.
+#define RADIO_HOP_ASSESS_SECS 512
+/// Beacon msg_payload bits: the hopping sequence entries the sender skips (never home).
+#define RADIO_HOP_PAYLOAD_MASK 0x3e
+/// Beacon msg_payload flag: the skipped entries are for the next period, not this one.
+#define RADIO_HOP_PAYLOAD_NEXT BIT6
+/// Beacon msg_payload flag: the sender is following the shared hopping clock.
+#define RADIO_HOP_PAYLOAD_SYNCED BIT7
+
+/// Set to 1 to build a sniffer that never transmits, and streams what it hears
+///  out the serial port instead. See sniffer.c.
+#define RADIO_SNIFFER 0
+
+/// Set to 1 to turn transmit power down as the room gets more crowded.
+#define RADIO_TPC 1
+/// RF_SETUP with the RF_PWR bits clear: 1 Mbps, LNA gain high.
+#define RADIO_RF_SETUP_BASE 0b00000001
+/// Highest RF_PWR level. Levels 0..3 are -10, -5, 0, and 5 dBm.
+#define RADIO_TX_POWER_MAX 3
+/// Set to 1 to have boops report back how many badges they reached.
+#define RADIO_BOOP_REPORTS 1
+/// Number of boops we can be relaying and reporting on at once.
+#define RADIO_BOOP_TABLE_SIZE 4
+/// Csecs that each hop of a boop gets to report back to the hop before it.
+#define RADIO_BOOP_REPORT_CSECS_PER_HOP 30
+/// Reports go out up to this many csecs late, so siblings don't collide.
+#define RADIO_BOOP_REPORT_JITTER_CSECS 10
+/// Csecs to keep ignoring copies of a boop after we've reported on it.
+#define RADIO_BOOP_HOLD_CSECS 500
+/// Csecs to show how many badges our boop reached.
+#define RADIO_BOOP_REACH_SHOW_CSECS 300
+
+/// radio_next_deadline() when there's no boop to count down.
+#define RADIO_DEADLINE_NONE 0xffff
+
+/// Badges heard within this many beacon intervals count as nearby for power control.
+#define RADIO_TPC_WINDOW_INTERVALS 12
+/// Minimum number of beacon intervals between transmit power changes.
+#define RADIO_TPC_HOLD_INTERVALS 8
 
 typedef struct {
+    /// Radio intervals until it ages out of range; 0 while it's out of range.
     uint8_t intervals_left : 8;
+    /// New boops from it since it came into range, for the encounter log.
+    uint8_t boops;
+    /// radio_intervals when it came into range, for the encounter log.
+    uint16_t first_heard;
 } badge_info_t;
 
+/// A boop we're part of, either as its booper or as a relay.
+typedef struct {
+    /// ID of the badge that booped.
+    uint8_t origin;
+    /// The booper's sequence number for the boop.
+    uint8_t seq;
+    /// Badge we heard it from first, and will report back to.
+    uint8_t parent;
+    /// Badges reached through us, counting us.
+    uint8_t count;
+    /// Csecs until we report (or until we forget it, once reported); 0 if unused.
+    uint16_t csecs_left;
+} radio_boop_t;
+
 typedef struct {
     /// This badge's id
     uint16_t badge_id;
@@ -40,21 +127,49 @@ typedef struct {
     uint8_t msg_type;
     /// Optionally-used 1-byte message payload
     uint8_t msg_payload;
+    /// Sender's clock, centiseconds part
+    uint8_t clock_csecs;
+    /// Sender's clock, lower 16 bits of seconds
+    uint16_t clock_secs;
     uint16_t crc16;
 } radio_proto_t;
 
+// Boops and boop reports don't carry the sender's clock. Instead, where the
+//  clock would be, they carry which boop they're about and who's talking.
+/// The booper's sequence number for a boop or boop report.
+#define RADIO_BOOP_SEQ(msg) ((msg)->clock_csecs)
+/// The badge that sent this copy of a boop, or this boop report.
+#define RADIO_BOOP_FROM(msg) ((uint8_t) ((msg)->clock_secs & 0xff))
+/// The badge a boop report is for.
+#define RADIO_BOOP_TO(msg) ((uint8_t) ((msg)->clock_secs >> 8))
+
 extern radio_proto_t curr_packet_tx;
 extern badge_info_t ids_in_range[BADGES_IN_SYSTEM];
+extern uint16_t radio_in_range[BADGES_SET_WORDS];
 
 extern uint16_t rx_cnt[FREQ_NUM];
 extern uint8_t radio_frequency;
 extern uint8_t radio_frequency_done;
+#if RADIO_HOPPING
+extern uint8_t radio_hop_synced;
+extern uint8_t radio_hop_mask;
+#endif
+extern uint8_t radio_tx_power;
 
 rfm75_rx_callback_fn radio_rx_done;
 rfm75_tx_callback_fn radio_tx_done;
 void radio_start_calibration();
+void radio_set_channel(uint8_t channel);
+void radio_second();
+void radio_timestep();
+uint16_t radio_next_deadline();
+void radio_skip(uint16_t csecs);
+uint8_t radio_next_second();
+uint8_t radio_tx_slot_wait();
+uint8_t radio_tx_slot_open();
 void radio_init(uint16_t addr);
-void radio_boop(uint8_t badge_id, uint8_t seq);
+void radio_boop(uint8_t badge_id, uint8_t hops);
+void radio_boop_relay(radio_proto_t *msg);
 void radio_interval();
 void radio_event_beacon();
 
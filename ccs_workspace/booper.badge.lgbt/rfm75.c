@@ -14,6 +14,7 @@
 #include <driverlib.h>
 
 #include "badge.h"
+#include "event.h"
 #include "rfm75.h"
 
 // Handy generic pin twiddling:
@@ -32,9 +33,6 @@ uint8_t payload[RFM75_PAYLOAD_SIZE] = {0};  ///< Buffer to hold TX/RX payload.
 /// The RFM75 state tracks its progress through a sort of state machine.
 uint8_t rfm75_state = RFM75_BOOT;
 
-/// When this is 1, the application needs to call rfm75_deferred_interrupt().
-volatile uint8_t f_rfm75_interrupt = 0;
-
 /// Function pointer to the callback for a message RX.
 rfm75_rx_callback_fn* rfm75_rx_done_cb;
 /// Function pointer to the callback for a successful TX or a failed ACK.
@@ -272,8 +270,8 @@ void rfm75_tx(uint16_t addr, uint8_t noack, uint8_t* data, uint8_t len) {
  * This function needs to be called every time that the RFM75 IRQ is asserted,
  * preferably as soon as possible. However, for performance reasons it's
  * important that this not be called from inside the interrupt service routine
- * itself. The ISR sets a flag called `f_rfm75_interrupt`, which signals to the
- * main program that this function needs to be called. While this deferred
+ * itself. The ISR posts EVENT_RADIO, which signals to the main program that
+ * this function needs to be called. While this deferred
  * interrupt is pending, the radio will have limited to no background
  * functionality (depending on whether we are in PTX or PRX mode).
  *
@@ -286,7 +284,6 @@ void rfm75_tx(uint16_t addr, uint8_t noack, uint8_t* data, uint8_t len) {
  *
  */
 void rfm75_deferred_interrupt() {
-    f_rfm75_interrupt = 0;
     // Get the interrupt vector from the RFM75 module:
     uint8_t iv = rfm75_get_status();
 
@@ -327,36 +324,44 @@ void rfm75_deferred_interrupt() {
         // We've received something.
         rfm75_state = RFM75_RX_READY;
 
-        // Read the FIFO. No need to flush it; it's deleted when read.
-        read_rfm75_cmd_buf(RD_RX_PLOAD, payload, RFM75_PAYLOAD_SIZE);
-
-        // Invoke the registered callback function.
-        // 0b1110 masks the pipe ID out of the IV.
-        rfm75_rx_done_cb(payload, RFM75_PAYLOAD_SIZE, (iv & 0b1110) >> 1);
-
-        // After rfm75_rx_done_cb returns (and ONLY after it returns), the
-        //  payload_in is stale and is allowed to be overwritten.
-
-        if (rfm75_state == RFM75_RX_READY) {
-            // The rfm75_rx_done_cb callback did NOT invoke a transmit:
-            // So now we can tell the radio module that we're done with it:
-            //  Clear the interrupt flag on the module...
-            rfm75_write_reg(STATUS, BIT6);
-            //  ... and assert CE, to listen more.
-            CE_ACTIVATE;
-            rfm75_state = RFM75_RX_LISTEN;
-        } else {
-            // rfm75_rx_done_cb has called rfm75_tx, so the following happened:
-            //  1. rfm75_state is changed.
-            //      That's fine, we don't care.
-            //  2. CE_DEACTIVATE, then CE_ACTIVATE were called.
-            //      That means we don't need to handle it.
-            //  3. The CONFIG register was written.
-            //      Ok, great, we're in the proper TX config.
-            //  4. All interrupts are cleared
-            //      Awesome. We're done here.
-            //  No cleanup is necessary.
+        // Clear the interrupt flag on the module before we empty the FIFO,
+        //  so that anything arriving after our last look raises a new IRQ.
+        rfm75_write_reg(STATUS, BIT6);
+
+        // The RX FIFO is three deep, and more may have piled up while we
+        //  were busy, so read until it's empty. 0b1110 masks the pipe ID out
+        //  of the IV, and pipe ID 0b111 means the FIFO is empty.
+        while ((iv & 0b1110) != 0b1110) {
+            // Read the FIFO. No need to flush it; it's deleted when read.
+            read_rfm75_cmd_buf(RD_RX_PLOAD, payload, RFM75_PAYLOAD_SIZE);
+
+            // Invoke the registered callback function.
+            rfm75_rx_done_cb(payload, RFM75_PAYLOAD_SIZE, (iv & 0b1110) >> 1);
+
+            // After rfm75_rx_done_cb returns (and ONLY after it returns), the
+            //  payload_in is stale and is allowed to be overwritten.
+
+            if (rfm75_state != RFM75_RX_READY) {
+                // rfm75_rx_done_cb has called rfm75_tx, so the following happened:
+                //  1. rfm75_state is changed.
+                //      That's fine, we don't care.
+                //  2. CE_DEACTIVATE, then CE_ACTIVATE were called.
+                //      That means we don't need to handle it.
+                //  3. The CONFIG register was written.
+                //      Ok, great, we're in the proper TX config.
+                //  4. All interrupts are cleared, and the RX FIFO flushed.
+                //      Awesome. We're done here.
+                //  No cleanup is necessary.
+                return;
+            }
+
+            iv = rfm75_get_status();
         }
+
+        // The rfm75_rx_done_cb callback did NOT invoke a transmit, so
+        //  assert CE, to listen more.
+        CE_ACTIVATE;
+        rfm75_state = RFM75_RX_LISTEN;
     }
 }
 
@@ -550,7 +555,7 @@ void rfm75_init(uint16_t unicast_address, rfm75_rx_callback_fn* rx_callback,
     rfm75_enter_prx();
 }
 
-///The RFM75's interrupt pin ISR, which sets `f_rfm75_interrupt` to 1.
+///The RFM75's interrupt pin ISR, which posts EVENT_RADIO.
 #pragma vector=RFMISR_VECTOR
 __interrupt
 void RFM_ISR(void)
@@ -558,7 +563,7 @@ void RFM_ISR(void)
     if (RFMxIV != RFMxIV_PxIFGx) {
         return;
     }
-    f_rfm75_interrupt = 1;
+    event_post(EVENT_RADIO);
     if (rfm75_state != RFM75_RX_LISTEN) {
         CE_DEACTIVATE; // stop sending, or whatever.
         // If we're listening, we don't need to do this.
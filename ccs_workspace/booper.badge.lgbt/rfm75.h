@@ -137,8 +137,8 @@ void rfm75_deferred_interrupt();
 uint8_t rfm75_tx_avail();
 void rfm75_tx(uint16_t addr, uint8_t noack, uint8_t* data, uint8_t len);
 void rfm75_write_reg(uint8_t reg, uint8_t data);
+uint8_t rfm75_read_reg(uint8_t cmd);
 
 extern uint32_t rfm75_seqnum;
-extern volatile uint8_t f_rfm75_interrupt;
 
 #endif /* RFM75_H_ */
@@ -0,0 +1,106 @@
+/// A fast random number generator, stirred with entropy from the hardware.
+/**
+ ** The generator is Marsaglia's xorshift on a pair of 16-bit words, which
+ ** has a period of 2^32 - 1 and takes only shifts and XORs of the CPU's
+ ** own word size; there's no multiply, unlike the C library's rand(). It's
+ ** not cryptographic, just good enough that every badge blinks and picks
+ ** faces in its own way.
+ **
+ ** Badges used to seed rand() from their ID and how many badges they'd
+ ** seen, so badges with similar state made similar choices. Now the state
+ ** is stirred, instead, with whatever noise the hardware has to offer:
+ **
+ **  - at boot, how many trips around a loop on MCLK (the DCO) each tick
+ **    of ACLK (REFO) takes, which wanders with both oscillators' jitter;
+ **  - the low bits of the touch button's raw counts, after every scan;
+ **  - when each radio packet arrives, to the ACLK count.
+ **
+ ** The badge's ID is stirred in too, so even two badges that somehow
+ ** harvest the same noise start out different.
+ **
+ ** \file rng.c
+ ** \author George Louthan
+ ** \date   2023
+ ** \copyright (c) 2023 George Louthan @duplico. MIT License.
+ */
+
+#include <stdint.h>
+
+#include <msp430fr2633.h>
+
+#include "event.h"
+#include "rng.h"
+
+/// The generator's state, which must never be all zero.
+uint16_t rng_x = 0x2545;
+uint16_t rng_y = 0xf491;
+
+/// Step the generator, and return its next 16 bits.
+uint16_t rng_next() {
+    uint16_t t = rng_x ^ (rng_x << 5);
+
+    rng_x = rng_y;
+    rng_y = (rng_y ^ (rng_y >> 1)) ^ (t ^ (t >> 3));
+    return rng_y;
+}
+
+/// Mix `sample`, which might have some entropy in it, into the state.
+/**
+ ** This is cheap enough to call on every packet and touch scan. A sample
+ ** with no entropy in it does no harm.
+ **
+ ** The noise in a sample is mostly in its low bits, and samples that
+ ** differ by a little (neighboring IDs, say) would otherwise leave states
+ ** that differ by a little in the same places for a while. So the sample
+ ** is multiplied by an odd constant first, which spreads each bit of it
+ ** up through the word; on the FR2633, that's the hardware multiplier.
+ */
+void rng_stir(uint16_t sample) {
+    rng_x ^= sample * RNG_STIR_MULTIPLIER;
+    if (!rng_x && !rng_y) {
+        // The one state xorshift can't leave.
+        rng_y = 1;
+    }
+    rng_next();
+}
+
+/// Stir in how long each of the next `samples` ACLK ticks takes on MCLK.
+/**
+ ** Each takes about 1/32768 s, so this is about 1 ms for RNG_CLOCK_SAMPLES.
+ ** The spin is bounded, so a stopped ACLK can't hang the boot.
+ */
+void rng_harvest_clocks(uint8_t samples) {
+    uint16_t start;
+    uint8_t spins;
+
+    while (samples--) {
+        start = event_now();
+        spins = 0;
+        while (event_now() == start && ++spins);
+        rng_stir(spins);
+    }
+}
+
+/// Return a random number from 0 to `n` - 1, without the bias of rand() % n.
+/**
+ ** Draws are masked down to the smallest power of 2 that covers `n`, and
+ ** ones that land past it are thrown back, which is on average fewer than
+ ** 2 draws, and needs no division.
+ */
+uint16_t rng_below(uint16_t n) {
+    uint16_t mask = n - 1;
+    uint16_t r;
+
+    if (n < 2) {
+        return 0;
+    }
+    mask |= mask >> 1;
+    mask |= mask >> 2;
+    mask |= mask >> 4;
+    mask |= mask >> 8;
+
+    do {
+        r = rng_next() & mask;
+    } while (r >= n);
+    return r;
+}
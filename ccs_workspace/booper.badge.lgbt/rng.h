@@ -0,0 +1,27 @@
+/// Header for the badge's random number generator.
+/**
+ ** \file rng.h
+ ** \author George Louthan
+ ** \date   2023
+ ** \copyright (c) 2023 George Louthan @duplico. MIT License.
+ */
+
+#ifndef RNG_H_
+#define RNG_H_
+
+#include <stdint.h>
+
+/// ACLK edges rng_harvest_clocks() times against MCLK at boot.
+#define RNG_CLOCK_SAMPLES 32
+/// Odd constant rng_stir() spreads samples with (2^16 over the golden ratio).
+#define RNG_STIR_MULTIPLIER 0x9e37
+
+extern uint16_t rng_x;
+extern uint16_t rng_y;
+
+void rng_stir(uint16_t sample);
+void rng_harvest_clocks(uint8_t samples);
+uint16_t rng_next();
+uint16_t rng_below(uint16_t n);
+
+#endif /* RNG_H_ */
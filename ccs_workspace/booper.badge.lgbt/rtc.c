@@ -1,14 +1,23 @@
 /// Real-time clock configuration and events module.
 /**
- ** This module operates a real-time clock, sourced from the 8-MHz MCLK.
- ** It works about medium well, precision-wise. But that's fine, because it
- ** only has to last a weekend! (unofficial #badgelife motto).
+ ** This module operates a real-time clock, sourced from the 32 kHz REFO by
+ ** way of ACLK, so that it keeps counting in LPM3. It works about medium
+ ** well, precision-wise. But that's fine, because it only has to last a
+ ** weekend! (unofficial #badgelife motto).
  **
- ** Basically, the RTC generates the main system tick, which is every 10 ms,
+ ** Basically, the RTC counts the main system tick, which is every 10 ms,
  ** or 100 times per second. That centisecond (csec) system tick is then
  ** used to create another, once per second tick. In this badge design, only
  ** uptime is tracked; there is no persistent RTC.
  **
+ ** The RTC doesn't interrupt every tick, though. Each period runs until
+ ** the next software timer is due (see timer.c), up to RTC_WAKE_MAX_CSECS,
+ ** and its interrupt counts in all of its ticks at once.
+ **
+ ** A tick is 20.48 RTC counts, so the ticks start on the first count at or
+ ** after each 10 ms, and the module keeps track of where in the RTC's own
+ ** second each period starts. Every period ends on a tick.
+ **
  ** \file rtc.c
  ** \author George Louthan
  ** \date   2023
@@ -19,61 +28,193 @@
 
 #include <msp430fr2633.h>
 
-#include "badge.h"
+#include "event.h"
+#include "rtc.h"
 
-/// The number of system ticks the button has been held down so far.
-volatile uint16_t rtc_button_csecs = 0;
 /// System ticks this, which wraps from 99 to 0.
 volatile uint8_t rtc_centiseconds = 0;
 /// Number of seconds so far.
 volatile uint32_t rtc_seconds = 0;
+/// System ticks since power-on, which rtc_advance() never moves.
+volatile uint32_t rtc_ticks = 0;
+/// Ticks in each RTC period from the next one on.
+uint16_t rtc_period_csecs = 1;
+/// RTC counts into its own second that this period started at.
+uint16_t rtc_start = 0;
+/// RTC counts in this period.
+uint16_t rtc_len = 0;
+/// RTC counts in the next period, which is what's in RTCMOD.
+uint16_t rtc_next_len = 0;
+/// Ticks of this period already counted into the clocks by rtc_catch_up().
+uint16_t rtc_counted_csecs = 0;
+
+/// Return the whole ticks in the first `counts` RTC counts of a second.
+uint16_t rtc_counts_csecs(uint16_t counts) {
+    return (uint32_t) counts * 100 / RTC_COUNTS_PER_SEC;
+}
+
+/// Return the RTC counts from `start` to the end of the `csecs`th tick after it.
+/**
+ ** `start` is in RTC counts from the top of a second, and can be partway
+ ** through a tick, which then counts as the first of the `csecs`.
+ */
+uint16_t rtc_period_counts(uint16_t start, uint16_t csecs) {
+    uint32_t end = rtc_counts_csecs(start) + csecs;
+
+    return (end * RTC_COUNTS_PER_SEC + 99) / 100 - start;
+}
 
 /// Initialize the on-board real-time clock to tick 100 times per second.
 /**
- ** This sources the RTC from SMCLK (8 MHz) divided by 1000 (8 kHz),
- ** setting the modulo to 80, so that the RTC will tick 100x
- ** per second.
+ ** This sources the RTC from ACLK, which is the 32768 Hz REFO, divided by
+ ** 16 (2048 Hz), so that the RTC will tick 100x per second, until the
+ ** main loop calls rtc_set_wake().
  */
 void rtc_init() {
-    RTCMOD = 80; // Count the clock to 80 before resetting.
+    rtc_period_csecs = 1;
+    rtc_start = 0;
+    rtc_len = rtc_period_counts(0, 1);
+    rtc_next_len = rtc_period_counts(rtc_len, 1);
+    rtc_counted_csecs = 0;
+    RTCMOD = rtc_len;
 
     // Read and then throw away RTCIV to clear the interrupt.
     volatile uint16_t vector_read;
     vector_read = RTCIV;
 
-    RTCCTL = RTCSS__SMCLK |     // SMCLK (8MHz) source
-             RTCPS__1000 |      // divided by 1000 to get 8kHz
-             RTCSR |            // Reset counter.
+    SYSCFG2 |= RTCCKSEL;        // Make the RTC's SMCLK source ACLK instead.
+    RTCCTL = RTCSS__SMCLK |     // ACLK (32kHz) source, per RTCCKSEL
+             RTCPS__16 |        // divided by 16 to get 2kHz
+             RTCSR |            // Reset counter, and load RTCMOD.
              RTCIE;             // Enable interrupt.
+    RTCMOD = rtc_next_len;      // Loaded at the first overflow.
+}
+
+/// Move every clock forward by `csecs` ticks that have gone by.
+/**
+ ** Call this from the ISR, or with the RTC interrupt off. Several seconds
+ ** can go by at once now, but they make just the one 1 Hz tick.
+ */
+void rtc_elapse(uint16_t csecs) {
+    rtc_ticks += csecs;
+    csecs += rtc_centiseconds;
+    if (csecs >= 100) {
+        rtc_seconds += csecs / 100;
+        csecs %= 100;
+        event_post(EVENT_SECOND);
+    }
+    rtc_centiseconds = csecs;
+}
+
+/// Bring the clocks up to date with the RTC's counter, partway through a period.
+/**
+ ** When something other than the RTC wakes the badge, the ticks it slept
+ ** for so far aren't in the clocks yet. This counts them in, without
+ ** touching the RTC, so the next wake stays where it was.
+ **
+ ** If the period is overflowing right now, this leaves it to the ISR,
+ ** which will be along as soon as its interrupt is back on.
+ */
+void rtc_catch_up() {
+    RTCCTL &= ~RTCIE; // Keep the ISR from ticking underneath us.
+    if (!(RTCCTL & RTCIFG)) {
+        uint16_t csecs = rtc_counts_csecs(rtc_start + RTCCNT) -
+                rtc_counts_csecs(rtc_start);
+
+        rtc_elapse(csecs - rtc_counted_csecs);
+        rtc_counted_csecs = csecs;
+    }
+    RTCCTL |= RTCIE;
+}
+
+/// Wake the badge `csecs` ticks from now, between 1 and RTC_WAKE_MAX_CSECS.
+/**
+ ** The main loop calls this before it sleeps, with the ticks until the
+ ** first timer is due (see timer_next()), instead of waking up at 100 Hz
+ ** whether or not it has anything to do. The periods after that are the
+ ** same length, until it's called again.
+ **
+ ** Restarting the RTC loses the part of a count that it was into, so it's
+ ** only restarted if the wake actually moves.
+ */
+void rtc_set_wake(uint16_t csecs) {
+    uint16_t start;
+
+    if (!csecs) {
+        csecs = 1;
+    } else if (csecs > RTC_WAKE_MAX_CSECS) {
+        csecs = RTC_WAKE_MAX_CSECS;
+    }
+
+    rtc_catch_up();
+    RTCCTL &= ~RTCIE;
+    if (RTCCTL & RTCIFG || csecs == rtc_counts_csecs(rtc_start + rtc_len) -
+            rtc_counts_csecs(rtc_start) - rtc_counted_csecs) {
+        // Either it's already due then, or it's overflowing right now, and
+        //  we'll be back here once the ISR has counted it in.
+        RTCCTL |= RTCIE;
+        return;
+    }
+
+    start = rtc_start + RTCCNT;
+    rtc_len = rtc_period_counts(start, csecs);
+    RTCMOD = rtc_len;
+    RTCCTL |= RTCSR; // Reset the counter, and load RTCMOD for this period.
+
+    rtc_start = start % RTC_COUNTS_PER_SEC;
+    rtc_counted_csecs = 0;
+    rtc_period_csecs = csecs;
+    rtc_next_len = rtc_period_counts(rtc_start + rtc_len, csecs);
+    RTCMOD = rtc_next_len; // Loaded at the next overflow.
+    RTCCTL |= RTCIE;
+}
+
+/// Return the system ticks since power-on, which rtc_advance() never moves.
+uint32_t rtc_get_ticks() {
+    uint32_t ticks;
+
+    RTCCTL &= ~RTCIE; // It's two words, so don't let the ISR split them.
+    ticks = rtc_ticks;
+    RTCCTL |= RTCIE;
+    return ticks;
+}
+
+/// Move the clock forward by `csecs` centiseconds, e.g. to follow a peer.
+/**
+ ** This is used by the radio module to align our clock with the shared
+ ** network clock carried in radio packets. The clock only ever moves
+ ** forward, so uptime stays monotonic; any 1 Hz ticks that are skipped
+ ** over are simply not generated. The system ticks that timers count in
+ ** don't move.
+ */
+void rtc_advance(uint32_t csecs) {
+    RTCCTL &= ~RTCIE; // Keep the ISR from ticking underneath us.
+    csecs += rtc_centiseconds;
+    rtc_seconds += csecs / 100;
+    rtc_centiseconds = csecs % 100;
+    RTCCTL |= RTCIE;
 }
 
 /// RTC overflow interrupt service routine.
 #pragma vector=RTC_VECTOR
 __interrupt void RTC_ISR(void) {
-    // Called when the RTC overflows (100 times per second)
+    // Called when the RTC overflows, at the end of each period.
     if (RTCIV == RTCIV_RTCIF) {
-        // Tick our 100 Hz time loop, first.
-        rtc_centiseconds++;
-        f_time_loop = 1;
-
-        // Handle long pressing of buttons.
-        if (button_state) {
-            rtc_button_csecs++;
-            if (rtc_button_csecs == BUTTON_LONG_PRESS_CSECS) {
-                f_button_press_long = 1;
-                button_state = 2;
-                rtc_button_csecs = 0;
-            }
-        }
-
-        // Tick our 1 Hz time loop if needed.
-        if (rtc_centiseconds == 100) {
-            rtc_seconds++;
-            f_second = 1;
-            rtc_centiseconds = 0;
-        }
-
-        // Exit LPM.
-        LPM0_EXIT;
+        uint16_t end = rtc_start + rtc_len;
+
+        rtc_elapse(rtc_counts_csecs(end) - rtc_counts_csecs(rtc_start) -
+                   rtc_counted_csecs);
+        rtc_start = end % RTC_COUNTS_PER_SEC;
+        rtc_len = rtc_next_len;
+        rtc_counted_csecs = 0;
+
+        // RTCMOD was loaded for this period at the overflow, so what we
+        //  write now is the length of the one after it.
+        rtc_next_len = rtc_period_counts(rtc_start + rtc_len, rtc_period_csecs);
+        RTCMOD = rtc_next_len;
+        event_post(EVENT_TICK);
+
+        // Exit LPM, whichever one we're in.
+        LPM3_EXIT;
     }
 }
@@ -9,10 +9,20 @@
 #ifndef RTC_H_
 #define RTC_H_
 
+#include <stdint.h>
+
+/// RTC counts per second: the 32768 Hz ACLK, divided by 16.
+#define RTC_COUNTS_PER_SEC 2048
+/// Longest the RTC will sleep; this is just to keep the WDT happy.
+#define RTC_WAKE_MAX_CSECS 800
+
 extern volatile uint32_t rtc_seconds;
 extern volatile uint8_t rtc_centiseconds;
-extern uint8_t rtc_button_csecs;
 
 void rtc_init();
+void rtc_advance(uint32_t csecs);
+void rtc_catch_up();
+void rtc_set_wake(uint16_t csecs);
+uint32_t rtc_get_ticks();
 
 #endif /* RTC_H_ */
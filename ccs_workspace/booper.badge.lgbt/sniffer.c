@@ -0,0 +1,173 @@
+/// Radio sniffer serial stream for 2023 booper.badge.lgbt.
+/**
+ ** In a RADIO_SNIFFER build, the badge never transmits. Instead, every
+ ** payload the radio receives is framed and streamed out of the otherwise
+ ** unused eUSCI_A0 TX line (P1.4) as a UART, for a laptop on the other end
+ ** to decode with programming/sniff_decode.py.
+ **
+ ** Records wait in a CapTIvate byte queue. Only the main loop touches the
+ ** queue: it pushes records as the radio hands them to us, and whenever the
+ ** UART goes idle it pulls the next chunk out into sniffer_tx_buf. The ISR
+ ** only walks that chunk, the same way the CapTIvate UART driver walks its
+ ** transmit buffer, so the queue never needs a lock. When the queue is too
+ ** full for a whole record we drop the record rather than the oldest bytes,
+ ** so the stream never contains a torn record.
+ **
+ ** Every record is little-endian, and laid out like so:
+ **
+ **     0xA5 | len | csecs (4) | channel | pipe | dropped | payload (len) | sum
+ **
+ ** `csecs` is our uptime in centiseconds, `dropped` is the number of records
+ ** (up to 255) lost to a full queue since the last one that made it, and
+ ** `sum` makes the 8-bit sum of every byte after the 0xA5 come out to zero.
+ **
+ ** \file sniffer.c
+ ** \author George Louthan
+ ** \date   2023
+ ** \copyright (c) 2023 George Louthan @duplico. MIT License.
+ */
+
+#include <stdint.h>
+
+#include <msp430fr2633.h>
+#include <driverlib.h>
+#include "captivate.h"
+
+#include "badge.h"
+#include "event.h"
+#include "radio.h"
+#include "rtc.h"
+#include "sniffer.h"
+
+#if RADIO_SNIFFER
+
+#if (CAPT_INTERFACE==__CAPT_UART_INTERFACE__)
+#error "The sniffer needs eUSCI_A0 to itself; set CAPT_INTERFACE to __CAPT_NO_INTERFACE__."
+#endif
+
+/// Number of records dropped since boot because the queue was full.
+uint16_t sniffer_dropped = 0;
+
+/// Storage for the record queue.
+uint8_t sniffer_queue_buf[SNIFFER_QUEUE_SIZE];
+/// Records waiting for the UART.
+tByteQueue sniffer_queue;
+/// Records dropped since the last one that made it into the queue.
+uint8_t sniffer_dropped_since = 0;
+
+/// The chunk currently being sent by the ISR.
+uint8_t sniffer_tx_buf[SNIFFER_TX_CHUNK];
+/// Number of bytes in sniffer_tx_buf, or 0 if the UART is idle.
+volatile uint8_t sniffer_tx_len = 0;
+/// Index of the next byte in sniffer_tx_buf to send.
+volatile uint8_t sniffer_tx_index = 0;
+
+/// Push a byte onto the record queue, adding it to a running checksum.
+void sniffer_push(uint8_t byte, uint8_t *sum) {
+    MAP_CAPT_pushOntoByteQueue(&sniffer_queue, byte);
+    *sum += byte;
+}
+
+/// Queue up a received payload to go out the UART.
+void sniffer_record(uint8_t channel, uint8_t pipe, uint8_t *data, uint8_t len) {
+    uint32_t secs;
+    uint32_t csecs;
+    uint8_t sum = 0;
+
+    // Keep one byte spare so the queue never reports an overrun.
+    if (SNIFFER_QUEUE_SIZE - 1 - MAP_CAPT_getByteQueueSize(&sniffer_queue)
+            < len + SNIFFER_RECORD_OVERHEAD) {
+        sniffer_dropped++;
+        if (sniffer_dropped_since < 0xff) {
+            sniffer_dropped_since++;
+        }
+        return;
+    }
+
+    // Don't let the RTC tick between reading the two halves of the clock.
+    do {
+        secs = rtc_seconds;
+        csecs = secs * 100 + rtc_centiseconds;
+    } while (secs != rtc_seconds);
+
+    MAP_CAPT_pushOntoByteQueue(&sniffer_queue, SNIFFER_SYNC);
+    sniffer_push(len, &sum);
+    for (uint8_t i=0; i<4; i++) {
+        sniffer_push((csecs >> (8*i)) & 0xff, &sum);
+    }
+    sniffer_push(channel, &sum);
+    sniffer_push(pipe, &sum);
+    sniffer_push(sniffer_dropped_since, &sum);
+    for (uint8_t i=0; i<len; i++) {
+        sniffer_push(data[i], &sum);
+    }
+    MAP_CAPT_pushOntoByteQueue(&sniffer_queue, -sum);
+    sniffer_dropped_since = 0;
+
+    sniffer_service();
+}
+
+/// If the UART is idle, hand it the next chunk of the queue.
+void sniffer_service() {
+    uint8_t len = 0;
+
+    if (sniffer_tx_len) {
+        return; // Still busy; the ISR will post EVENT_SNIFFER when it's done.
+    }
+
+    while (len < SNIFFER_TX_CHUNK &&
+            MAP_CAPT_pullFromByteQueue(&sniffer_queue, &sniffer_tx_buf[len]) == eByteQueue_Success) {
+        len++;
+    }
+
+    if (!len) {
+        return;
+    }
+
+    sniffer_tx_index = 0;
+    sniffer_tx_len = len;
+    // TXIFG is always set when the UART is idle, so this fires right away.
+    UCA0IE |= UCTXIE;
+}
+
+/// Set up the record queue and the eUSCI_A0 UART on P1.4.
+void sniffer_init() {
+    EUSCI_A_UART_initParam param = {0};
+
+    MAP_CAPT_initByteQueue(&sniffer_queue, sniffer_queue_buf, SNIFFER_QUEUE_SIZE);
+
+    param.selectClockSource = EUSCI_A_UART_CLOCKSOURCE_SMCLK;
+    param.clockPrescalar = SNIFFER_UART_BR;
+    param.firstModReg = SNIFFER_UART_BRF;
+    param.secondModReg = SNIFFER_UART_BRS;
+    param.parity = EUSCI_A_UART_NO_PARITY;
+    param.msborLsbFirst = EUSCI_A_UART_LSB_FIRST;
+    param.numberofStopBits = EUSCI_A_UART_ONE_STOP_BIT;
+    param.uartMode = EUSCI_A_UART_MODE;
+    param.overSampling = EUSCI_A_UART_OVERSAMPLING_BAUDRATE_GENERATION;
+
+    EUSCI_A_UART_init(EUSCI_A0_BASE, &param);
+    EUSCI_A_UART_enable(EUSCI_A0_BASE);
+
+    // P1.4 goes from unused GPIO to UCA0TXD.
+    P1SEL0 |= BIT4;
+}
+
+#pragma vector=USCI_A0_VECTOR
+__interrupt void SNIFFER_EUSCI_ISR(void)
+{
+    switch (__even_in_range(UCA0IV, USCI_UART_UCTXIFG)) {
+    case USCI_UART_UCTXIFG:
+        UCA0TXBUF = sniffer_tx_buf[sniffer_tx_index++];
+        if (sniffer_tx_index == sniffer_tx_len) {
+            // That was the last byte in the chunk; go get another.
+            UCA0IE &= ~UCTXIE;
+            sniffer_tx_len = 0;
+            event_post(EVENT_SNIFFER);
+            __bic_SR_register_on_exit(LPM0_bits);
+        }
+        break;
+    }
+}
+
+#endif
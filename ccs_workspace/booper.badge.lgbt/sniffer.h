@@ -0,0 +1,37 @@
+/// Header for the radio sniffer serial stream.
+/**
+ ** \file sniffer.h
+ ** \author George Louthan
+ ** \date   2023
+ ** \copyright (c) 2023 George Louthan @duplico. MIT License.
+ */
+
+#ifndef SNIFFER_H_
+#define SNIFFER_H_
+
+#include <stdint.h>
+
+/// First byte of every record in the stream.
+#define SNIFFER_SYNC 0xA5
+/// Bytes in a record besides the payload itself.
+#define SNIFFER_RECORD_OVERHEAD 10
+/// Bytes in the ring of records waiting to go out the UART.
+#define SNIFFER_QUEUE_SIZE 512
+/// Bytes handed to the UART ISR at a time.
+#define SNIFFER_TX_CHUNK 32
+
+// UART at 250 kbaud from the 8 MHz SMCLK: 16x oversampling, UCBR=2, no modulation.
+/// UCBRx for the sniffer UART.
+#define SNIFFER_UART_BR 2
+/// UCBRFx for the sniffer UART.
+#define SNIFFER_UART_BRF 0
+/// UCBRSx for the sniffer UART.
+#define SNIFFER_UART_BRS 0
+
+extern uint16_t sniffer_dropped;
+
+void sniffer_init();
+void sniffer_record(uint8_t channel, uint8_t pipe, uint8_t *data, uint8_t len);
+void sniffer_service();
+
+#endif /* SNIFFER_H_ */
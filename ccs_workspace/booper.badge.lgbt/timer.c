@@ -0,0 +1,122 @@
+/// Software timer service, which owns every deadline the badge sleeps on.
+/**
+ ** Every timer that's running is in one list, sorted by when it's due, so
+ ** the main loop can program the RTC to wake it for just the first one
+ ** (see rtc_set_wake()), rather than ticking at 100 Hz to count down.
+ ** Starting a timer walks the list to insert it, and running the ones that
+ ** are due only ever looks at the head; there are only ever a handful.
+ **
+ ** Deadlines are in system ticks, from rtc_get_ticks(), which rtc_advance()
+ ** never moves, so a radio clock sync doesn't cut a countdown short.
+ **
+ ** The modules that step along every tick while they're busy (the LEDs, and
+ ** the radio's boop reports) get a wake-only timer for their next deadline,
+ ** and timer_catch_up() to skip them over the ticks in between.
+ **
+ ** \file timer.c
+ ** \author George Louthan
+ ** \date   2023
+ ** \copyright (c) 2023 George Louthan @duplico. MIT License.
+ */
+
+#include <stdint.h>
+
+#include "rtc.h"
+#include "timer.h"
+
+/// The running timers, soonest first.
+sw_timer_t *timer_list = 0;
+
+/// Take `timer` out of the list, if it's running.
+void timer_stop(sw_timer_t *timer) {
+    sw_timer_t **link = &timer_list;
+
+    if (!timer->running) {
+        return;
+    }
+
+    while (*link != timer) {
+        link = &(*link)->next;
+    }
+    *link = timer->next;
+    timer->running = 0;
+}
+
+/// (Re)start `timer` to come due `csecs` ticks from now, or stop it if TIMER_NEVER.
+void timer_start(sw_timer_t *timer, uint16_t csecs) {
+    sw_timer_t **link = &timer_list;
+
+    timer_stop(timer);
+    if (csecs == TIMER_NEVER) {
+        return;
+    }
+
+    timer->due = rtc_get_ticks() + csecs;
+    // Timers due at the same tick fire in the order they were started.
+    while (*link && (int32_t) ((*link)->due - timer->due) <= 0) {
+        link = &(*link)->next;
+    }
+    timer->next = *link;
+    *link = timer;
+    timer->running = 1;
+}
+
+/// Return 1 if `timer` has been started and hasn't come due yet.
+uint8_t timer_running(sw_timer_t *timer) {
+    return timer->running;
+}
+
+/// Return the ticks until the next timer is due: 0 if one is overdue, TIMER_NEVER if none are running.
+uint16_t timer_next() {
+    int32_t ticks;
+
+    if (!timer_list) {
+        return TIMER_NEVER;
+    }
+
+    ticks = (int32_t) (timer_list->due - rtc_get_ticks());
+    if (ticks <= 0) {
+        return 0;
+    }
+    return ticks < TIMER_NEVER ? ticks : TIMER_NEVER - 1;
+}
+
+/// Fire every timer that's due, in order. Call this from the main loop.
+/**
+ ** A timer is stopped before it fires, so its callback can start it again.
+ */
+void timer_run() {
+    uint32_t now = rtc_get_ticks();
+
+    while (timer_list && (int32_t) (now - timer_list->due) >= 0) {
+        sw_timer_t *timer = timer_list;
+
+        timer_list = timer->next;
+        timer->running = 0;
+        if (timer->fire) {
+            timer->fire();
+        }
+    }
+}
+
+/// Step a module through `ticks` ticks, skipping the ones that change nothing.
+/**
+ ** This does exactly what calling `step` every tick would have, but only
+ ** calls it on the ticks that `deadline` says matter, and tells `skip`
+ ** about the rest.
+ */
+void timer_catch_up(uint16_t ticks, timer_deadline_fn *deadline,
+                    timer_skip_fn *skip, timer_step_fn *step) {
+    while (ticks) {
+        uint16_t due = deadline();
+
+        if (due > ticks) {
+            skip(ticks);
+            return;
+        }
+
+        skip(due - 1);
+        step();
+        ticks -= due;
+    }
+}
@@ -0,0 +1,50 @@
+/// Header for the software timer service.
+/**
+ ** \file timer.h
+ ** \author George Louthan
+ ** \date   2023
+ ** \copyright (c) 2023 George Louthan @duplico. MIT License.
+ */
+
+#ifndef TIMER_H_
+#define TIMER_H_
+
+#include <stdint.h>
+
+/// Timeout meaning "never": timer_start() stops the timer instead.
+/**
+ ** This is also what leds_next_deadline() and radio_next_deadline() return
+ ** when nothing is scheduled, so their deadlines can go straight in.
+ */
+#define TIMER_NEVER 0xffff
+
+/// Called from the main loop when a timer comes due.
+typedef void timer_fn();
+/// Steps a module through one tick; see timer_catch_up().
+typedef void timer_step_fn();
+/// Returns the ticks until a module's next step that does anything.
+typedef uint16_t timer_deadline_fn();
+/// Accounts for ticks skipped, which are fewer than the module's deadline.
+typedef void timer_skip_fn(uint16_t ticks);
+
+/// A software timer, counting in system ticks (csecs).
+typedef struct sw_timer {
+    /// Tick it's due on, while it's running.
+    uint32_t due;
+    /// Called when it comes due, or 0 if it's only there to wake the badge.
+    timer_fn *fire;
+    /// Next running timer, in order of when they're due.
+    struct sw_timer *next;
+    /// 1 while it's in the list of running timers.
+    uint8_t running;
+} sw_timer_t;
+
+void timer_start(sw_timer_t *timer, uint16_t csecs);
+void timer_stop(sw_timer_t *timer);
+uint8_t timer_running(sw_timer_t *timer);
+uint16_t timer_next();
+void timer_run();
+void timer_catch_up(uint16_t ticks, timer_deadline_fn *deadline,
+                    timer_skip_fn *skip, timer_step_fn *step);
+
+#endif /* TIMER_H_ */
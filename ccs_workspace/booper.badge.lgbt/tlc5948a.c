@@ -9,7 +9,32 @@
  ** the tlc_gs_data buffer, which holds 16 grayscale words; their mapping
  ** to physical LEDs is hardware-specific but follows the linear order of
  ** the output lines on the hardware. Once the grayscale data is placed in
- ** the buffer, call tlc_send_gs().
+ ** the buffer, call tlc_set_gs().
+ **
+ ** Neither tlc_set_gs() nor tlc_set_fun() waits for the hardware. The
+ ** driver keeps two grayscale frames of its own, as the big-endian byte
+ ** images that go out on the wire: the front one, which was sent last, and
+ ** the back one, which tlc_set_gs() builds from tlc_gs_data. If the SPI is
+ ** free, the back frame becomes the front and goes straight out as a
+ ** polled burst, which at full SMCLK takes about 33 us, far less than the
+ ** interrupts would for each byte. If function data is still going out,
+ ** the back frame waits, and the ISR swaps and bursts it when it's done;
+ ** a newer frame replaces one that's still waiting, rather than waiting
+ ** behind it. Either way, tlc_gs_data is free to change again as soon as
+ ** tlc_set_gs() returns. Function data waits its turn the same way, ahead
+ ** of grayscale, and goes out a byte per interrupt, because it has to
+ ** switch the SPI to 7-bit mode partway through.
+ **
+ ** When every channel is zero, the driver blanks the display and, once
+ ** that's been sent, stops GSCLK by handing its pin back to GPIO (driven
+ ** low), so the grayscale counter isn't clocked 8 million times a second
+ ** for nothing. The first frame with anything in it starts GSCLK again and
+ ** unblanks the display, ahead of the frame itself.
+ **
+ ** That only gates the pin. SMCLK, and the DCO under it, keep running
+ ** while the badge is awake, dark or not, because both SPI ports are
+ ** clocked from SMCLK; they stop only while it's asleep in LPM3, which
+ ** main_sleep_bits() allows once tlc_dark is set.
  **
  ** Helper functions are provided for manipulating the main parts of the
  ** function buffer, which controls device settings like display blanking,
@@ -37,9 +62,20 @@
 #define TLC_THISISFUN   0x01
 
 /// Current sending state of the SPI state machine.
-uint8_t tlc_send_type = TLC_SEND_IDLE;
+volatile uint8_t tlc_send_type = TLC_SEND_IDLE;
 /// Index of the currently sending byte in the buffer.
 uint8_t tlc_tx_index = 0;
+/// Whether there's a grayscale frame in the back buffer waiting to be sent.
+volatile uint8_t tlc_gs_queued = 0;
+/// Whether the function data is waiting to be sent.
+volatile uint8_t tlc_fun_queued = 0;
+/// Whether the display is all dark, so we've blanked it and stopped GSCLK.
+volatile uint8_t tlc_dark = 0;
+
+/// LEDs that read as open in the last tlc_test_leds(), a bit per tlc_gs_data index.
+uint16_t tlc_leds_open = 0;
+/// LEDs that read as shorted in the last tlc_test_leds(), likewise.
+uint16_t tlc_leds_shorted = 0;
 
 /// If we are performing a loopback serial test, the data to send.
 uint8_t tlc_loopback_data_out = 0x00;
@@ -48,6 +84,23 @@ volatile uint8_t tlc_loopback_data_in = 0x00;
 
 /// Main buffer to hold grayscale data.
 uint16_t tlc_gs_data[16] = { 0x0000, };
+/// The driver's own two grayscale frames, as they go out on the wire.
+uint8_t tlc_gs_images[2][TLC_GS_IMAGE_LEN] = {{ 0x00, }};
+/// The grayscale frame that's being sent, or was sent last.
+uint8_t *tlc_gs_front = tlc_gs_images[0];
+/// The grayscale frame that's waiting to be sent, if tlc_gs_queued.
+uint8_t *tlc_gs_back = tlc_gs_images[1];
+
+#pragma NOINIT(tlc_dc_cal)
+#pragma LOCATION(tlc_dc_cal, 0x19F0)
+/// Each LED's dot correction, in tlc_gs_data order, as set at the factory.
+/**
+ ** This sits at the end of INFOA, outside the firmware image, so that
+ ** reflashing the code leaves it alone; program_badge.py writes it along
+ ** with the rest of INFOA. A channel that reads 0, or has the high bit set
+ ** like erased FRAM, was never calibrated and gets TLC_DC.
+ */
+uint8_t tlc_dc_cal[16];
 
 /// The basic set of function data, some of which can be edited.
 uint8_t fun_base[] = {
@@ -83,44 +136,134 @@ uint8_t fun_base[] = {
         TLC_DC, TLC_DC, TLC_DC, TLC_DC
 };
 
-/// Send our current grayscale buffer to the hardware.
+/// Swap in the back grayscale frame, and make it the front.
+void tlc_gs_swap() {
+    uint8_t *sent = tlc_gs_front;
+    tlc_gs_front = tlc_gs_back;
+    tlc_gs_back = sent;
+    tlc_gs_queued = 0;
+}
+
+/// Shift out the front grayscale frame as fast as the SPI will go, and latch it.
+void tlc_gs_burst() {
+    for (uint8_t i=0; i<TLC_GS_IMAGE_LEN; i++) {
+        while (!(TLC_USCI_IFG & UCTXIFG));
+        TLC_USCI_TXBUF = tlc_gs_front[i];
+    }
+    // The last byte has only just started out; LAT has to wait for it.
+    while (TLC_USCI_STATW & UCBUSY);
+    LAT_POUT |= LAT_PBIT; LAT_POUT &= ~LAT_PBIT; // Pulse LAT
+}
+
+/// Start sending whatever's waiting, or go idle. Call with interrupts off.
+void tlc_send_next() {
+    if (tlc_fun_queued) {
+        tlc_fun_queued = 0;
+        tlc_send_type = TLC_SEND_TYPE_FUN;
+        tlc_tx_index = 0;
+        TLC_USCI_TXBUF = TLC_THISISFUN;
+        TLC_USCI_IE |= UCTXIE; // The ISR takes it from here.
+        return;
+    }
+
+    if (tlc_gs_queued) {
+        // Only reachable from the ISR, after function data.
+        tlc_gs_swap();
+        tlc_send_type = TLC_SEND_TYPE_GS;
+        tlc_gs_burst();
+    }
+    TLC_USCI_IE &= ~UCTXIE;
+    tlc_send_type = TLC_SEND_IDLE;
+
+    if (tlc_dark) {
+        // The blank is out, so nothing's counting GSCLK any more.
+        GSCLK_PSEL1 &= ~GSCLK_PBIT;
+    }
+}
+
+/// Send our current grayscale buffer to the hardware, without waiting.
 void tlc_set_gs() {
-    while (tlc_send_type != TLC_SEND_IDLE);
-    tlc_send_type = TLC_SEND_TYPE_GS;
-    tlc_tx_index = 0;
-    EUSCI_A_SPI_transmitData(TLC_EUSCI_BASE, TLC_THISISGS);
+    uint16_t sr = __get_SR_register();
+    uint16_t lit = 0;
+    uint8_t send_now;
+
+    // The ISR won't touch the back frame unless one's queued, so unqueue
+    //  any older frame (we're replacing it anyway) and then fill it in.
+    __bic_SR_register(GIE);
+    tlc_gs_queued = 0;
+    __bis_SR_register(sr & GIE);
+
+    tlc_gs_back[0] = TLC_THISISGS;
+    for (uint8_t i=0; i<16; i++) {
+        tlc_gs_back[1 + 2*i] = tlc_gs_data[i] >> 8;
+        tlc_gs_back[2 + 2*i] = tlc_gs_data[i] & 0xff;
+        lit |= tlc_gs_data[i];
+    }
+
+    if ((lit == 0) != tlc_dark) {
+        if (lit) {
+            // GSCLK has to be running before we unblank.
+            GSCLK_PSEL1 |= GSCLK_PBIT;
+        }
+        tlc_dark = !lit;
+        tlc_stage_blank(tlc_dark);
+        tlc_set_fun(); // This goes out ahead of the frame.
+    }
+
+    __bic_SR_register(GIE);
+    tlc_gs_queued = 1;
+    send_now = tlc_send_type == TLC_SEND_IDLE;
+    if (send_now) {
+        tlc_gs_swap();
+        tlc_send_type = TLC_SEND_TYPE_GS;
+    }
+    __bis_SR_register(sr & GIE);
+
+    if (send_now) {
+        // The SPI is ours; burst it out with interrupts on.
+        tlc_gs_burst();
+        __bic_SR_register(GIE);
+        tlc_send_next();
+        __bis_SR_register(sr & GIE);
+    }
 }
 
-/// Send our current function data buffer to the hardware.
+/// Send our current function data buffer to the hardware, without waiting.
 void tlc_set_fun() {
-    while (tlc_send_type != TLC_SEND_IDLE);
-    tlc_send_type = TLC_SEND_TYPE_FUN;
-    tlc_tx_index = 0;
-    EUSCI_A_SPI_transmitData(TLC_EUSCI_BASE, TLC_THISISFUN);
+    uint16_t sr = __get_SR_register();
+
+    __bic_SR_register(GIE);
+    tlc_fun_queued = 1;
+    if (tlc_send_type == TLC_SEND_IDLE) {
+        tlc_send_next();
+    }
+    __bis_SR_register(sr & GIE);
 }
 
-/// Stage global brightness into dot correct if different from default.
+/// Stage each LED's dot correct, scaled by `scale`/TLC_DC_SCALE_FULL.
 /**
  ** This is designed to give us a greater range of hardware brightness
- ** settings. The reason we would want this is that the global
- ** brightness setting and the dot-correct settings actually adjust the
- ** constant current of the LEDs. This lets our PWM grayscale action
- ** look consistent across brightness correction levels. We still
- ** retain the ability to do per-color dot correction with the
- ** preprocessor defines that start with TLC_DC.
- **
- ** Note that with the current configuration for booper.badge.lgbt for
- ** 2023, TLC_DC is the max dot-correct level of 0x7f, so the only
- ** truly valid values of `mult` are 0 and 1, here..
+ ** settings. The global brightness setting and the dot-correct settings
+ ** actually adjust the constant current of the LEDs, so dimming with
+ ** them lets our PWM grayscale action look consistent across brightness
+ ** levels. The per-LED calibration in tlc_dc_cal comes along, scaled.
  */
-void tlc_stage_dc_mult(uint8_t mult) {
-    for (uint8_t i=0; i<15; i+=3) {
-        fun_base[19+i + 0] = TLC_DC * mult;
-        fun_base[19+i + 1] = TLC_DC * mult;
-        fun_base[19+i + 2] = TLC_DC * mult;
+void tlc_stage_dc(uint8_t scale) {
+    for (uint8_t i=0; i<16; i++) {
+        uint8_t dc = tlc_dc_cal[i];
+
+        if (!dc || (dc & BIT7)) {
+            dc = TLC_DC;
+        }
+        fun_base[18+i] = ((uint16_t) dc * scale) / TLC_DC_SCALE_FULL;
     }
 }
 
+/// Return the dot correct staged for channel `i`, in tlc_gs_data order.
+uint8_t tlc_get_dc(uint8_t i) {
+    return fun_base[18+i];
+}
+
 /// Set or unset the blank bit in the function data, but don't send it yet.
 void tlc_stage_blank(uint8_t blank) {
     if (blank) {
@@ -145,6 +288,7 @@ uint8_t tlc_test_loopback(uint8_t test_pattern) {
     tlc_send_type = TLC_SEND_TYPE_LB;
     tlc_tx_index = 0;
     EUSCI_A_SPI_transmitData(TLC_EUSCI_BASE, test_pattern);
+    EUSCI_A_SPI_enableInterrupt(TLC_EUSCI_BASE, EUSCI_A_SPI_TRANSMIT_INTERRUPT);
     // Spin while we send and receive:
     while (tlc_send_type != TLC_SEND_IDLE);
 
@@ -153,6 +297,81 @@ uint8_t tlc_test_loopback(uint8_t test_pattern) {
     return tlc_loopback_data_in != (uint8_t) ((test_pattern << 7) | (test_pattern >> 1));
 }
 
+/// Shift out the front grayscale frame again, keeping what comes back, and latch it.
+void tlc_gs_exchange(uint8_t *rx) {
+    rx[0] = TLC_USCI_RXBUF; // Clear out whatever the last burst left.
+    for (uint8_t i=0; i<TLC_GS_IMAGE_LEN; i++) {
+        TLC_USCI_TXBUF = tlc_gs_front[i];
+        while (!(TLC_USCI_IFG & UCRXIFG));
+        rx[i] = TLC_USCI_RXBUF;
+    }
+    LAT_POUT |= LAT_PBIT; LAT_POUT &= ~LAT_PBIT; // Pulse LAT
+}
+
+/// Return bits 8*`m`+7 to 8*`m` of the status data a frame shifted back in `rx`.
+/**
+ ** The common shift register is 257 bits long, and a frame clocks 264
+ ** through it, so the register's MSB (bit 256) comes back first, and every
+ ** byte of it straddles two of ours.
+ */
+uint8_t tlc_sid_byte(uint8_t *rx, uint8_t m) {
+    return (rx[31-m] << 1) | (rx[32-m] >> 7);
+}
+
+/// Light each LED alone, and read back the TLC's open and short detection.
+/**
+ ** With TMGRST set, as it is whenever the display isn't blanked, each
+ ** grayscale latch restarts the PWM, and the TLC checks its outputs at the
+ ** GSCLK LATTMG picks. The next latch, of the same frame, copies that
+ ** status into the shift register, and the one after shifts it back out to
+ ** us. Only the lit LED's bits mean anything, because an output that's off
+ ** looks shorted. The whole thing takes a few milliseconds, and then the
+ ** frame that was showing goes back up.
+ **
+ ** The results, also in tlc_leds_open and tlc_leds_shorted, have a bit
+ ** for each index of tlc_gs_data, which leds.c lays out as eye*8 + segment.
+ **
+ ** \return A bit for each LED that failed, or 0 if they all passed.
+ */
+uint16_t tlc_test_leds() {
+    uint16_t shown[16];
+    uint8_t rx[TLC_GS_IMAGE_LEN];
+
+    memcpy(shown, tlc_gs_data, sizeof(shown));
+    tlc_leds_open = 0;
+    tlc_leds_shorted = 0;
+
+    for (uint8_t i=0; i<16; i++) {
+        // Channel 0 goes out first, so it's OUT15.
+        uint8_t out = 15 - i;
+        uint16_t lod;
+        uint16_t lsd;
+
+        memset(tlc_gs_data, 0, sizeof(tlc_gs_data));
+        tlc_gs_data[i] = 0xffff;
+        tlc_set_gs(); // Unblanks, if need be, ahead of the frame.
+        while (tlc_send_type != TLC_SEND_IDLE);
+        __delay_cycles(TLC_TEST_SETTLE_CYCLES);
+
+        tlc_gs_exchange(rx); // Load the status,
+        tlc_gs_exchange(rx); //  and read it back.
+
+        lod = (tlc_sid_byte(rx, 30) << 8) | tlc_sid_byte(rx, 28);
+        lsd = (tlc_sid_byte(rx, 26) << 8) | tlc_sid_byte(rx, 24);
+        if (lod & (1 << out)) {
+            tlc_leds_open |= 1 << i;
+        }
+        if (lsd & (1 << out)) {
+            tlc_leds_shorted |= 1 << i;
+        }
+    }
+
+    memcpy(tlc_gs_data, shown, sizeof(shown));
+    tlc_set_gs();
+
+    return tlc_leds_open | tlc_leds_shorted;
+}
+
 /// Stage global brightness setting.
 void tlc_stage_bc(uint8_t bc) {
     bc = bc & 0b01111111; // Mask out BLANK just in case.
@@ -174,7 +393,7 @@ void tlc_init() {
     ini.clockPhase = EUSCI_A_SPI_PHASE_DATA_CAPTURED_ONFIRST_CHANGED_ON_NEXT;
     ini.clockPolarity = EUSCI_A_SPI_CLOCKPOLARITY_INACTIVITY_LOW;
     ini.clockSourceFrequency = SMCLK_RATE_HZ;
-    ini.desiredSpiClock = 1000000;
+    ini.desiredSpiClock = TLC_SPI_CLOCK_HZ;
     ini.msbFirst = EUSCI_A_SPI_MSB_FIRST;
     ini.selectClockSource = EUSCI_A_SPI_CLOCKSOURCE_SMCLK;
     ini.spiMode = EUSCI_A_SPI_3PIN;
@@ -183,12 +402,12 @@ void tlc_init() {
     TLC_USCI_CTLW0 &= ~UC7BIT;  //  put it in 8-bit mode out of caution.
     TLC_USCI_CTLW0 &= ~UCSWRST; //  and enable it.
 
-    EUSCI_A_SPI_clearInterrupt(TLC_EUSCI_BASE, EUSCI_A_SPI_TRANSMIT_INTERRUPT);
-    EUSCI_A_SPI_enableInterrupt(TLC_EUSCI_BASE, EUSCI_A_SPI_TRANSMIT_INTERRUPT);
+    // The transmit interrupt is only enabled while function data (or a
+    //  loopback test) is going out; grayscale frames are sent by polling.
 
     // Stage an un-blank configuration to the function data:
     tlc_stage_blank(0);
-    tlc_stage_dc_mult(1);
+    tlc_stage_dc(TLC_DC_SCALE_FULL);
 
     // And our initial grayscale data:
     tlc_set_gs();
@@ -214,44 +433,29 @@ __interrupt void TLC_EUSCI_ISR(void)
         break; // End of RXIFG ///////////////////////////////////////////////////////
 
     case 4: // Vector 4 - TXIFG : I just sent a byte.
-        if (tlc_send_type == TLC_SEND_TYPE_GS) {
-            if (tlc_tx_index == 32) { // done
-                LAT_POUT |= LAT_PBIT; LAT_POUT &= ~LAT_PBIT; // Pulse LAT
-                tlc_send_type = TLC_SEND_IDLE;
-                break;
-            } else { // gs - MSB first; this starts with 0.
-                volatile static uint16_t channel_gs = 0;
-                channel_gs = tlc_gs_data[tlc_tx_index/2];
-                __no_operation();
-                if (tlc_tx_index & 0x01) { // odd; less significant byte
-                    TLC_USCI_TXBUF = (channel_gs & 0xff);
-                } else { // even; more significant byte
-                    TLC_USCI_TXBUF = (channel_gs >> 8) & 0xff;
-                }
-            }
-            tlc_tx_index++;
-        } else if (tlc_send_type == TLC_SEND_TYPE_FUN) {
+        if (tlc_send_type == TLC_SEND_TYPE_FUN) {
             if (tlc_tx_index == 18) { // after 18 we have to switch to 7-bit mode.
+                // Let the last 8-bit byte finish before resetting the eUSCI.
+                while (TLC_USCI_STATW & UCBUSY);
                 TLC_USCI_CTLW0 |= UCSWRST;
                 TLC_USCI_CTLW0 |= UC7BIT;
                 TLC_USCI_CTLW0 &= ~UCSWRST;
                 EUSCI_A_SPI_clearInterrupt(TLC_EUSCI_BASE, EUSCI_A_SPI_TRANSMIT_INTERRUPT);
                 EUSCI_A_SPI_enableInterrupt(TLC_EUSCI_BASE, EUSCI_A_SPI_TRANSMIT_INTERRUPT);
             } else if (tlc_tx_index == 34) {
+                while (TLC_USCI_STATW & UCBUSY);
                 LAT_POUT |= LAT_PBIT; LAT_POUT &= ~LAT_PBIT; // Pulse LAT
                 TLC_USCI_CTLW0 |= UCSWRST;
                 TLC_USCI_CTLW0 &= ~UC7BIT;
                 TLC_USCI_CTLW0 &= ~UCSWRST;
-                EUSCI_A_SPI_clearInterrupt(TLC_EUSCI_BASE, EUSCI_A_SPI_TRANSMIT_INTERRUPT);
-                EUSCI_A_SPI_enableInterrupt(TLC_EUSCI_BASE, EUSCI_A_SPI_TRANSMIT_INTERRUPT);
-                tlc_send_type = TLC_SEND_IDLE;
+                tlc_send_next();
                 break;
             }
             EUSCI_A_SPI_transmitData(TLC_EUSCI_BASE, fun_base[tlc_tx_index]);
             tlc_tx_index++;
         } else if (tlc_send_type == TLC_SEND_TYPE_LB) { // Loopback for POST
             if (tlc_tx_index == 33) {
-                tlc_send_type = TLC_SEND_IDLE;
+                tlc_send_next();
                 break;
             }
             EUSCI_A_SPI_transmitData(TLC_EUSCI_BASE, tlc_loopback_data_out);
@@ -22,8 +22,18 @@
 /// Default global brightness correct for LEDs.
 //#define TLC_BC 0x00 // 25%
 #define TLC_BC 0x7f // 100%
-/// Default dot-correct for all LEDs
+/// Default dot-correct for any LED without a factory value in tlc_dc_cal.
 #define TLC_DC 0x7f
+/// Dot-correct scale for tlc_stage_dc() that leaves tlc_dc_cal as it is.
+#define TLC_DC_SCALE_FULL 128
+/// SPI clock for the LED controller, which will take up to 33 MHz.
+#define TLC_SPI_CLOCK_HZ SMCLK_RATE_HZ
+/// MCLK cycles for the LED test to wait, after lighting an LED, for the TLC to check it.
+/**
+ ** LATTMG has the TLC check its outputs 129 GSCLKs after the latch, which
+ ** is 32 us even with SMCLK halved; this is 100 us.
+ */
+#define TLC_TEST_SETTLE_CYCLES 800
 
 // GPIO
 
@@ -37,6 +47,11 @@
 /// The built-in pin bit in register LAT_POUT for the LATCH line.
 #define LAT_PBIT    BIT1
 
+/// The built-in register PxSEL1 for the GSCLK line, which carries SMCLK.
+#define GSCLK_PSEL1 P1SEL1
+/// The built-in pin bit in register GSCLK_PSEL1 for the GSCLK line.
+#define GSCLK_PBIT  BIT7
+
 // Peripherals
 
 /// The DriverLib EUSCI_BASE for the TLC port
@@ -51,6 +66,12 @@
 #define TLC_USCI_TXBUF UCA1TXBUF
 /// RX register for the TLC eUSCI
 #define TLC_USCI_RXBUF UCA1RXBUF
+/// Interrupt flag register for the TLC eUSCI
+#define TLC_USCI_IFG UCA1IFG
+/// Interrupt enable register for the TLC eUSCI
+#define TLC_USCI_IE UCA1IE
+/// Status register for the TLC eUSCI
+#define TLC_USCI_STATW UCA1STATW
 
 /**************************
  * CONFIGURATION ENDS HERE
@@ -65,14 +86,23 @@
 /// Loopback testing state of the low-level SPI state machine.
 #define TLC_SEND_TYPE_LB  3
 
-extern uint8_t tlc_send_type;
+/// Bytes in a grayscale frame on the wire: the GS flag, then 16 words.
+#define TLC_GS_IMAGE_LEN 33
+
+extern volatile uint8_t tlc_send_type;
+extern volatile uint8_t tlc_dark;
 extern uint16_t tlc_gs_data[16];
+extern uint8_t tlc_dc_cal[16];
+extern uint16_t tlc_leds_open;
+extern uint16_t tlc_leds_shorted;
 
 void tlc_init();
 uint8_t tlc_test_loopback(uint8_t);
+uint16_t tlc_test_leds();
 void tlc_set_gs();
 void tlc_set_fun();
-//void tlc_stage_dc_mult(uint8_t mult);
+void tlc_stage_dc(uint8_t scale);
+uint8_t tlc_get_dc(uint8_t i);
 void tlc_stage_bc(uint8_t bc);
 void tlc_stage_blank(uint8_t);
 
@@ -0,0 +1,362 @@
+/// Check the badge's bitsets against the byte-wise ID buffers, and time both, on Linux.
+/**
+ ** usage: bitbench [rounds]
+ **
+ ** Runs bitset.c, built unmodified, next to copies of the byte-wise
+ ** functions util.c used to have for the same job (check_id_buf(),
+ ** set_id_buf(), unset_id_buf(), buffer_rank() and byte_rank()).
+ **
+ ** First it checks, on `rounds` random sets (default 10000) of
+ ** BADGES_IN_SYSTEM IDs at every density, that the two always agree: on
+ ** what's set, after the same sets and clears, on the count, on going
+ ** through the set bits from anywhere, and on unions, intersections and
+ ** differences, both into a third set and in place. It also checks the
+ ** word count against byte_rank() for every 16-bit word. Any disagreement
+ ** is printed, and the exit status is 1.
+ **
+ ** Then it times, on this host, each old way and new way of: testing
+ ** every ID; counting a set; counting the badges two sets have in common
+ ** ("badges we've both seen"); and what radio_interval() does, finding
+ ** the badges in range, with a few and with many of them in range. Host
+ ** times are only a guide to the MSP430, which has no barrel shifter and
+ ** no divider, and where a word operation costs the same as a byte one.
+ **
+ ** \file bitbench.c
+ ** \author George Louthan
+ ** \date   2023
+ ** \copyright (c) 2023 George Louthan @duplico. MIT License.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <msp430.h>
+
+#include "badge.h"
+#include "radio.h"
+#include "bitset.h"
+
+/// Bytes in the old byte-wise buffers, which is also the bitsets' size.
+#define BITBENCH_BYTES (BADGES_SET_WORDS * 2)
+/// Times each timed operation is repeated, to get above the clock's resolution.
+#define BITBENCH_REPS 20000
+
+/// A set as both the old buffers and a bitset saw it; the layouts match.
+typedef union {
+    uint8_t bytes[BITBENCH_BYTES];
+    uint16_t words[BADGES_SET_WORDS];
+} bitbench_set_t;
+
+// The old byte-wise functions, as they were in util.c. They're kept out of
+//  line like bitset.c's are, so neither gets inlined into the loops below.
+
+__attribute__((noinline)) uint8_t check_id_buf(uint16_t id, uint8_t *buf) {
+    uint8_t byte;
+    uint8_t bit;
+    byte = id / 8;
+    bit = id % 8;
+    return (buf[byte] & (BIT0 << bit)) ? 1 : 0;
+}
+
+__attribute__((noinline)) void set_id_buf(uint16_t id, uint8_t *buf) {
+    uint8_t byte;
+    uint8_t bit;
+    byte = id / 8;
+    bit = id % 8;
+    buf[byte] |= (BIT0 << bit);
+}
+
+__attribute__((noinline)) void unset_id_buf(uint16_t id, uint8_t *buf) {
+    uint8_t byte;
+    uint8_t bit;
+    byte = id / 8;
+    bit = id % 8;
+    buf[byte] &= ~(BIT0 << bit);
+}
+
+__attribute__((noinline)) uint8_t byte_rank(uint8_t v) {
+    uint8_t c;
+    for (c = 0; v; c++) {
+        v &= v - 1; // clear the least significant bit set
+    }
+    return c;
+}
+
+__attribute__((noinline)) uint16_t buffer_rank(uint8_t *buf, uint8_t len) {
+    uint16_t count = 0;
+    uint8_t c, v;
+    for (uint8_t i=0; i<len; i++) {
+        v = buf[i];
+        for (c = 0; v; c++) {
+            v &= v - 1; // clear the least significant bit set
+        }
+        count += c;
+    }
+    return count;
+}
+
+/// Disagreements found so far.
+uint32_t bitbench_failures = 0;
+
+/// Nanoseconds on the host's monotonic clock.
+uint64_t bitbench_nsecs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/// Report a disagreement, unless there have already been plenty.
+void bitbench_fail(const char *what, uint32_t round, uint16_t id) {
+    if (bitbench_failures++ < 10) {
+        fprintf(stderr, "Round %u: %s disagrees, at ID %u.\n", round, what, id);
+    }
+}
+
+/// Fill `set` with IDs under BADGES_IN_SYSTEM, each set with chance `density` in 256.
+void bitbench_random(bitbench_set_t *set, uint16_t density) {
+    memset(set, 0, sizeof(*set));
+    for (uint16_t id=0; id<BADGES_IN_SYSTEM; id++) {
+        if (rand() % 256 < density) {
+            set->bytes[id / 8] |= 1 << (id % 8);
+        }
+    }
+}
+
+/// Check every property on one pair of random sets.
+void bitbench_check_round(uint32_t round) {
+    bitbench_set_t a, b, old, new, dst;
+    uint16_t count;
+
+    bitbench_random(&a, rand() % 257);
+    bitbench_random(&b, rand() % 257);
+
+    // Testing, and counting.
+    count = 0;
+    for (uint16_t id=0; id<BADGES_SET_WORDS * BITSET_WORD_BITS; id++) {
+        if (bitset_test(a.words, id) != check_id_buf(id, a.bytes)) {
+            bitbench_fail("bitset_test", round, id);
+        }
+        count += check_id_buf(id, a.bytes);
+    }
+    if (bitset_count(a.words, BADGES_SET_WORDS) != buffer_rank(a.bytes, BITBENCH_BYTES) ||
+            bitset_count(a.words, BADGES_SET_WORDS) != count) {
+        bitbench_fail("bitset_count", round, 0);
+    }
+
+    // The same sets and clears, in the same order.
+    old = a;
+    new = a;
+    for (uint8_t i=0; i<64; i++) {
+        uint16_t id = rand() % BADGES_IN_SYSTEM;
+        uint8_t setting = rand() % 2;
+
+        if (setting) {
+            set_id_buf(id, old.bytes);
+            bitset_set(new.words, id);
+        } else {
+            unset_id_buf(id, old.bytes);
+            bitset_clear(new.words, id);
+        }
+        if (memcmp(&old, &new, sizeof(old))) {
+            bitbench_fail(setting ? "bitset_set" : "bitset_clear", round, id);
+            break;
+        }
+    }
+
+    // Going through the set bits, from a random start.
+    uint16_t from = rand() % (BADGES_SET_WORDS * BITSET_WORD_BITS + 1);
+    uint16_t next = bitset_next(a.words, BADGES_SET_WORDS, from);
+    for (uint16_t id=from; id<BADGES_SET_WORDS * BITSET_WORD_BITS; id++) {
+        if (!check_id_buf(id, a.bytes)) {
+            continue;
+        }
+        if (next != id) {
+            bitbench_fail("bitset_next", round, id);
+            break;
+        }
+        next = bitset_next(a.words, BADGES_SET_WORDS, id + 1);
+    }
+    if (next != BITSET_NONE) {
+        bitbench_fail("bitset_next at the end", round, next);
+    }
+
+    // Set algebra, into a third set and in place.
+    for (uint8_t op=0; op<3; op++) {
+        const char *name[] = {"bitset_or", "bitset_and", "bitset_andnot"};
+        void (*fn[])(uint16_t *, const uint16_t *, const uint16_t *, uint8_t) = {
+            bitset_or, bitset_and, bitset_andnot,
+        };
+        bitbench_set_t in_place = a;
+
+        fn[op](dst.words, a.words, b.words, BADGES_SET_WORDS);
+        fn[op](in_place.words, in_place.words, b.words, BADGES_SET_WORDS);
+        for (uint16_t id=0; id<BADGES_SET_WORDS * BITSET_WORD_BITS; id++) {
+            uint8_t in_a = check_id_buf(id, a.bytes);
+            uint8_t in_b = check_id_buf(id, b.bytes);
+            uint8_t want = op == 0 ? in_a || in_b : op == 1 ? in_a && in_b : in_a && !in_b;
+
+            if (check_id_buf(id, dst.bytes) != want ||
+                    check_id_buf(id, in_place.bytes) != want) {
+                bitbench_fail(name[op], round, id);
+                break;
+            }
+        }
+    }
+
+    count = 0;
+    for (uint16_t id=0; id<BADGES_SET_WORDS * BITSET_WORD_BITS; id++) {
+        count += check_id_buf(id, a.bytes) && check_id_buf(id, b.bytes);
+    }
+    if (bitset_count_and(a.words, b.words, BADGES_SET_WORDS) != count) {
+        bitbench_fail("bitset_count_and", round, 0);
+    }
+}
+
+/// Check everything, and print what was checked.
+void bitbench_check(uint32_t rounds) {
+    for (uint32_t w=0; w<=0xffff; w++) {
+        if (bitset_word_count(w) != byte_rank(w & 0xff) + byte_rank(w >> 8)) {
+            bitbench_fail("bitset_word_count", 0, w);
+        }
+    }
+
+    srand(1);
+    for (uint32_t round=0; round<rounds; round++) {
+        bitbench_check_round(round);
+    }
+
+    printf("Checked every 16-bit word count, and %u rounds of random sets: %s.\n",
+           rounds, bitbench_failures ? "DISAGREEMENTS" : "all agree");
+}
+
+volatile uint16_t bitbench_sink;
+
+/// Time finding the badges in range, the old way and the new, with `in_range` of them.
+void bitbench_time_scan(uint8_t in_range) {
+    static badge_info_t info[BADGES_IN_SYSTEM];
+    bitbench_set_t set;
+    uint64_t t0, old_ns, new_ns;
+
+    memset(info, 0, sizeof(info));
+    memset(&set, 0, sizeof(set));
+    for (uint8_t placed=0; placed<in_range; ) {
+        uint16_t id = rand() % BADGES_IN_SYSTEM;
+
+        if (!info[id].intervals_left) {
+            info[id].intervals_left = 1;
+            bitset_set(set.words, id);
+            placed++;
+        }
+    }
+
+    t0 = bitbench_nsecs();
+    for (uint32_t r=0; r<BITBENCH_REPS; r++) {
+        uint16_t found = 0;
+
+        for (uint16_t i=0; i<BADGES_IN_SYSTEM; i++) {
+            if (((volatile badge_info_t *) info)[i].intervals_left) {
+                found += i;
+            }
+        }
+        bitbench_sink = found;
+    }
+    old_ns = bitbench_nsecs() - t0;
+
+    t0 = bitbench_nsecs();
+    for (uint32_t r=0; r<BITBENCH_REPS; r++) {
+        uint16_t found = 0;
+
+        for (uint16_t i = bitset_next(set.words, BADGES_SET_WORDS, 0);
+                i != BITSET_NONE;
+                i = bitset_next(set.words, BADGES_SET_WORDS, i + 1)) {
+            found += i;
+        }
+        bitbench_sink = found;
+    }
+    new_ns = bitbench_nsecs() - t0;
+
+    printf("  in range, %3u of %u      %8.1f %8.1f\n", in_range, BADGES_IN_SYSTEM,
+           (double) old_ns / BITBENCH_REPS, (double) new_ns / BITBENCH_REPS);
+}
+
+/// Time each old way and new way, and print them.
+void bitbench_time() {
+    bitbench_set_t a, b;
+    uint64_t t0, old_ns, new_ns;
+
+    srand(2);
+    bitbench_random(&a, 128);
+    bitbench_random(&b, 128);
+
+    printf("Host time, ns per operation on a set of %u IDs:   old      new\n",
+           BADGES_IN_SYSTEM);
+
+    t0 = bitbench_nsecs();
+    for (uint32_t r=0; r<BITBENCH_REPS; r++) {
+        for (uint16_t id=0; id<BADGES_IN_SYSTEM; id++) {
+            bitbench_sink = check_id_buf(id, a.bytes);
+        }
+    }
+    old_ns = bitbench_nsecs() - t0;
+    t0 = bitbench_nsecs();
+    for (uint32_t r=0; r<BITBENCH_REPS; r++) {
+        for (uint16_t id=0; id<BADGES_IN_SYSTEM; id++) {
+            bitbench_sink = bitset_test(a.words, id);
+        }
+    }
+    new_ns = bitbench_nsecs() - t0;
+    printf("  test every ID             %8.1f %8.1f\n",
+           (double) old_ns / BITBENCH_REPS, (double) new_ns / BITBENCH_REPS);
+
+    t0 = bitbench_nsecs();
+    for (uint32_t r=0; r<BITBENCH_REPS; r++) {
+        bitbench_sink = buffer_rank(a.bytes, BITBENCH_BYTES);
+    }
+    old_ns = bitbench_nsecs() - t0;
+    t0 = bitbench_nsecs();
+    for (uint32_t r=0; r<BITBENCH_REPS; r++) {
+        bitbench_sink = bitset_count(a.words, BADGES_SET_WORDS);
+    }
+    new_ns = bitbench_nsecs() - t0;
+    printf("  count, half full          %8.1f %8.1f\n",
+           (double) old_ns / BITBENCH_REPS, (double) new_ns / BITBENCH_REPS);
+
+    t0 = bitbench_nsecs();
+    for (uint32_t r=0; r<BITBENCH_REPS; r++) {
+        uint16_t count = 0;
+
+        for (uint16_t id=0; id<BADGES_IN_SYSTEM; id++) {
+            count += check_id_buf(id, a.bytes) && check_id_buf(id, b.bytes);
+        }
+        bitbench_sink = count;
+    }
+    old_ns = bitbench_nsecs() - t0;
+    t0 = bitbench_nsecs();
+    for (uint32_t r=0; r<BITBENCH_REPS; r++) {
+        bitbench_sink = bitset_count_and(a.words, b.words, BADGES_SET_WORDS);
+    }
+    new_ns = bitbench_nsecs() - t0;
+    printf("  count seen by both        %8.1f %8.1f\n",
+           (double) old_ns / BITBENCH_REPS, (double) new_ns / BITBENCH_REPS);
+
+    bitbench_time_scan(0);
+    bitbench_time_scan(5);
+    bitbench_time_scan(30);
+    bitbench_time_scan(BADGES_IN_SYSTEM);
+}
+
+int main(int argc, char *argv[]) {
+    uint32_t rounds = argc > 1 ? strtoul(argv[1], 0, 0) : 10000;
+
+    if (argc > 2 || !rounds) {
+        fprintf(stderr, "usage: %s [rounds]\n", argv[0]);
+        return 2;
+    }
+
+    bitbench_check(rounds);
+    bitbench_time();
+    return bitbench_failures ? 1 : 0;
+}
@@ -0,0 +1,400 @@
+/// Decode a badge's encounter log, or benchmark appending to it, on Linux.
+/**
+ ** usage: encdump dump
+ **        encdump -b [-w log.bin] [encounters]
+ **
+ ** A dump is either the log on its own (ENCLOG_BYTES of raw binary), or
+ ** a TI-TXT memory dump from the badge that covers ENCLOG_ADDR, e.g.
+ **
+ **     MSP430Flasher -r [dump.txt,MAIN] -z [VCC]
+ **
+ ** The log is a ring, and only holds the last hundred or so encounters;
+ ** it's decoded from its oldest block on. Every encounter is printed with
+ ** its peer, when it was first and last heard (since the boot before it),
+ ** how long it lasted, and its boops. Times are at the log's resolution of
+ ** one radio interval. Then it says how many blocks of older encounters
+ ** were overwritten to make room.
+ **
+ ** With -b, it runs enclog.c, built unmodified against the stand-ins in
+ ** hw.c, on made-up encounters instead (default 10000): every radio
+ ** interval, each of a few dozen peers in the room has a small chance of
+ ** aging out, after having been in range for up to half an hour, and one
+ ** in four encounters includes a boop or few. It reports what appending
+ ** them cost on this host, and what the log kept, against a fixed-size
+ ** record for each; then it decodes the log and checks that the last
+ ** encounters came back the same, and that enclog_overwritten accounts
+ ** for the rest. With -w, the log is saved, to try the decoder on.
+ **
+ ** \file encdump.c
+ ** \author George Louthan
+ ** \date   2023
+ ** \copyright (c) 2023 George Louthan @duplico. MIT License.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "badge.h"
+#include "radio.h"
+#include "enclog.h"
+#include "hw.h"
+
+/// Bytes a fixed-size record would take: ID, first heard (32-bit seconds), duration, boops.
+#define ENCDUMP_FIXED_RECORD_BYTES 8
+/// Peers in the room in the benchmark, any one of which might age out.
+#define ENCDUMP_PEERS 40
+/// Chance, in 1024, that a given peer ages out in a given interval.
+#define ENCDUMP_AGE_OUT_CHANCE 4
+/// Longest an encounter lasts in the benchmark, in radio intervals (30 minutes).
+#define ENCDUMP_DURATION_MAX (30 * 60 / RADIO_BEACON_INTERVAL_SECS)
+
+/// Nanoseconds on the host's monotonic clock.
+uint64_t encdump_nsecs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/// Format `intervals` radio intervals as h:mm:ss into `out`.
+char *encdump_time(char *out, uint32_t intervals) {
+    uint32_t secs = intervals * RADIO_BEACON_INTERVAL_SECS;
+
+    sprintf(out, "%u:%02u:%02u", secs / 3600, secs / 60 % 60, secs % 60);
+    return out;
+}
+
+/// Read a dump at `path` into `log`, which is ENCLOG_BYTES long.
+int encdump_load(const char *path, uint8_t *log) {
+    FILE *f = fopen(path, "rb");
+    char line[1024];
+    long size;
+    int c;
+
+    if (!f) {
+        perror(path);
+        return 0;
+    }
+    memset(log, ENCLOG_END, ENCLOG_BYTES);
+
+    c = fgetc(f);
+    ungetc(c, f);
+    if (c != '@') {
+        // Raw: just the log.
+        fseek(f, 0, SEEK_END);
+        size = ftell(f);
+        rewind(f);
+        if (size != ENCLOG_BYTES || fread(log, 1, ENCLOG_BYTES, f) != ENCLOG_BYTES) {
+            fprintf(stderr, "%s: expected %u bytes, or a TI-TXT dump.\n", path, ENCLOG_BYTES);
+            fclose(f);
+            return 0;
+        }
+        fclose(f);
+        return 1;
+    }
+
+    // TI-TXT: "@addr" lines, then lines of hex bytes from there, then "q".
+    uint32_t addr = 0;
+    while (fgets(line, sizeof(line), f)) {
+        char *p = line;
+        char *end;
+
+        if (*p == '@') {
+            addr = strtoul(p + 1, 0, 16);
+            continue;
+        }
+        if (*p == 'q') {
+            break;
+        }
+        for (;;) {
+            unsigned long byte = strtoul(p, &end, 16);
+
+            if (end == p) {
+                break;
+            }
+            if (addr >= ENCLOG_ADDR && addr < ENCLOG_ADDR + ENCLOG_BYTES) {
+                log[addr - ENCLOG_ADDR] = byte;
+            }
+            addr++;
+            p = end;
+        }
+    }
+    fclose(f);
+    return 1;
+}
+
+/// What encdump_walk() found in a log.
+typedef struct {
+    /// Blocks decoded, and the oldest one's sequence number.
+    uint8_t blocks;
+    uint16_t oldest_seq;
+    /// Bytes of records decoded.
+    uint16_t bytes;
+    /// Blocks whose records stopped at something that doesn't decode.
+    uint8_t bad_blocks;
+} encdump_walk_t;
+
+/// Decode `log` from its oldest block to its newest, calling `fn` on each record.
+void encdump_walk(uint8_t *log, void (*fn)(enclog_record_t *record, void *arg), void *arg,
+                  encdump_walk_t *walk) {
+    enclog_record_t record;
+    uint16_t newest_seq;
+    uint16_t seq;
+    uint16_t time_base;
+    uint16_t offset;
+    uint16_t next;
+    uint8_t newest = enclog_newest(log, &newest_seq);
+
+    memset(walk, 0, sizeof(*walk));
+    if (newest == ENCLOG_BLOCKS) {
+        return;
+    }
+    for (uint8_t i=1; i<=ENCLOG_BLOCKS; i++) {
+        uint8_t block = (newest + i) % ENCLOG_BLOCKS;
+        uint16_t end = ENCLOG_BLOCK_OFFSET(block + 1);
+
+        offset = enclog_block_read(log, block, &seq, &time_base);
+        if (!offset || seq != (uint16_t) (newest_seq - (ENCLOG_BLOCKS - i))) {
+            continue; // Not written yet, or cut short.
+        }
+        if (!walk->blocks++) {
+            walk->oldest_seq = seq;
+        }
+        while ((next = enclog_read(log, end, offset, &time_base, &record))) {
+            fn(&record, arg);
+            walk->bytes += next - offset;
+            offset = next;
+        }
+        if (offset < end && log[offset] != ENCLOG_END) {
+            walk->bad_blocks++;
+        }
+    }
+}
+
+/// Counts for encdump_print_record().
+typedef struct {
+    uint32_t boots;
+    uint32_t encounters;
+} encdump_print_t;
+
+/// Print one record of a log.
+void encdump_print_record(enclog_record_t *record, void *arg) {
+    encdump_print_t *counts = arg;
+    char first[16], last[16], length[16];
+
+    if (record->id == ENCLOG_BOOT) {
+        counts->boots++;
+        printf("boot %u\n", counts->boots);
+        return;
+    }
+    if (!counts->boots && !counts->encounters) {
+        printf("boot (partly overwritten)\n");
+    }
+    counts->encounters++;
+    printf("  badge %3u  first heard %9s  last heard %9s  in range %9s  boops %u\n",
+           record->id,
+           encdump_time(first, (uint16_t) (record->last_heard - record->duration)),
+           encdump_time(last, record->last_heard),
+           encdump_time(length, record->duration), record->boops);
+}
+
+/// Print every record in `log`, and a summary.
+int encdump_print(uint8_t *log) {
+    uint8_t header[ENCLOG_HEADER_BYTES] = {
+        ENCLOG_MAGIC & 0xff, ENCLOG_MAGIC >> 8,
+        ENCLOG_VERSION & 0xff, ENCLOG_VERSION >> 8,
+    };
+    encdump_print_t counts = {0};
+    encdump_walk_t walk;
+
+    if (memcmp(log, header, ENCLOG_HEADER_BYTES)) {
+        fprintf(stderr, "Not an encounter log (version %u).\n", ENCLOG_VERSION);
+        return 0;
+    }
+
+    encdump_walk(log, encdump_print_record, &counts, &walk);
+    printf("%u encounters over %u boots, in %u blocks of %u bytes",
+           counts.encounters, counts.boots, walk.blocks, ENCLOG_BLOCK_BYTES);
+    if (walk.bad_blocks) {
+        printf("; %u stopped at a record that doesn't decode", walk.bad_blocks);
+    }
+    printf(".\n");
+    // Blocks are numbered from 0 when the log's formatted.
+    printf("%u older blocks were overwritten, at about %u encounters each.\n",
+           walk.oldest_seq, walk.blocks ? (counts.encounters + walk.blocks / 2) / walk.blocks : 0);
+    return 1;
+}
+
+/// One made-up encounter, as it went in.
+typedef struct {
+    uint8_t id;
+    uint16_t first_heard;
+    uint16_t last_heard;
+    uint8_t boops;
+} encdump_encounter_t;
+
+/// What the benchmark checks the log against.
+typedef struct {
+    encdump_encounter_t *encounters;
+    /// Where the log should start in `encounters`, and where it's got to.
+    uint32_t next;
+    uint32_t end;
+    /// Encounters that didn't match, and all of them.
+    uint32_t wrong;
+    uint32_t checked;
+} encdump_check_t;
+
+/// Check one record of the benchmark's log against what went in.
+void encdump_check_record(enclog_record_t *record, void *arg) {
+    encdump_check_t *check = arg;
+    encdump_encounter_t *e = &check->encounters[check->next];
+
+    if (record->id == ENCLOG_BOOT) {
+        return;
+    }
+    if (check->next >= check->end || record->id != e->id ||
+            record->last_heard != e->last_heard ||
+            record->duration != (uint16_t) (e->last_heard - e->first_heard) ||
+            record->boops != e->boops) {
+        if (!check->wrong++) {
+            fprintf(stderr, "Encounter %u didn't decode the way it went in.\n", check->next);
+        }
+    }
+    check->next++;
+    check->checked++;
+}
+
+/// Count one encounter in a log.
+void encdump_count_record(enclog_record_t *record, void *arg) {
+    if (record->id != ENCLOG_BOOT) {
+        (*(uint32_t *) arg)++;
+    }
+}
+
+/// Append `count` made-up encounters to the log, and check the ones it kept.
+int encdump_bench(uint32_t count, const char *save) {
+    encdump_encounter_t *encounters = malloc(count * sizeof(encdump_encounter_t));
+    uint32_t appended = 0;
+    uint32_t commits = 0;
+    uint32_t boops = 0;
+    uint64_t append_nsecs = 0;
+    uint64_t commit_nsecs = 0;
+    // Start late enough that the first encounter could've lasted the longest.
+    uint16_t interval = RADIO_WINDOW_BEACON_COUNT + ENCDUMP_DURATION_MAX;
+
+    srand(1);
+    enclog_init();
+
+    while (appended < count) {
+        uint32_t staged = appended;
+        uint64_t t0;
+
+        interval++;
+        for (uint8_t peer=0; peer<ENCDUMP_PEERS && appended < count; peer++) {
+            encdump_encounter_t *e = &encounters[appended];
+
+            if (rand() % 1024 >= ENCDUMP_AGE_OUT_CHANCE) {
+                continue;
+            }
+            e->id = peer;
+            e->last_heard = interval - RADIO_WINDOW_BEACON_COUNT;
+            e->first_heard = e->last_heard - rand() % (ENCDUMP_DURATION_MAX + 1);
+            e->boops = rand() % 4 ? 0 : 1 + rand() % 3;
+            boops += e->boops;
+
+            t0 = encdump_nsecs();
+            enclog_encounter(e->id, e->first_heard, e->last_heard, e->boops);
+            append_nsecs += encdump_nsecs() - t0;
+            appended++;
+        }
+
+        t0 = encdump_nsecs();
+        enclog_commit();
+        commit_nsecs += encdump_nsecs() - t0;
+        if (appended != staged) {
+            commits++;
+        }
+    }
+
+    // The log should have the last encounters, with the rest overwritten.
+    encdump_check_t check = {encounters, 0, appended, 0, 0};
+    encdump_walk_t walk;
+
+    if (enclog_overwritten < UINT16_MAX) {
+        check.next = enclog_overwritten;
+    } else {
+        // Too many to count: just check the last ones.
+        encdump_walk(enclog_data, encdump_count_record, &check.next, &walk);
+        check.next = appended - check.next;
+    }
+    encdump_walk(enclog_data, encdump_check_record, &check, &walk);
+    if (check.wrong || check.next != appended || walk.bad_blocks) {
+        fprintf(stderr, "Decoded %u encounters of %u, %u wrong, with %u overwritten.\n",
+                check.checked, appended, check.wrong, enclog_overwritten);
+        return 0;
+    }
+
+    double per = check.checked ? (double) walk.bytes / check.checked : 0;
+
+    printf("Appended %u encounters (%u boops) in %u commits.\n", appended, boops, commits);
+    printf("Log: kept the last %u in %u blocks of %u bytes, %.2f bytes per encounter; "
+           "a %u-byte fixed record would fit %u.\n", check.checked, walk.blocks,
+           ENCLOG_BLOCK_BYTES, per, ENCDUMP_FIXED_RECORD_BYTES,
+           (ENCLOG_BYTES - ENCLOG_HEADER_BYTES) / ENCDUMP_FIXED_RECORD_BYTES);
+    printf("Overwritten: %u blocks, %u encounters%s.\n", walk.oldest_seq,
+           enclog_overwritten, enclog_overwritten == UINT16_MAX ? " or more" : "");
+    printf("Host time: %.0f ns per enclog_encounter(), %.0f ns per enclog_commit() "
+           "that wrote.\n", appended ? (double) append_nsecs / appended : 0.0,
+           commits ? (double) commit_nsecs / commits : 0.0);
+    printf("Decoded the last %u back the same.\n", check.checked);
+
+    if (save) {
+        FILE *f = fopen(save, "wb");
+
+        if (!f || fwrite(enclog_data, 1, ENCLOG_BYTES, f) != ENCLOG_BYTES) {
+            perror(save);
+            return 0;
+        }
+        fclose(f);
+    }
+    free(encounters);
+    return 1;
+}
+
+int main(int argc, char *argv[]) {
+    uint8_t log[ENCLOG_BYTES];
+    const char *save = 0;
+    int bench = 0;
+    int c;
+
+    while ((c = getopt(argc, argv, "bw:")) != -1) {
+        switch (c) {
+        case 'b':
+            bench = 1;
+            break;
+        case 'w':
+            save = optarg;
+            break;
+        default:
+            fprintf(stderr, "usage: %s dump\n       %s -b [-w log.bin] [encounters]\n", argv[0], argv[0]);
+            return 2;
+        }
+    }
+
+    if (bench) {
+        uint32_t count = optind < argc ? strtoul(argv[optind], 0, 0) : 10000;
+        return encdump_bench(count, save) ? 0 : 1;
+    }
+
+    if (optind != argc - 1) {
+        fprintf(stderr, "usage: %s dump\n       %s -b [-w log.bin] [encounters]\n", argv[0], argv[0]);
+        return 2;
+    }
+    if (!encdump_load(argv[optind], log)) {
+        return 1;
+    }
+    return encdump_print(log) ? 0 : 1;
+}
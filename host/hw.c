@@ -0,0 +1,238 @@
+/// Host stand-ins for the badge hardware.
+/**
+ ** The application modules (radio.c, badge.c, leds.c, and friends) are built
+ ** unmodified for Linux against these. The radio and LED drivers are
+ ** replaced with stand-ins that just count what they're asked to do (and can
+ ** hand each LED frame to the harness through hw_led_frame_cb), and a
+ ** transmission completes on the next call to hw_radio_step(), the way the
+ ** deferred interrupt would complete it on the badge. The CRC module is done
+ ** in software, bit for bit the way the MSP430 does it, and the RTC counts
+ ** its 2048 Hz along with the harness's clock in hw_rtc_step().
+ **
+ ** \file hw.c
+ ** \author George Louthan
+ ** \date   2023
+ ** \copyright (c) 2023 George Louthan @duplico. MIT License.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#define HOST_REG(type, name) volatile type name;
+#include <msp430fr2633.h>
+#include <driverlib.h>
+
+#include "badge.h"
+#include "rfm75.h"
+#include "tlc5948a.h"
+#include "rtc.h"
+#include "hw.h"
+
+void RTC_ISR(void);
+extern uint16_t rtc_len;
+
+hw_counts_t hw_counts;
+radio_proto_t hw_last_tx;
+uint8_t hw_tx_pending = 0;
+hw_led_frame_fn *hw_led_frame_cb = 0;
+
+// Flags that main.c owns on the badge.
+volatile uint8_t button_state = 0;
+uint8_t s_boop_radio = 0;
+/// Simulated centiseconds since hw_init().
+uint32_t hw_rtc_csecs = 0;
+/// RTC counts since hw_init() at which the RTC's counter was last 0.
+uint32_t hw_rtc_base = 0;
+/// The RTC's shadow of RTCMOD, which it overflows at.
+uint16_t hw_rtc_shadow = 0;
+
+void fram_unlock() {
+    hw_counts.fram_writes++;
+}
+
+void fram_lock() {
+}
+
+void fram_protect(uint16_t protect) {
+    if (!(protect & DFWP)) {
+        hw_counts.fram_writes++;
+    }
+}
+
+void smclk_set_div_shift(uint8_t shift) {
+}
+
+// CRC module, fed through CRCDI, which takes each byte LSB first.
+
+/// Running value of the emulated CRC module.
+uint16_t hw_crc = 0;
+
+void CRC_setSeed(uint16_t baseAddress, uint16_t seed) {
+    hw_crc = seed;
+}
+
+void CRC_set8BitData(uint16_t baseAddress, uint8_t dataIn) {
+    for (uint8_t i=0; i<8; i++) {
+        uint8_t feedback = ((hw_crc >> 15) ^ (dataIn >> i)) & 1;
+        hw_crc <<= 1;
+        if (feedback) {
+            hw_crc ^= 0x1021;
+        }
+    }
+}
+
+uint16_t CRC_getResult(uint16_t baseAddress) {
+    return hw_crc;
+}
+
+// RFM75 radio.
+
+uint32_t rfm75_seqnum = 0;
+
+rfm75_tx_callback_fn *hw_tx_done_cb;
+
+void rfm75_init(uint16_t unicast_address, rfm75_rx_callback_fn *rx_callback, rfm75_tx_callback_fn *tx_callback) {
+    hw_tx_done_cb = tx_callback;
+}
+
+uint8_t rfm75_post() {
+    return 1;
+}
+
+uint8_t rfm75_tx_avail() {
+    return !hw_tx_pending;
+}
+
+void rfm75_tx(uint16_t addr, uint8_t noack, uint8_t* data, uint8_t len) {
+    if (hw_tx_pending) {
+        return;
+    }
+    memcpy(&hw_last_tx, data, sizeof(radio_proto_t));
+    hw_counts.radio_tx++;
+    hw_tx_pending = 1;
+}
+
+void rfm75_write_reg(uint8_t reg, uint8_t data) {
+    hw_counts.radio_regs++;
+}
+
+uint8_t rfm75_read_reg(uint8_t cmd) {
+    hw_counts.radio_regs++;
+    return 0; // Carrier detect never sees anything.
+}
+
+/// Finish the transmission in flight, if any, as the deferred interrupt would.
+void hw_radio_step() {
+    if (hw_tx_pending) {
+        hw_tx_pending = 0;
+        hw_tx_done_cb(1);
+    }
+}
+
+// TLC5948A LED driver.
+
+volatile uint8_t tlc_send_type = TLC_SEND_IDLE;
+volatile uint8_t tlc_dark = 0;
+uint16_t tlc_gs_data[16] = {0, };
+/// Every LED passes its test on the host.
+uint16_t tlc_leds_open = 0;
+uint16_t tlc_leds_shorted = 0;
+/// The dot correct scale last staged; there's no calibration on the host.
+uint8_t hw_dc_scale = TLC_DC_SCALE_FULL;
+
+void tlc_init() {
+}
+
+void tlc_set_gs() {
+    uint16_t lit = 0;
+
+    for (uint8_t i=0; i<16; i++) {
+        lit |= tlc_gs_data[i];
+    }
+    tlc_dark = !lit;
+    hw_counts.led_frames++;
+    if (hw_led_frame_cb) {
+        hw_led_frame_cb();
+    }
+}
+
+void tlc_set_fun() {
+}
+
+void tlc_stage_bc(uint8_t bc) {
+}
+
+void tlc_stage_blank(uint8_t blank) {
+}
+
+void tlc_stage_dc(uint8_t scale) {
+    hw_dc_scale = scale;
+}
+
+uint8_t tlc_get_dc(uint8_t i) {
+    return (uint16_t) TLC_DC * hw_dc_scale / TLC_DC_SCALE_FULL;
+}
+
+/// Reset the hardware stand-ins to their power-on state.
+void hw_init() {
+    memset(&hw_counts, 0, sizeof(hw_counts));
+    hw_tx_pending = 0;
+    tlc_dark = 0;
+    hw_rtc_csecs = 0;
+    hw_rtc_base = 0;
+    hw_rtc_shadow = 0;
+    RTCIV = RTCIV_RTCIF; // Every RTC interrupt is an overflow.
+}
+
+/// Return the RTC counts from hw_init() to the first at or after this centisecond.
+uint32_t hw_rtc_counts() {
+    return (hw_rtc_csecs * RTC_COUNTS_PER_SEC + 99) / 100;
+}
+
+/// Read the RTC's counter, first doing the reset that a write of RTCSR asked for.
+/**
+ ** The real RTC resets as RTCSR is written, and it reads back as 0. It also
+ ** loads RTCMOD into its shadow then, but rtc.c writes the next period's
+ ** length over it straight after, before we can see it, so the first
+ ** period's length comes from rtc.c's own bookkeeping instead.
+ */
+uint16_t hw_rtc_count() {
+    if (RTCCTL & RTCSR) {
+        RTCCTL &= ~RTCSR;
+        hw_rtc_base = hw_rtc_counts();
+        hw_rtc_shadow = rtc_len;
+    }
+    return hw_rtc_counts() - hw_rtc_base;
+}
+
+/// Read ACLK's count, as Timer_A0 would, which stands still while we're awake.
+uint16_t hw_aclk_count() {
+    return (uint64_t) hw_rtc_csecs * 32768 / 100;
+}
+
+/// Read the host's clock in microseconds, as Timer_A1 would count them.
+/**
+ ** Unlike ACLK, this one moves while we're awake, so the event timings
+ ** measure the host's real time in each handler.
+ */
+uint16_t hw_usec_count() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/// Run the RTC for one centisecond, and return 1 if it overflowed and interrupted.
+uint8_t hw_rtc_step() {
+    hw_rtc_count();
+    hw_rtc_csecs++;
+    if (hw_rtc_counts() - hw_rtc_base < hw_rtc_shadow) {
+        return 0;
+    }
+
+    // RTCMOD goes into the shadow at each overflow.
+    hw_rtc_base += hw_rtc_shadow;
+    hw_rtc_shadow = RTCMOD;
+    RTC_ISR();
+    return 1;
+}
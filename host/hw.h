@@ -0,0 +1,43 @@
+/// Header for the host hardware stand-ins.
+/**
+ ** \file hw.h
+ ** \author George Louthan
+ ** \date   2023
+ ** \copyright (c) 2023 George Louthan @duplico. MIT License.
+ */
+
+#ifndef HOST_HW_H_
+#define HOST_HW_H_
+
+#include <stdint.h>
+
+#include "radio.h"
+
+/// Counts of what the application asked the hardware to do.
+typedef struct {
+    /// Register reads and writes on the radio.
+    uint32_t radio_regs;
+    /// Packets handed to the radio to transmit.
+    uint32_t radio_tx;
+    /// Grayscale frames handed to the LED driver.
+    uint32_t led_frames;
+    /// FRAM unlocks.
+    uint32_t fram_writes;
+} hw_counts_t;
+
+/// Called with each new grayscale frame, which is in tlc_gs_data.
+typedef void hw_led_frame_fn();
+
+extern hw_counts_t hw_counts;
+/// If set, called every time the application sends the LEDs a frame.
+extern hw_led_frame_fn *hw_led_frame_cb;
+/// The last packet handed to the radio to transmit.
+extern radio_proto_t hw_last_tx;
+/// Set while a transmission is "on the air," until hw_radio_step().
+extern uint8_t hw_tx_pending;
+
+void hw_init();
+void hw_radio_step();
+uint8_t hw_rtc_step();
+
+#endif /* HOST_HW_H_ */
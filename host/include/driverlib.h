@@ -0,0 +1,22 @@
+/// Host stand-in for the parts of DriverLib the application modules use.
+/**
+ ** \file driverlib.h
+ ** \author George Louthan
+ ** \date   2023
+ ** \copyright (c) 2023 George Louthan @duplico. MIT License.
+ */
+
+#ifndef HOST_DRIVERLIB_H_
+#define HOST_DRIVERLIB_H_
+
+#include <stdint.h>
+
+#include "msp430fr2633.h"
+
+#define CRC_BASE 0x01C0
+
+void CRC_setSeed(uint16_t baseAddress, uint16_t seed);
+void CRC_set8BitData(uint16_t baseAddress, uint8_t dataIn);
+uint16_t CRC_getResult(uint16_t baseAddress);
+
+#endif /* HOST_DRIVERLIB_H_ */
@@ -0,0 +1,9 @@
+/// Host stand-in for the generic MSP430 header.
+/**
+ ** \file msp430.h
+ ** \author George Louthan
+ ** \date   2023
+ ** \copyright (c) 2023 George Louthan @duplico. MIT License.
+ */
+
+#include "msp430fr2633.h"
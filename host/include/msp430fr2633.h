@@ -0,0 +1,91 @@
+/// Host stand-in for the MSP430FR2633 device header.
+/**
+ ** Just enough of the device header for the badge's application modules to
+ ** build on Linux. Intrinsics do nothing, and registers are plain variables
+ ** that the host harness defines in hw.c (by defining HOST_REG first).
+ **
+ ** \file msp430fr2633.h
+ ** \author George Louthan
+ ** \date   2023
+ ** \copyright (c) 2023 George Louthan @duplico. MIT License.
+ */
+
+#ifndef HOST_MSP430FR2633_H_
+#define HOST_MSP430FR2633_H_
+
+#include <stdint.h>
+
+#define __interrupt
+#define __even_in_range(x, y) (x)
+#define __no_operation()
+#define __delay_cycles(x)
+#define __bis_SR_register(x) ((void) (x))
+#define __bic_SR_register(x) ((void) (x))
+#define __get_SR_register() (0)
+#define __bic_SR_register_on_exit(x)
+#define LPM0_EXIT
+#define LPM3_EXIT
+
+#define LPM0_bits 0x0010
+#define LPM3_bits 0x00d0
+#define GIE 0x0008
+
+#ifndef HOST_REG
+#define HOST_REG(type, name) extern volatile type name;
+#endif
+
+HOST_REG(uint16_t, RTCCTL)
+HOST_REG(uint16_t, RTCMOD)
+HOST_REG(uint16_t, RTCIV)
+HOST_REG(uint16_t, SYSCFG0)
+HOST_REG(uint16_t, SYSCFG2)
+HOST_REG(uint16_t, TA0CTL)
+HOST_REG(uint16_t, TA1CTL)
+HOST_REG(uint16_t, UCA0IE)
+HOST_REG(uint16_t, UCA0TXBUF)
+HOST_REG(uint16_t, UCA0IV)
+HOST_REG(uint8_t, P1SEL0)
+
+/// The RTC's counter, which hw.c runs; see hw_rtc_step().
+uint16_t hw_rtc_count();
+#define RTCCNT (hw_rtc_count())
+/// Timer_A0's counter, running on ACLK; see hw_aclk_count().
+uint16_t hw_aclk_count();
+#define TA0R (hw_aclk_count())
+/// Timer_A1's counter, running on SMCLK/8; see hw_usec_count().
+uint16_t hw_usec_count();
+#define TA1R (hw_usec_count())
+
+#define BIT0 0x0001
+#define BIT1 0x0002
+#define BIT2 0x0004
+#define BIT3 0x0008
+#define BIT4 0x0010
+#define BIT5 0x0020
+#define BIT6 0x0040
+#define BIT7 0x0080
+
+#define PFWP 0x0001
+#define DFWP 0x0002
+#define FRWPPW 0xA500
+
+#define RTCSS__SMCLK 0x1000
+#define RTCPS__16 0x0400
+#define RTCCKSEL 0x0400
+#define RTCSR 0x0040
+#define RTCIE 0x0002
+#define RTCIFG 0x0001
+#define RTCIV_RTCIF 0x0002
+
+#define TASSEL__ACLK 0x0100
+#define TASSEL__SMCLK 0x0200
+#define ID 0x00C0
+#define ID__8 0x00C0
+#define MC 0x0030
+#define MC__CONTINUOUS 0x0020
+#define TACLR 0x0004
+
+#define UCTXIE 0x0002
+#define USCI_UART_UCTXIFG 0x0004
+
+#endif /* HOST_MSP430FR2633_H_ */
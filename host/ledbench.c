@@ -0,0 +1,154 @@
+/// Measure the badge's LED work at each scan speed, on Linux.
+/**
+ ** usage: ledbench [seconds]
+ **
+ ** Runs leds.c, built unmodified against the stand-ins in hw.c, at every
+ ** brightness level and scanner speed the badge uses, for `seconds`
+ ** simulated seconds each (default 60). The eyes blink and animate at
+ ** their usual random intervals, just as the main loop would have them.
+ **
+ ** For each, it reports grayscale frames computed and actually sent per
+ ** second, the SPI bytes (and so TX interrupts) per second that those
+ ** frames cost on the badge, the share of the time every LED was dark (so
+ ** the TLC was blanked and GSCLK stopped), the share of timesteps that
+ ** leds_next_deadline() says could have been skipped, and the host time
+ ** spent per simulated second in the LED code. Then it times the crossfade engine on
+ ** its own, with all 16 channels fading at once.
+ **
+ ** \file ledbench.c
+ ** \author George Louthan
+ ** \date   2023
+ ** \copyright (c) 2023 George Louthan @duplico. MIT License.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "badge.h"
+#include "leds.h"
+#include "tlc5948a.h"
+#include "fade.h"
+#include "hw.h"
+
+/// Bytes shifted out to the TLC5948A per grayscale frame, with the GS flag.
+#define LEDBENCH_BYTES_PER_FRAME 33
+
+/// Nanoseconds on the host's monotonic clock.
+uint64_t ledbench_nsecs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/// Centiseconds that every LED was dark.
+uint32_t ledbench_dark_csecs = 0;
+/// Centiseconds before the LED system's next deadline.
+uint32_t ledbench_idle_csecs = 0;
+
+/// Run `secs` seconds of the LED system, like the main loop would.
+void ledbench_run(uint32_t secs) {
+    static uint8_t next_blink = 1;
+
+    for (uint32_t s=0; s<secs; s++) {
+        for (uint8_t csec=0; csec<100; csec++) {
+            uint16_t lit = 0;
+
+            if (leds_next_deadline() > 1) {
+                ledbench_idle_csecs++;
+            }
+            leds_timestep();
+            for (uint8_t i=0; i<16; i++) {
+                lit |= tlc_gs_data[i];
+            }
+            if (!lit) {
+                ledbench_dark_csecs++;
+            }
+        }
+        if (!next_blink) {
+            leds_blink_or_bling();
+            next_blink = rand() % BADGE_SECS_PER_BLINK_AVG;
+        } else {
+            next_blink--;
+        }
+    }
+}
+
+/// Host nanoseconds per tick to step and render 16 fading channels.
+double ledbench_fade_nsecs(uint32_t ticks) {
+    fade_t fades[16] = {{0,}};
+    uint16_t gs[16];
+    uint32_t sum = 0;
+    uint64_t t0 = ledbench_nsecs();
+
+    for (uint32_t t=0; t<ticks; t++) {
+        if (!fades[0].ticks) {
+            for (uint8_t i=0; i<16; i++) {
+                fade_to(&fades[i], fades[i].target ? 0 : FADE_LEVEL_ON, LEDS_FADE_TICKS + i);
+            }
+        }
+        fade_step(fades, 16);
+        for (uint8_t i=0; i<16; i++) {
+            gs[i] = fade_gs(fades[i].level, 0xf000);
+            sum += gs[i];
+        }
+    }
+
+    uint64_t dt = ledbench_nsecs() - t0;
+    if (sum == 1) // Keep the compiler from skipping the work.
+        printf(" ");
+    return (double) dt / ticks;
+}
+
+int main(int argc, char *argv[]) {
+    const uint8_t brightnesses[] = {BADGE_BRIGHTNESS_0, BADGE_BRIGHTNESS_1, BADGE_BRIGHTNESS_2};
+    uint32_t secs = argc > 1 ? atoi(argv[1]) : 60;
+
+    if (!secs) {
+        fprintf(stderr, "usage: %s [seconds]\n", argv[0]);
+        return 2;
+    }
+
+    hw_init();
+    srand(1);
+    badge_conf.bootstrapped = 1;
+    leds_init();
+    leds_fade_ticks = LEDS_FADE_TICKS;
+
+    printf("level  gs      speed  computed/s  sent/s  SPI bytes/s  dark %%  idle %%  LED mA  host ns/s\n");
+    for (uint8_t b=0; b<sizeof(brightnesses)/sizeof(brightnesses[0]); b++) {
+        for (uint16_t speed=0; speed<=80; speed+=8) {
+            leds_set_brightness(brightnesses[b]);
+            leds_scan_speed = speed;
+            ledbench_run(1); // Settle into the new speed.
+
+            uint32_t computed = leds_frames_computed;
+            uint32_t sent = leds_frames_sent;
+            uint32_t dark = ledbench_dark_csecs;
+            uint32_t idle = ledbench_idle_csecs;
+            leds_charge_t used = leds_charge_used;
+            uint64_t t0 = ledbench_nsecs();
+            ledbench_run(secs);
+            uint64_t dt = ledbench_nsecs() - t0;
+            computed = leds_frames_computed - computed;
+            sent = leds_frames_sent - sent;
+            dark = ledbench_dark_csecs - dark;
+            idle = ledbench_idle_csecs - idle;
+            double uacsecs = (leds_charge_used.uah - used.uah) * (double) LEDS_UACSECS_PER_UAH
+                             + leds_charge_used.uacsecs - used.uacsecs;
+
+            printf("%5u  0x%04x  %5u  %10.1f  %6.1f  %11.0f  %6.1f  %6.1f  %6.2f  %9.0f\n",
+                   leds_brightness_level, leds_brightness, speed,
+                   (double) computed / secs, (double) sent / secs,
+                   (double) sent * LEDBENCH_BYTES_PER_FRAME / secs,
+                   dark / (double) secs, idle / (double) secs,
+                   uacsecs / (secs * 100.0) / 1000, (double) dt / secs);
+        }
+    }
+
+    printf("\nfade engine, 16 channels fading: %.1f host ns/tick\n",
+           ledbench_fade_nsecs(secs * 100));
+
+    return 0;
+}
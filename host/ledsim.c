@@ -0,0 +1,426 @@
+/// Watch, check, and time the badge's LED engine on Linux.
+/**
+ ** usage: ledsim [-v] [-r] [-t] [scenario...]
+ **        ledsim -c|-u [golden file]
+ **
+ ** Runs leds.c, animations.c and eyes.c, built unmodified against the
+ ** stand-ins in hw.c, through named scenarios: each animation, the scanner
+ ** at each speed, a boop, and so on (run with no arguments for the list).
+ ** Every grayscale frame the LED code hands the driver is recorded with the
+ ** timestep it was sent on.
+ **
+ **  -v  draws each frame as the eyes would look, in ASCII 7-segment art
+ **  -r  prints each frame's tick and 16 grayscale values, for diffing
+ **  -t  times each scenario, in host nanoseconds per call to leds_timestep()
+ **      (the best of several runs, and including the clock reads)
+ **  -c  checks every scenario's frames against the golden file (default
+ **      golden.txt), and exits nonzero if any have changed
+ **  -u  rewrites the golden file from the current LED code
+ **
+ ** The golden file holds a frame count and a hash of every frame (and its
+ ** tick) for each scenario, rather than whole traces. When -c finds a
+ ** change, compare the -r output from before and after to see what it is.
+ **
+ ** Each scenario runs in its own process, so that each starts from the LED
+ ** code's power-on state.
+ **
+ ** \file ledsim.c
+ ** \author George Louthan
+ ** \date   2023
+ ** \copyright (c) 2023 George Louthan @duplico. MIT License.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "badge.h"
+#include "leds.h"
+#include "animations.h"
+#include "tlc5948a.h"
+#include "rng.h"
+#include "hw.h"
+
+/// Give up on a scenario settling after this many timesteps.
+#define LEDSIM_MAX_TICKS 60000
+/// Timesteps to let the eyes sit after a scenario settles.
+#define LEDSIM_TAIL_TICKS 10
+/// How many times -t runs each scenario.
+#define LEDSIM_TIMING_RUNS 20
+
+/// A named thing for the LEDs to do.
+typedef struct {
+    const char *name;
+    /// Called once after leds_init(), to kick the scenario off.
+    void (*start)(uint16_t arg);
+    uint16_t arg;
+    /// Timesteps to run, or 0 to run until leds_next_deadline() says done.
+    uint32_t ticks;
+} ledsim_scenario_t;
+
+/// The timestep being run.
+uint32_t ledsim_tick = 0;
+/// Frames sent so far in this scenario.
+uint32_t ledsim_frames = 0;
+/// FNV-1a hash of every frame so far, and the tick it was sent on.
+uint32_t ledsim_hash = 2166136261u;
+/// Host nanoseconds spent in leds_timestep() in this scenario.
+double ledsim_nsecs = 0;
+/// Whether to draw (-v) or print (-r) each frame as it's sent.
+uint8_t ledsim_draw = 0;
+uint8_t ledsim_raw = 0;
+
+void ledsim_hash_bytes(const void *data, size_t len) {
+    const uint8_t *bytes = data;
+
+    for (size_t i=0; i<len; i++) {
+        ledsim_hash = (ledsim_hash ^ bytes[i]) * 16777619u;
+    }
+}
+
+/// A segment's character: itself if lit, '.' if partway, ' ' if dark.
+char ledsim_seg(uint16_t gs, char lit) {
+    if (!gs) {
+        return ' ';
+    }
+    return gs >= leds_brightness / 2 ? lit : '.';
+}
+
+/// Draw both eyes, in the layout from eyes.h.
+/**
+ **        4 (dot)
+ **   0 5
+ **  1 3 6
+ **   2 7
+ */
+void ledsim_draw_frame() {
+    char rows[3][32];
+
+    for (uint8_t row=0; row<3; row++) {
+        char *p = rows[row];
+
+        for (uint8_t eye=0; eye<2; eye++) {
+            uint16_t *gs = &tlc_gs_data[eye*8];
+
+            if (row == 0) {
+                p += sprintf(p, " %c%c %c%c %c  ",
+                             ledsim_seg(gs[0], '-'), ledsim_seg(gs[0], '-'),
+                             ledsim_seg(gs[5], '-'), ledsim_seg(gs[5], '-'),
+                             ledsim_seg(gs[4], 'o'));
+            } else if (row == 1) {
+                p += sprintf(p, "%c  %c  %c   ",
+                             ledsim_seg(gs[1], '|'), ledsim_seg(gs[3], '|'),
+                             ledsim_seg(gs[6], '|'));
+            } else {
+                p += sprintf(p, " %c%c %c%c    ",
+                             ledsim_seg(gs[2], '-'), ledsim_seg(gs[2], '-'),
+                             ledsim_seg(gs[7], '-'), ledsim_seg(gs[7], '-'));
+            }
+        }
+    }
+
+    printf("tick %u\n%s\n%s\n%s\n\n", ledsim_tick, rows[0], rows[1], rows[2]);
+}
+
+/// hw_led_frame_cb: record a frame.
+void ledsim_frame() {
+    ledsim_frames++;
+    ledsim_hash_bytes(&ledsim_tick, sizeof(ledsim_tick));
+    ledsim_hash_bytes(tlc_gs_data, sizeof(tlc_gs_data));
+
+    if (ledsim_raw) {
+        printf("%6u", ledsim_tick);
+        for (uint8_t i=0; i<16; i++) {
+            printf(" %04x", tlc_gs_data[i]);
+        }
+        printf("\n");
+    }
+    if (ledsim_draw) {
+        ledsim_draw_frame();
+    }
+}
+
+// Scenario starters.
+
+void ledsim_start_nothing(uint16_t arg) {
+}
+
+void ledsim_start_anim(uint16_t index) {
+    eye_anim_t *all[] = {
+        anim_shifty, anim_dafuq, anim_happytoggle, anim_happywink, anim_wink,
+        anim_dirshifty, anim_lookaround, anim_boop, anim_new_badge,
+        anim_seen_badge,
+    };
+
+    leds_anim_start(all[index], 1);
+}
+
+void ledsim_start_scan(uint16_t speed) {
+    leds_scan_speed = speed;
+}
+
+void ledsim_start_boop(uint16_t arg) {
+    leds_boop();
+}
+
+void ledsim_start_number(uint16_t number) {
+    leds_show_number(number, 300);
+}
+
+void ledsim_start_brightness(uint16_t arg) {
+    leds_next_brightness();
+}
+
+void ledsim_start_budget(uint16_t number) {
+    // Every segment lit at the top brightness is well over the budget.
+    leds_set_brightness(BADGE_BRIGHTNESS_2);
+    leds_show_number(number, 300);
+}
+
+void ledsim_start_blink(uint16_t arg) {
+    // The same draws every run, whatever ran before.
+    rng_x = 1;
+    rng_y = 1;
+    rng_stir(arg);
+    leds_blink_or_bling();
+}
+
+const ledsim_scenario_t ledsim_scenarios[] = {
+    {"boot", ledsim_start_nothing, 0, 0},
+    {"anim_shifty", ledsim_start_anim, 0, 0},
+    {"anim_dafuq", ledsim_start_anim, 1, 0},
+    {"anim_happytoggle", ledsim_start_anim, 2, 0},
+    {"anim_happywink", ledsim_start_anim, 3, 0},
+    {"anim_wink", ledsim_start_anim, 4, 0},
+    {"anim_dirshifty", ledsim_start_anim, 5, 0},
+    {"anim_lookaround", ledsim_start_anim, 6, 0},
+    {"anim_boop", ledsim_start_anim, 7, 0},
+    {"anim_new_badge", ledsim_start_anim, 8, 0},
+    {"anim_seen_badge", ledsim_start_anim, 9, 0},
+    {"scan_8", ledsim_start_scan, 8, 500},
+    {"scan_16", ledsim_start_scan, 16, 500},
+    {"scan_24", ledsim_start_scan, 24, 500},
+    {"scan_32", ledsim_start_scan, 32, 500},
+    {"scan_40", ledsim_start_scan, 40, 500},
+    {"scan_48", ledsim_start_scan, 48, 500},
+    {"scan_56", ledsim_start_scan, 56, 500},
+    {"scan_64", ledsim_start_scan, 64, 500},
+    {"scan_72", ledsim_start_scan, 72, 500},
+    {"scan_80", ledsim_start_scan, 80, 500},
+    {"boop", ledsim_start_boop, 0, 0},
+    {"number", ledsim_start_number, 42, 0},
+    {"brightness", ledsim_start_brightness, 0, 0},
+    {"blink", ledsim_start_blink, 2, 0},
+    {"budget", ledsim_start_budget, 88, 0},
+};
+#define LEDSIM_SCENARIO_COUNT (sizeof(ledsim_scenarios) / sizeof(ledsim_scenarios[0]))
+
+/// Run a scenario from power-on. Returns the number of timesteps it took.
+uint32_t ledsim_run(const ledsim_scenario_t *scenario) {
+    uint32_t tail = LEDSIM_TAIL_TICKS;
+    struct timespec t0, t1;
+
+    hw_init();
+    hw_led_frame_cb = ledsim_frame;
+    badge_conf.bootstrapped = 1;
+    ledsim_tick = 0;
+    leds_init();
+    leds_fade_ticks = LEDS_FADE_TICKS;
+    scenario->start(scenario->arg);
+
+    for (ledsim_tick=1; ledsim_tick<=LEDSIM_MAX_TICKS; ledsim_tick++) {
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        leds_timestep();
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        ledsim_nsecs += (t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec);
+
+        if (scenario->ticks) {
+            if (ledsim_tick == scenario->ticks) {
+                break;
+            }
+        } else if (leds_next_deadline() == LEDS_DEADLINE_NONE && !tail--) {
+            break;
+        }
+    }
+
+    return ledsim_tick;
+}
+
+/// Run a scenario in a child process, and read back its frame count and hash.
+/**
+ ** \return 0 on success, or -1 if the child failed.
+ */
+int ledsim_run_isolated(const ledsim_scenario_t *scenario, uint32_t *frames, uint32_t *hash, double *nsecs_per_tick) {
+    int fds[2];
+    pid_t pid;
+    int status;
+    double result[3];
+
+    if (pipe(fds)) {
+        return -1;
+    }
+    fflush(stdout);
+    pid = fork();
+    if (pid < 0) {
+        return -1;
+    }
+    if (!pid) {
+        close(fds[0]);
+        uint32_t ticks = ledsim_run(scenario);
+        fflush(stdout);
+
+        result[0] = ledsim_frames;
+        result[1] = ledsim_hash;
+        result[2] = ledsim_nsecs / ticks;
+        _exit(write(fds[1], result, sizeof(result)) != sizeof(result));
+    }
+
+    close(fds[1]);
+    ssize_t got = read(fds[0], result, sizeof(result));
+    close(fds[0]);
+    waitpid(pid, &status, 0);
+    if (got != sizeof(result) || !WIFEXITED(status) || WEXITSTATUS(status)) {
+        return -1;
+    }
+
+    *frames = result[0];
+    *hash = result[1];
+    *nsecs_per_tick = result[2];
+    return 0;
+}
+
+const ledsim_scenario_t *ledsim_find(const char *name) {
+    for (uint8_t i=0; i<LEDSIM_SCENARIO_COUNT; i++) {
+        if (!strcmp(ledsim_scenarios[i].name, name)) {
+            return &ledsim_scenarios[i];
+        }
+    }
+    return 0;
+}
+
+/// Check (or with `update`, rewrite) the golden file. Returns the exit code.
+int ledsim_golden(const char *path, uint8_t update) {
+    FILE *golden = fopen(path, update ? "w" : "r");
+    int changed = 0;
+
+    if (!golden) {
+        perror(path);
+        return 2;
+    }
+
+    for (uint8_t i=0; i<LEDSIM_SCENARIO_COUNT; i++) {
+        const ledsim_scenario_t *scenario = &ledsim_scenarios[i];
+        uint32_t frames, hash;
+        double nsecs;
+
+        if (ledsim_run_isolated(scenario, &frames, &hash, &nsecs)) {
+            fprintf(stderr, "%s: failed\n", scenario->name);
+            return 2;
+        }
+
+        if (update) {
+            fprintf(golden, "%s %u %08x\n", scenario->name, frames, hash);
+            continue;
+        }
+
+        char name[32];
+        uint32_t want_frames, want_hash;
+        if (fscanf(golden, "%31s %u %x", name, &want_frames, &want_hash) != 3 || strcmp(name, scenario->name)) {
+            fprintf(stderr, "%s: not in %s; run with -u\n", scenario->name, path);
+            return 2;
+        }
+        if (frames != want_frames || hash != want_hash) {
+            printf("%-18s CHANGED: %u frames (was %u)\n", scenario->name, frames, want_frames);
+            changed = 1;
+        } else {
+            printf("%-18s ok\n", scenario->name);
+        }
+    }
+
+    fclose(golden);
+    return changed;
+}
+
+int main(int argc, char *argv[]) {
+    uint8_t timing = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "vrtcu")) != -1) {
+        switch (opt) {
+        case 'v':
+            ledsim_draw = 1;
+            break;
+        case 'r':
+            ledsim_raw = 1;
+            break;
+        case 't':
+            timing = 1;
+            break;
+        case 'c':
+        case 'u':
+            return ledsim_golden(optind < argc ? argv[optind] : "golden.txt", opt == 'u');
+        default:
+            fprintf(stderr, "usage: %s [-v] [-r] [-t] [scenario...]\n"
+                            "       %s -c|-u [golden file]\n", argv[0], argv[0]);
+            return 2;
+        }
+    }
+
+    if (optind == argc && !timing) {
+        printf("scenarios:");
+        for (uint8_t i=0; i<LEDSIM_SCENARIO_COUNT; i++) {
+            printf(" %s", ledsim_scenarios[i].name);
+        }
+        printf("\n");
+        return 0;
+    }
+
+    if (timing) {
+        printf("scenario            frames  host ns/tick\n");
+    }
+    for (uint8_t i=0; i<LEDSIM_SCENARIO_COUNT; i++) {
+        const ledsim_scenario_t *scenario = &ledsim_scenarios[i];
+        uint8_t wanted = optind == argc;
+
+        for (int a=optind; a<argc; a++) {
+            if (!ledsim_find(argv[a])) {
+                fprintf(stderr, "no scenario %s\n", argv[a]);
+                return 2;
+            }
+            wanted |= !strcmp(argv[a], scenario->name);
+        }
+        if (!wanted) {
+            continue;
+        }
+
+        if (!timing) {
+            ledsim_run(scenario);
+            continue;
+        }
+
+        uint32_t frames, hash;
+        double nsecs, best = 0;
+        uint8_t draw = ledsim_draw, raw = ledsim_raw;
+
+        // Best of several runs, without printing the frames each time.
+        ledsim_draw = ledsim_raw = 0;
+        for (uint8_t run=0; run<LEDSIM_TIMING_RUNS; run++) {
+            if (ledsim_run_isolated(scenario, &frames, &hash, &nsecs)) {
+                fprintf(stderr, "%s: failed\n", scenario->name);
+                return 2;
+            }
+            if (!run || nsecs < best) {
+                best = nsecs;
+            }
+        }
+        ledsim_draw = draw;
+        ledsim_raw = raw;
+        printf("%-18s  %6u  %12.1f\n", scenario->name, frames, best);
+    }
+
+    return 0;
+}
@@ -0,0 +1,488 @@
+/// Replay a radio capture through the badge's application code, on Linux.
+/**
+ ** usage: replay [-v] [-c] [-q] [-i badge_id] [-f home_channel] [-n badges_seen] capture
+ **
+ ** A capture is just what a RADIO_SNIFFER badge streams out its serial
+ ** port (see sniffer.c), saved to a file, e.g. with sniff_decode.py --save.
+ ** Every record carries the payload as the radio received it, the channel
+ ** it was heard on, and when, in centiseconds.
+ **
+ ** The replay runs radio.c, badge.c, and leds.c, built unmodified against
+ ** the stand-ins in hw.c, on a simulated clock. The RTC counts every
+ ** centisecond of the capture, and whenever it interrupts, or a record
+ ** arrives, or a transmission finishes, the badge wakes up and we do what
+ ** the main loop would do; a record's payload goes to radio_rx_done(). So
+ ** a replay runs the same way every time, and as fast as the host can go.
+ **
+ ** It also counts how many times the badge woke up, and which low-power
+ ** mode it slept in between (LPM3 only while the LEDs are dark, like
+ ** main_sleep_bits(), which they never are in the sample captures), and
+ ** estimates what the MCU draws on average from
+ ** that (see REPLAY_AWAKE_USECS). It counts the changes to the persistent
+ ** settings and the commits that saved them, and estimates how long that
+ ** kept interrupts off (see REPLAY_COMMIT_CYCLES).
+ **
+ ** With -c, only records heard on the channel the replaying badge is tuned
+ ** to at that moment are delivered. With -v, every packet is printed along
+ ** with the neighbor count and LED state after it's been handled. With -n,
+ ** the badge boots having seen that many badges, so it counts them up on
+ ** its eyes first, like main() does; either way, it reports how long after
+ ** boot its first beacon went out. With -q, the host timings are left out,
+ ** so the output is the same on every host; make check compares it against
+ ** replay_golden.txt.
+ **
+ ** \file replay.c
+ ** \author George Louthan
+ ** \date   2023
+ ** \copyright (c) 2023 George Louthan @duplico. MIT License.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "badge.h"
+#include "radio.h"
+#include "rtc.h"
+#include "leds.h"
+#include "tlc5948a.h"
+#include "sniffer.h"
+#include "timer.h"
+#include "event.h"
+#include "persist.h"
+#include "enclog.h"
+#include "hw.h"
+
+/// Centiseconds to run before the first record, so the badge can settle.
+#define REPLAY_PREROLL_CSECS 100
+
+// The current estimate is from the MSP430FR2633 datasheet's typical
+//  figures at 3 V, and a guess at how long each wakeup keeps the CPU on.
+/// Estimated microseconds the CPU is awake for each wakeup.
+#define REPLAY_AWAKE_USECS 100
+/// Active mode at 8 MHz: 126 uA/MHz.
+#define REPLAY_ACTIVE_UA 1008
+/// LPM0, with SMCLK still running at 8 MHz.
+#define REPLAY_LPM0_UA 342
+/// LPM3 with the RTC counting: about 1 uA, plus 15 uA for REFO.
+#define REPLAY_LPM3_UA 16
+/// Touch scans per minute, at CapTIvate's 33 ms active scan period.
+#define REPLAY_TOUCH_SCANS_PER_MIN 1818
+// These are guesses from the code, not measurements.
+/// Estimated MCLK cycles a commit has interrupts off: unlocking and locking INFOA.
+#define REPLAY_COMMIT_CYCLES 16
+/// Estimated MCLK cycles for the old in-place writes, e.g. marking a badge seen.
+#define REPLAY_FRAM_WRITE_CYCLES 60
+
+extern uint8_t radio_badges_in_range;
+extern uint8_t radio_channel;
+void badge_init();
+
+/// One record of a capture.
+typedef struct {
+    uint32_t csecs;
+    uint8_t channel;
+    uint8_t pipe;
+    uint8_t len;
+    uint8_t payload[255];
+} replay_record_t;
+
+replay_record_t *replay_records;
+uint32_t replay_record_count = 0;
+
+/// Read every good record in the capture at `path` into replay_records.
+int replay_load(const char *path) {
+    FILE *f = fopen(path, "rb");
+    uint32_t skipped = 0;
+    uint32_t alloc = 1024;
+    int c;
+
+    if (!f) {
+        perror(path);
+        return 0;
+    }
+    replay_records = malloc(alloc * sizeof(replay_record_t));
+
+    while ((c = fgetc(f)) != EOF) {
+        uint8_t buf[255 + SNIFFER_RECORD_OVERHEAD];
+        uint8_t sum = 0;
+        long start = ftell(f);
+
+        if (c != SNIFFER_SYNC) {
+            skipped++;
+            continue;
+        }
+        if ((c = fgetc(f)) == EOF) {
+            break;
+        }
+        buf[0] = c;
+        if (fread(&buf[1], 1, buf[0] + SNIFFER_RECORD_OVERHEAD - 2, f) != buf[0] + SNIFFER_RECORD_OVERHEAD - 2) {
+            break;
+        }
+        for (uint16_t i=0; i<buf[0] + SNIFFER_RECORD_OVERHEAD - 1; i++) {
+            sum += buf[i];
+        }
+        if (sum) {
+            // Not really a record. Resync just after the false 0xA5.
+            skipped++;
+            fseek(f, start, SEEK_SET);
+            continue;
+        }
+
+        if (replay_record_count == alloc) {
+            alloc *= 2;
+            replay_records = realloc(replay_records, alloc * sizeof(replay_record_t));
+        }
+        replay_record_t *r = &replay_records[replay_record_count++];
+        r->len = buf[0];
+        r->csecs = buf[1] | (buf[2] << 8) | ((uint32_t) buf[3] << 16) | ((uint32_t) buf[4] << 24);
+        r->channel = buf[5];
+        r->pipe = buf[6];
+        memcpy(r->payload, &buf[8], r->len);
+    }
+
+    fclose(f);
+    if (skipped) {
+        fprintf(stderr, "Skipped %u bytes of garbage in the capture.\n", skipped);
+    }
+    return 1;
+}
+
+/// Beacon tick, like main.c's my_beacon_tick.
+uint8_t my_beacon_tick;
+/// Ticks from boot to our first beacon, or 0 until it's gone out.
+uint32_t replay_first_beacon = 0;
+/// Signal to send a beacon, like main.c's s_beacon.
+uint8_t s_beacon = 0;
+/// Ticks the LEDs and radio have been caught up to, like main_catch_up()'s.
+uint32_t ticks_done = 0;
+/// Like main.c's wake-only timers.
+sw_timer_t leds_wake, radio_wake, second_wake, beacon_wake;
+/// Times the badge has woken up.
+uint32_t replay_wakes = 0;
+/// Centiseconds the badge has spent asleep in LPM3.
+uint32_t replay_lpm3_csecs = 0;
+/// Names of the event types, for the timings.
+const char *replay_event_names[EVENT_COUNT] = {"radio", "sniff", "touch", "tick", "second"};
+
+/// Like main_catch_up().
+void replay_catch_up() {
+    uint32_t now;
+
+    rtc_catch_up();
+    now = rtc_get_ticks();
+    timer_catch_up(now - ticks_done, leds_next_deadline, leds_skip,
+                   badge_conf.bootstrapped ? leds_timestep : leds_fade_timestep);
+    timer_catch_up(now - ticks_done, radio_next_deadline, radio_skip,
+                   radio_timestep);
+    ticks_done = now;
+}
+
+/// Wake the badge up and do one pass of the main loop, delivering `r` if given.
+void replay_wake(replay_record_t *r) {
+    uint8_t event;
+
+    replay_wakes++;
+    // The radio's IRQ: a packet, or the end of a transmission.
+    if (r || hw_tx_pending) {
+        event_post(EVENT_RADIO);
+    }
+
+    while ((event = event_next()) != EVENT_NONE) {
+        replay_catch_up();
+
+        switch (event) {
+        case EVENT_RADIO:
+            if (r) {
+                radio_rx_done(r->payload, r->len, r->pipe);
+            } else {
+                hw_radio_step();
+            }
+            break;
+        case EVENT_TICK:
+            timer_run();
+            break;
+        case EVENT_SECOND:
+            radio_second();
+
+            if (rtc_seconds % RADIO_BEACON_INTERVAL_SECS == my_beacon_tick) {
+                s_beacon = 1;
+            }
+            break;
+        }
+
+        event_done(event);
+    }
+
+    if (s_beacon && rfm75_tx_avail()) {
+        uint8_t wait = radio_tx_slot_wait();
+
+        if (wait) {
+            timer_start(&beacon_wake, wait);
+        } else {
+            s_beacon = 0;
+            radio_interval();
+            if (!replay_first_beacon) {
+                replay_first_beacon = rtc_get_ticks();
+            }
+        }
+    }
+
+    if (s_boop_radio && rfm75_tx_avail()) {
+        s_boop_radio = 0;
+        radio_boop(badge_conf.badge_id, BADGE_BOOP_RADIO_HOPS);
+    }
+
+    persist_idle();
+
+    // Like main_schedule().
+    replay_catch_up();
+    timer_start(&leds_wake, leds_next_deadline());
+    timer_start(&radio_wake, radio_next_deadline());
+    timer_start(&second_wake, radio_next_second() * 100 - rtc_centiseconds);
+    rtc_set_wake(timer_next());
+}
+
+/// Run one centisecond of the badge, waking it if the RTC or radio interrupts.
+void replay_csec() {
+    // It went to sleep in whichever mode main_sleep_bits() would've chosen.
+    if (tlc_dark && tlc_send_type == TLC_SEND_IDLE) {
+        replay_lpm3_csecs++;
+    }
+
+    // A transmission finishes the tick after it starts.
+    if (hw_rtc_step() || hw_tx_pending) {
+        replay_wake(0);
+    }
+}
+
+/// Write the LED state as two eyes of '#' (on), 'o' (dimmed), and '.' (off).
+void replay_leds(char *out) {
+    for (uint8_t i=0; i<16; i++) {
+        if (!tlc_gs_data[i]) {
+            *out++ = '.';
+        } else if (tlc_gs_data[i] < leds_brightness) {
+            *out++ = 'o';
+        } else {
+            *out++ = '#';
+        }
+        if (i == 7) {
+            *out++ = '|';
+        }
+    }
+    *out = 0;
+}
+
+/// Nanoseconds on the host's monotonic clock.
+uint64_t replay_nsecs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+int main(int argc, char *argv[]) {
+    int badge_id = 0;
+    int home = -1;
+    int verbose = 0;
+    int tuned_only = 0;
+    int quiet = 0;
+    int seen = 1;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "vcqi:f:n:")) != -1) {
+        switch (opt) {
+        case 'v':
+            verbose = 1;
+            break;
+        case 'c':
+            tuned_only = 1;
+            break;
+        case 'q':
+            quiet = 1;
+            break;
+        case 'i':
+            badge_id = atoi(optarg);
+            break;
+        case 'f':
+            home = atoi(optarg);
+            break;
+        case 'n':
+            seen = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-v] [-c] [-q] [-i badge_id] [-f home_channel] [-n badges_seen] capture\n", argv[0]);
+            return 2;
+        }
+    }
+    if (optind != argc - 1 || !replay_load(argv[optind])) {
+        fprintf(stderr, "usage: %s [-v] [-c] [-q] [-i badge_id] [-f home_channel] [-n badges_seen] capture\n", argv[0]);
+        return 2;
+    }
+    if (!replay_record_count) {
+        fprintf(stderr, "No records in the capture.\n");
+        return 1;
+    }
+
+    // Boot a badge that's been set up, and has already found its channel.
+    hw_init();
+    event_init();
+    persist_init();
+    enclog_init();
+    badge_conf.badge_id = badge_id;
+    badge_conf.bootstrapped = 1;
+    badge_conf.badges_seen_count = seen;
+    radio_frequency = home < 0 ? replay_records[0].channel : home;
+    radio_frequency_done = 1;
+    badge_init();
+    leds_init();
+    leds_fade_ticks = LEDS_FADE_TICKS;
+    rtc_init();
+    radio_init(badge_conf.badge_id);
+    my_beacon_tick = badge_conf.badge_id % RADIO_BEACON_INTERVAL_SECS;
+    badge_count_start();
+
+    uint32_t first = replay_records[0].csecs;
+    uint32_t now = 0;
+    uint32_t delivered = 0;
+    uint8_t nbrs_min = 0xff;
+    uint8_t nbrs_max = 0;
+    uint64_t rx_nsecs = 0;
+    uint64_t rx_nsecs_max = 0;
+    uint64_t tick_nsecs = 0;
+    hw_counts_t rx_counts = {0, };
+    char leds[20];
+
+    for (uint32_t i=0; i<replay_record_count; i++) {
+        replay_record_t *r = &replay_records[i];
+        uint32_t due = REPLAY_PREROLL_CSECS + r->csecs - first;
+        uint64_t t0;
+
+        t0 = replay_nsecs();
+        while (now < due) {
+            replay_csec();
+            now++;
+        }
+        tick_nsecs += replay_nsecs() - t0;
+
+        if (tuned_only && r->channel != radio_channel) {
+            continue;
+        }
+
+        hw_counts_t before = hw_counts;
+        t0 = replay_nsecs();
+        replay_wake(r);
+        uint64_t dt = replay_nsecs() - t0;
+        rx_nsecs += dt;
+        if (dt > rx_nsecs_max) {
+            rx_nsecs_max = dt;
+        }
+        rx_counts.radio_regs += hw_counts.radio_regs - before.radio_regs;
+        rx_counts.radio_tx += hw_counts.radio_tx - before.radio_tx;
+        rx_counts.led_frames += hw_counts.led_frames - before.led_frames;
+        rx_counts.fram_writes += hw_counts.fram_writes - before.fram_writes;
+        delivered++;
+
+        if (radio_badges_in_range < nbrs_min) {
+            nbrs_min = radio_badges_in_range;
+        }
+        if (radio_badges_in_range > nbrs_max) {
+            nbrs_max = radio_badges_in_range;
+        }
+
+        if (verbose) {
+            radio_proto_t *msg = (radio_proto_t *) r->payload;
+            replay_leds(leds);
+            printf("%8.2f ch %3u  id %3u type %u payload %3u  nbrs %3u  leds %s\n",
+                   (r->csecs - first) / 100.0, r->channel,
+                   r->len == sizeof(radio_proto_t) ? msg->badge_id : 0xffff,
+                   r->len == sizeof(radio_proto_t) ? msg->msg_type : 0,
+                   r->len == sizeof(radio_proto_t) ? msg->msg_payload : 0,
+                   radio_badges_in_range, leds);
+        }
+    }
+
+    replay_leds(leds);
+    printf("Replayed %u of %u records over %.2f s of capture.\n",
+           delivered, replay_record_count, (now - REPLAY_PREROLL_CSECS) / 100.0);
+    printf("Neighbors: %u at the end, between %u and %u; %u badges seen in all.\n",
+           radio_badges_in_range, nbrs_min == 0xff ? 0 : nbrs_min, nbrs_max,
+           badge_conf.badges_seen_count);
+    printf("LEDs at the end: %s (brightness 0x%04x, scan speed %u)\n",
+           leds, leds_brightness, leds_scan_speed);
+    printf("LED charge: %.3f mAh estimated, of %.3f mAh budgeted; %u of %u frames limited.\n",
+           leds_charge_used.uah / 1000.0, leds_charge_budget.uah / 1000.0,
+           leds_frames_limited, leds_frames_computed);
+    printf("Transmitted %u packets; LED frames sent %u; FRAM writes %u.\n",
+           hw_counts.radio_tx, hw_counts.led_frames, hw_counts.fram_writes);
+    if (delivered) {
+        if (!quiet) {
+            printf("Per packet: %.0f ns average, %llu ns max on this host; ",
+                   (double) rx_nsecs / delivered, (unsigned long long) rx_nsecs_max);
+        } else {
+            printf("Per packet: ");
+        }
+        printf("%.2f radio register ops, %.2f LED frames, %.2f FRAM writes, %.3f transmits.\n",
+               (double) rx_counts.radio_regs / delivered,
+               (double) rx_counts.led_frames / delivered,
+               (double) rx_counts.fram_writes / delivered,
+               (double) rx_counts.radio_tx / delivered);
+    }
+    if (now > REPLAY_PREROLL_CSECS) {
+        // Wakeups for LED timesteps, radio housekeeping, and packets; the
+        //  touch scans are separate, and the same either way.
+        double minutes = (now - REPLAY_PREROLL_CSECS) / 6000.0;
+        double per_min = replay_wakes / minutes;
+        double lpm3 = (double) replay_lpm3_csecs / now;
+        double asleep_ua = REPLAY_LPM3_UA * lpm3 + REPLAY_LPM0_UA * (1 - lpm3);
+        double ua = asleep_ua + (REPLAY_ACTIVE_UA - asleep_ua) *
+                (per_min + REPLAY_TOUCH_SCANS_PER_MIN) * REPLAY_AWAKE_USECS / 60e6;
+        double ua_100hz = REPLAY_LPM0_UA + (REPLAY_ACTIVE_UA - REPLAY_LPM0_UA) *
+                (6000 + delivered / minutes + REPLAY_TOUCH_SCANS_PER_MIN) * REPLAY_AWAKE_USECS / 60e6;
+
+        printf("Wakeups: %.0f per minute, plus %u touch scans (vs %.0f at a fixed 100 Hz).\n",
+               per_min, REPLAY_TOUCH_SCANS_PER_MIN, 6000 + delivered / minutes);
+        printf("Asleep: %.1f%% of the time in LPM3 (only while the LEDs are dark), "
+               "the rest in LPM0.\n",
+               100 * lpm3);
+        printf("MCU current: %.0f uA average, estimated (vs %.0f uA at 100 Hz in LPM0), "
+               "at %u us awake per wakeup.\n", ua, ua_100hz, REPLAY_AWAKE_USECS);
+        printf("Settings: %u changes saved in %u commits; interrupts off %.2f ms per hour "
+               "for FRAM, estimated (vs %.2f ms writing each change in place).\n",
+               persist_stats.changes, persist_stats.commits,
+               persist_stats.commits * REPLAY_COMMIT_CYCLES / (MCLK_FREQ_MHZ * 1e3) / (minutes / 60),
+               persist_stats.changes * REPLAY_FRAM_WRITE_CYCLES / (MCLK_FREQ_MHZ * 1e3) / (minutes / 60));
+    }
+    if (replay_first_beacon) {
+        // main() used to count up our badges with delay_millis() before it
+        //  even started the RTC or the radio.
+        double blocked = seen > 1 ? ((seen < 100 ? seen : 100) + 1) * 0.08 + 6.0 : 0.0;
+
+        printf("First beacon: %.2f s after boot (vs %.2f s with the old blocking count-up).\n",
+               replay_first_beacon / 100.0, replay_first_beacon / 100.0 + blocked);
+    }
+    printf("Events: %u radio, %u ticks, %u seconds handled (%u, %u, %u merged while pending).\n",
+           event_stats[EVENT_RADIO].queued, event_stats[EVENT_TICK].queued,
+           event_stats[EVENT_SECOND].queued, event_stats[EVENT_RADIO].merged,
+           event_stats[EVENT_TICK].merged, event_stats[EVENT_SECOND].merged);
+    if (!quiet) {
+        printf("Per simulated csec: %.0f ns on this host (%.0fx real time overall).\n",
+               now ? (double) tick_nsecs / now : 0.0,
+               (tick_nsecs + rx_nsecs) ? now * 1e7 / (tick_nsecs + rx_nsecs) : 0.0);
+        printf("Handler run times on this host, us (max; then counts under 1, 1, 2, 4, ... 16384 and up):\n");
+        for (uint8_t e=0; e<EVENT_COUNT; e++) {
+            if (!event_stats[e].queued) {
+                continue;
+            }
+            printf("  %-6s %5u;", replay_event_names[e], event_stats[e].run_max);
+            for (uint8_t b=0; b<EVENT_HIST_BUCKETS; b++) {
+                printf(" %u", event_stats[e].run_hist[b]);
+            }
+            printf("\n");
+        }
+    }
+
+    return 0;
+}
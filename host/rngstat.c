@@ -0,0 +1,341 @@
+/// Check the badge's random number generator, on Linux.
+/**
+ ** usage: rngstat [-p] [draws]
+ **
+ ** Runs rng.c, built unmodified against the stand-ins in hw.c, and the
+ ** rand() % n the badge used to use, side by side. For rand(), that's the
+ ** sample implementation in the C standard, which is the usual one for a
+ ** 16-bit target like TI's, rather than whatever this host's is.
+ **
+ ** It reports:
+ **
+ **  - the worst bias of any one bit of rng_next(), over the draws (default
+ **    2^20), against what chance alone would give;
+ **  - a chi-square of rng_below(n) and of rand() % n, for every n the badge
+ **    draws with;
+ **  - how alike badges' sequences start out: among badges with IDs next to
+ **    each other, how many different steps (difference or XOR) their first
+ **    draws are apart, which is ~BADGES_IN_SYSTEM for unrelated sequences
+ **    and 1 for sequences that are shifted copies of each other; and how
+ **    many pairs of badges would start out with the same 4 blink delays;
+ **  - how many of the old seeds (ID*100 + badges seen) collide;
+ **  - what a draw costs on this host, which is no guide to the MSP430.
+ **
+ ** The host has no noise to harvest: its ACLK doesn't move while the CPU
+ ** spins, and there's no button or radio. So the new badges here are
+ ** stirred with their IDs only, as badge_init() does, which is the worst
+ ** case for the new scheme, and every run gives the same results.
+ **
+ ** With -p, it also steps the generator all the way around, to check its
+ ** period is 2^32 - 1; that takes several seconds.
+ **
+ ** \file rngstat.c
+ ** \author George Louthan
+ ** \date   2023
+ ** \copyright (c) 2023 George Louthan @duplico. MIT License.
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "badge.h"
+#include "radio.h"
+#include "leds.h"
+#include "animations.h"
+#include "eyes.h"
+#include "rng.h"
+#include "hw.h"
+
+/// Draws per badge compared across badges.
+#define RNGSTAT_BADGE_DRAWS 8
+/// Blink delays per badge compared across badges.
+#define RNGSTAT_BADGE_DELAYS 4
+/// Badges seen that every badge in the comparison has, for the old seeds.
+#define RNGSTAT_SEEN 20
+
+/// The old scheme's state.
+uint32_t rngstat_lcg_next = 1;
+
+/// The C standard's sample srand().
+void rngstat_srand(uint32_t seed) {
+    rngstat_lcg_next = seed;
+}
+
+/// The C standard's sample rand(), from 0 to 32767.
+uint16_t rngstat_rand() {
+    rngstat_lcg_next = rngstat_lcg_next * 1103515245 + 12345;
+    return (rngstat_lcg_next / 65536) % 32768;
+}
+
+/// Where rng.c starts out, before anything's stirred in.
+uint16_t rngstat_x0, rngstat_y0;
+
+/// Start the new generator the way a badge with `id` does, minus the noise.
+void rngstat_boot(uint8_t id) {
+    rng_x = rngstat_x0;
+    rng_y = rngstat_y0;
+    rng_stir(id);
+    rng_harvest_clocks(RNG_CLOCK_SAMPLES);
+}
+
+/// Nanoseconds on the host's monotonic clock.
+uint64_t rngstat_nsecs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/// Print the worst bias of any bit of rng_next() over `draws`.
+void rngstat_bits(uint32_t draws) {
+    uint32_t ones[16] = {0};
+    double worst = 0;
+    uint8_t worst_bit = 0;
+
+    rngstat_boot(1);
+    for (uint32_t i=0; i<draws; i++) {
+        uint16_t r = rng_next();
+
+        for (uint8_t b=0; b<16; b++) {
+            ones[b] += (r >> b) & 1;
+        }
+    }
+    for (uint8_t b=0; b<16; b++) {
+        double bias = fabs((double) ones[b] / draws - 0.5);
+
+        if (bias > worst) {
+            worst = bias;
+            worst_bit = b;
+        }
+    }
+    // One standard deviation of a fair bit's share of ones is 0.5/sqrt(n).
+    printf("Bits: worst is bit %u, %.5f off of half, %.2f standard deviations "
+           "over %u draws.\n", worst_bit, worst, worst / (0.5 / sqrt(draws)), draws);
+}
+
+/// Print the chi-square of `draws` of rng_below(n) and of rand() % n.
+void rngstat_chi(const char *what, uint16_t n, uint32_t draws) {
+    uint32_t *new_counts = calloc(n, sizeof(uint32_t));
+    uint32_t *old_counts = calloc(n, sizeof(uint32_t));
+    double expected = (double) draws / n;
+    double new_chi = 0, old_chi = 0;
+
+    rngstat_boot(1);
+    rngstat_srand(1*100 + RNGSTAT_SEEN);
+    for (uint32_t i=0; i<draws; i++) {
+        new_counts[rng_below(n)]++;
+        old_counts[rngstat_rand() % n]++;
+    }
+    for (uint16_t i=0; i<n; i++) {
+        new_chi += (new_counts[i] - expected) * (new_counts[i] - expected) / expected;
+        old_chi += (old_counts[i] - expected) * (old_counts[i] - expected) / expected;
+    }
+    printf("  %-28s n=%3u  rng_below %7.1f  rand() %% n %7.1f  (%u degrees of freedom)\n",
+           what, n, new_chi, old_chi, n - 1);
+    free(new_counts);
+    free(old_counts);
+}
+
+/// Count the different values in `values`, which has `count` in it.
+uint16_t rngstat_distinct(uint16_t *values, uint16_t count) {
+    uint16_t distinct = 0;
+
+    for (uint16_t i=0; i<count; i++) {
+        uint16_t j;
+
+        for (j=0; j<i && values[j] != values[i]; j++);
+        if (j == i) {
+            distinct++;
+        }
+    }
+    return distinct;
+}
+
+/// Fewer of the different differences and XORs between neighbors' draws.
+uint16_t rngstat_steps(uint16_t draws[BADGES_IN_SYSTEM][RNGSTAT_BADGE_DRAWS], uint8_t k) {
+    uint16_t diffs[BADGES_IN_SYSTEM - 1];
+    uint16_t xors[BADGES_IN_SYSTEM - 1];
+    uint16_t d, x;
+
+    for (uint8_t id=0; id<BADGES_IN_SYSTEM - 1; id++) {
+        diffs[id] = draws[id + 1][k] - draws[id][k];
+        xors[id] = draws[id + 1][k] ^ draws[id][k];
+    }
+    d = rngstat_distinct(diffs, BADGES_IN_SYSTEM - 1);
+    x = rngstat_distinct(xors, BADGES_IN_SYSTEM - 1);
+    return d < x ? d : x;
+}
+
+/// Count the pairs of badges whose `delays` all match.
+uint32_t rngstat_same(uint8_t delays[BADGES_IN_SYSTEM][RNGSTAT_BADGE_DELAYS]) {
+    uint32_t same = 0;
+
+    for (uint8_t i=0; i<BADGES_IN_SYSTEM; i++) {
+        for (uint8_t j=i+1; j<BADGES_IN_SYSTEM; j++) {
+            same += !memcmp(delays[i], delays[j], RNGSTAT_BADGE_DELAYS);
+        }
+    }
+    return same;
+}
+
+/// Print how alike badges' sequences are, new and old.
+void rngstat_badges() {
+    static uint16_t new_draws[BADGES_IN_SYSTEM][RNGSTAT_BADGE_DRAWS];
+    static uint16_t old_draws[BADGES_IN_SYSTEM][RNGSTAT_BADGE_DRAWS];
+    static uint8_t new_delays[BADGES_IN_SYSTEM][RNGSTAT_BADGE_DELAYS];
+    static uint8_t old_delays[BADGES_IN_SYSTEM][RNGSTAT_BADGE_DELAYS];
+    uint32_t new_steps = 0, old_steps = 0;
+    uint32_t new_fewest = BADGES_IN_SYSTEM, old_fewest = BADGES_IN_SYSTEM;
+
+    for (uint8_t id=0; id<BADGES_IN_SYSTEM; id++) {
+        rngstat_boot(id);
+        rngstat_srand(id*100 + RNGSTAT_SEEN);
+        for (uint8_t k=0; k<RNGSTAT_BADGE_DRAWS; k++) {
+            new_draws[id][k] = rng_next();
+            old_draws[id][k] = rngstat_rand();
+        }
+
+        rngstat_boot(id);
+        rngstat_srand(id*100 + RNGSTAT_SEEN);
+        for (uint8_t k=0; k<RNGSTAT_BADGE_DELAYS; k++) {
+            new_delays[id][k] = rng_below(BADGE_SECS_PER_BLINK_AVG);
+            old_delays[id][k] = rngstat_rand() % BADGE_SECS_PER_BLINK_AVG;
+        }
+    }
+
+    for (uint8_t k=0; k<RNGSTAT_BADGE_DRAWS; k++) {
+        uint16_t s;
+
+        s = rngstat_steps(new_draws, k);
+        new_steps += s;
+        new_fewest = s < new_fewest ? s : new_fewest;
+        s = rngstat_steps(old_draws, k);
+        old_steps += s;
+        old_fewest = s < old_fewest ? s : old_fewest;
+    }
+
+    printf("Badges: steps between neighbors' first %u draws, of %u pairs "
+           "(average, fewest):\n", RNGSTAT_BADGE_DRAWS, BADGES_IN_SYSTEM - 1);
+    printf("  stirred with ID only  %5.1f %3u\n",
+           (double) new_steps / RNGSTAT_BADGE_DRAWS, new_fewest);
+    printf("  old seed, %2u seen     %5.1f %3u\n", RNGSTAT_SEEN,
+           (double) old_steps / RNGSTAT_BADGE_DRAWS, old_fewest);
+    printf("Badges: pairs with the same first %u blink delays, of %u "
+           "(%.1f expected by chance): new %u, old %u.\n", RNGSTAT_BADGE_DELAYS,
+           BADGES_IN_SYSTEM * (BADGES_IN_SYSTEM - 1) / 2,
+           BADGES_IN_SYSTEM * (BADGES_IN_SYSTEM - 1) / 2 /
+               pow(BADGE_SECS_PER_BLINK_AVG, RNGSTAT_BADGE_DELAYS),
+           rngstat_same(new_delays), rngstat_same(old_delays));
+}
+
+/// Print how many old seeds, over every badge and every count of badges seen, collide.
+void rngstat_seeds() {
+    static uint8_t used[BADGES_IN_SYSTEM * 100 + BADGES_IN_SYSTEM];
+    uint32_t collisions = 0;
+
+    for (uint8_t id=0; id<BADGES_IN_SYSTEM; id++) {
+        for (uint8_t seen=0; seen<BADGES_IN_SYSTEM; seen++) {
+            collisions += used[id*100 + seen]++ != 0;
+        }
+    }
+    printf("Old seeds: %u of %u (ID, badges seen) pairs share a seed with "
+           "another, and so a sequence.\n", collisions,
+           BADGES_IN_SYSTEM * BADGES_IN_SYSTEM);
+}
+
+/// Print what draws cost on this host.
+void rngstat_time(uint32_t draws) {
+    volatile uint16_t sink;
+    uint64_t t0;
+    double next_ns, below_ns, old_ns;
+
+    rngstat_boot(1);
+    t0 = rngstat_nsecs();
+    for (uint32_t i=0; i<draws; i++) {
+        sink = rng_next();
+    }
+    next_ns = (double) (rngstat_nsecs() - t0) / draws;
+
+    t0 = rngstat_nsecs();
+    for (uint32_t i=0; i<draws; i++) {
+        sink = rng_below(BADGE_SECS_PER_BLINK_AVG);
+    }
+    below_ns = (double) (rngstat_nsecs() - t0) / draws;
+
+    t0 = rngstat_nsecs();
+    for (uint32_t i=0; i<draws; i++) {
+        sink = rngstat_rand() % BADGE_SECS_PER_BLINK_AVG;
+    }
+    old_ns = (double) (rngstat_nsecs() - t0) / draws;
+    (void) sink;
+
+    printf("Host time: %.2f ns per rng_next(), %.2f ns per rng_below(%u), "
+           "%.2f ns per rand() %% %u.\n", next_ns, below_ns,
+           BADGE_SECS_PER_BLINK_AVG, old_ns, BADGE_SECS_PER_BLINK_AVG);
+}
+
+/// Step the generator until it comes back around, and print how long that took.
+int rngstat_period() {
+    uint16_t x = rng_x, y = rng_y;
+    uint64_t period = 0;
+
+    do {
+        rng_next();
+        period++;
+    } while ((rng_x != x || rng_y != y) && period <= 0xffffffff);
+
+    printf("Period: %llu (2^32 - 1 is %llu).\n", (unsigned long long) period,
+           0xffffffffULL);
+    return period == 0xffffffff;
+}
+
+int main(int argc, char *argv[]) {
+    uint32_t draws = 1 << 20;
+    int period = 0;
+    int c;
+
+    while ((c = getopt(argc, argv, "p")) != -1) {
+        switch (c) {
+        case 'p':
+            period = 1;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-p] [draws]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (optind < argc) {
+        draws = strtoul(argv[optind], 0, 0);
+    }
+    if (!draws) {
+        fprintf(stderr, "usage: %s [-p] [draws]\n", argv[0]);
+        return 2;
+    }
+
+    hw_init();
+    rngstat_x0 = rng_x;
+    rngstat_y0 = rng_y;
+
+    rngstat_bits(draws);
+    printf("Chi-square, over %u draws each:\n", draws);
+    rngstat_chi("blink delay", BADGE_SECS_PER_BLINK_AVG, draws);
+    rngstat_chi("animation chance", BADGE_ANIM_CHANCE_ONE_IN, draws);
+    rngstat_chi("animation", ANIMATION_COUNT, draws);
+    rngstat_chi("face chance", BADGE_FACE_CHANCE_ONE_IN, draws);
+    rngstat_chi("face", EYES_COUNT, draws);
+    rngstat_chi("boop report jitter", RADIO_BOOP_REPORT_JITTER_CSECS, draws);
+    rngstat_chi("hop offset", 100 - 2*RADIO_HOP_GUARD_CSECS, draws);
+    rngstat_badges();
+    rngstat_seeds();
+    rngstat_time(draws);
+
+    if (period) {
+        rngstat_boot(1);
+        return rngstat_period() ? 0 : 1;
+    }
+    return 0;
+}
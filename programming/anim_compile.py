@@ -0,0 +1,267 @@
+"""Compile eye animations for booper.badge.lgbt into the badge's bytecode.
+
+Reads an animation spec (see ccs_workspace/booper.badge.lgbt/animations.anim)
+and writes animations.c and animations.h next to it, with every animation as
+a const byte table that the linker places in FRAM. leds.c interprets it; the
+opcodes are the ANIM_ defines in leds.h.
+
+    python anim_compile.py ../ccs_workspace/booper.badge.lgbt/animations.anim
+
+The spec is one statement per line, and # starts a comment:
+
+    anim <name> [random]    start an animation; random ones go in animations[]
+    dur <ticks>             show each following frame for this many timesteps
+    show <left> [<right>]   show both eyes (one shape means both the same)
+    left <eye>              change only the left eye
+    right <eye>             change only the right eye
+    toggle <left> <right>   flip these segments of each eye
+    mirror                  flip each eye left-to-right
+    rotate <steps>          turn each eye's outer ring clockwise, 1..5 steps
+    chase                   move every lit segment one step along the
+                            figure-eight around both eyes
+    repeat <count>          play what's up to the matching `next` count times
+    next
+
+Every statement from `show` to `chase` is one frame. An eye is a shape name
+from eyes.h, or a byte with bit 0 for tl, in the order of eye_t's fields.
+"""
+
+import os
+import re
+import sys
+
+import click
+
+# Must match the ANIM_ opcodes in leds.h.
+ANIM_END = 0x00
+ANIM_REPEAT = 0x01
+ANIM_NEXT = 0x02
+ANIM_SHOW = 0x03
+ANIM_BOTH = 0x04
+ANIM_LEFT = 0x05
+ANIM_RIGHT = 0x06
+ANIM_TOGGLE = 0x07
+ANIM_MIRROR = 0x08
+ANIM_CHASE = 0x09
+ANIM_DUR = 0x0a
+ANIM_ROTATE = 0x10
+ANIM_DUR_SHORT = 0x40
+ANIM_DUR_SHORT_MAX = 0x3f
+ANIM_REPEAT_DEPTH = 2
+
+ROTATE_MAX = 5
+
+class SpecError(Exception):
+    pass
+
+def read_eye_shapes(eyes_h):
+    """Return {name: byte} for every eye_t shape defined in eyes.h."""
+    shapes = {}
+    with open(eyes_h) as f:
+        for line in f:
+            m = re.match(r'#define\s+(\w+)\s+\(eye_t\)\s*\{([^}]*)\}', line)
+            if m:
+                bits = [int(b) for b in m.group(2).split(',')]
+                shapes[m.group(1)] = sum(b << i for i, b in enumerate(bits))
+                continue
+            m = re.match(r'#define\s+(\w+)\s+(\w+)\s*$', line)
+            if m and m.group(2) in shapes:
+                shapes[m.group(1)] = shapes[m.group(2)]
+    return shapes
+
+def compile_spec(lines, shapes):
+    """Return a list of (name, random, code), code being [(bytes, comment)]."""
+    anims = []
+    code = None
+    depth = 0
+
+    def eye(word):
+        if word in shapes:
+            return shapes[word]
+        try:
+            value = int(word, 0)
+        except ValueError:
+            raise SpecError('unknown eye shape %s' % word)
+        if not 0 <= value <= 0xff:
+            raise SpecError('eye %s is more than a byte' % word)
+        return value
+
+    def number(word, lo, hi):
+        try:
+            value = int(word, 0)
+        except ValueError:
+            raise SpecError('%s is not a number' % word)
+        if not lo <= value <= hi:
+            raise SpecError('%s is outside %d..%d' % (word, lo, hi))
+        return value
+
+    def finish():
+        if code is None:
+            return
+        if depth:
+            raise SpecError('animation %s is missing a `next`' % anims[-1][0])
+        if not any(c for _, c in code if c.startswith('frame')):
+            raise SpecError('animation %s has no frames' % anims[-1][0])
+        code.append(([ANIM_END], 'end'))
+
+    for lineno, line in enumerate(lines, 1):
+        words = line.split('#', 1)[0].split()
+        if not words:
+            continue
+        op, args = words[0], words[1:]
+        try:
+            if op == 'anim':
+                finish()
+                if not args or len(args) > 2 or args[1:] not in ([], ['random']):
+                    raise SpecError('expected anim <name> [random]')
+                code = []
+                depth = 0
+                anims.append((args[0], len(args) == 2, code))
+                continue
+            if code is None:
+                raise SpecError('%s before the first anim' % op)
+
+            arity = {'dur': 1, 'left': 1, 'right': 1, 'toggle': 2, 'mirror': 0,
+                     'rotate': 1, 'chase': 0, 'repeat': 1, 'next': 0}
+            if op == 'show':
+                if len(args) not in (1, 2):
+                    raise SpecError('expected show <left> [<right>]')
+            elif op not in arity:
+                raise SpecError('unknown statement %s' % op)
+            elif len(args) != arity[op]:
+                raise SpecError('%s takes %d argument(s)' % (op, arity[op]))
+
+            if op == 'dur':
+                ticks = number(args[0], 0, 0xff)
+                if ticks <= ANIM_DUR_SHORT_MAX:
+                    code.append(([ANIM_DUR_SHORT | ticks], 'dur %d' % ticks))
+                else:
+                    code.append(([ANIM_DUR, ticks], 'dur %d' % ticks))
+            elif op == 'show' and (len(args) == 1 or eye(args[0]) == eye(args[1])):
+                code.append(([ANIM_BOTH, eye(args[0])], 'frame: %s' % args[0]))
+            elif op == 'show':
+                code.append(([ANIM_SHOW, eye(args[0]), eye(args[1])],
+                             'frame: %s %s' % tuple(args)))
+            elif op == 'left':
+                code.append(([ANIM_LEFT, eye(args[0])], 'frame: left %s' % args[0]))
+            elif op == 'right':
+                code.append(([ANIM_RIGHT, eye(args[0])], 'frame: right %s' % args[0]))
+            elif op == 'toggle':
+                code.append(([ANIM_TOGGLE, eye(args[0]), eye(args[1])],
+                             'frame: toggle %s %s' % tuple(args)))
+            elif op == 'mirror':
+                code.append(([ANIM_MIRROR], 'frame: mirror'))
+            elif op == 'rotate':
+                steps = number(args[0], 1, ROTATE_MAX)
+                code.append(([ANIM_ROTATE | steps], 'frame: rotate %d' % steps))
+            elif op == 'chase':
+                code.append(([ANIM_CHASE], 'frame: chase'))
+            elif op == 'repeat':
+                if depth == ANIM_REPEAT_DEPTH:
+                    raise SpecError('repeats nest at most %d deep' % ANIM_REPEAT_DEPTH)
+                count = number(args[0], 1, 0xff)
+                depth += 1
+                code.append(([ANIM_REPEAT, count], 'repeat %d' % count))
+            elif op == 'next':
+                if not depth:
+                    raise SpecError('next without repeat')
+                depth -= 1
+                code.append(([ANIM_NEXT], 'next'))
+        except SpecError as e:
+            raise SpecError('line %d: %s' % (lineno, e))
+
+    finish()
+    if not anims:
+        raise SpecError('no animations')
+    names = [a[0] for a in anims]
+    for name in names:
+        if names.count(name) > 1:
+            raise SpecError('animation %s is defined twice' % name)
+    return anims
+
+C_HEADER = """/// Eye animation definitions for 2023 booper.badge.lgbt.
+/**
+ ** Generated from %s by programming/anim_compile.py; edit that, not this.
+ ** See the ANIM_ opcodes in leds.h for the encoding.
+ **
+ ** \\file %s
+ ** \\author George Louthan
+ ** \\date   2023
+ ** \\copyright (c) 2023 George Louthan @duplico. MIT License.
+ */
+"""
+
+def write_c(f, spec_name, anims):
+    print(C_HEADER % (spec_name, 'animations.c'), file=f)
+    print('#include "leds.h"', file=f)
+    print('#include "animations.h"', file=f)
+    for name, _, code in anims:
+        print(file=f)
+        print('eye_anim_t anim_%s[] = {' % name, file=f)
+        indent = 1
+        for op, comment in code:
+            if op[0] == ANIM_NEXT:
+                indent -= 1
+            text = ', '.join('0x%02x' % b for b in op) + ','
+            print('    ' * indent + '%-20s // %s' % (text, comment), file=f)
+            if op[0] == ANIM_REPEAT:
+                indent += 1
+        print('};', file=f)
+    print(file=f)
+    print('eye_anim_t * const animations[] = {', file=f)
+    for name, random, _ in anims:
+        if random:
+            print('    anim_%s,' % name, file=f)
+    print('};', file=f)
+
+def write_h(f, spec_name, anims):
+    print((C_HEADER % (spec_name, 'animations.h')).replace(
+        'definitions', 'headers'), file=f)
+    print('#ifndef ANIMATIONS_H_', file=f)
+    print('#define ANIMATIONS_H_', file=f)
+    print(file=f)
+    print('#define ANIMATION_COUNT %d' % sum(1 for a in anims if a[1]), file=f)
+    print(file=f)
+    print('extern eye_anim_t * const animations[];', file=f)
+    print(file=f)
+    for name, _, _ in anims:
+        print('extern eye_anim_t anim_%s[];' % name, file=f)
+    print(file=f)
+    print('#endif /* ANIMATIONS_H_ */', file=f)
+
+@click.command()
+@click.argument('spec', type=click.Path(exists=True, dir_okay=False))
+@click.option('--eyes', type=click.Path(exists=True, dir_okay=False),
+              help='eyes.h to take shape names from. [default: next to SPEC]')
+@click.option('--out-dir', type=click.Path(file_okay=False),
+              help='Where to write animations.c and .h. [default: next to SPEC]')
+def anim_compile(spec, eyes, out_dir):
+    spec_dir = os.path.dirname(os.path.abspath(spec))
+    eyes = eyes or os.path.join(spec_dir, 'eyes.h')
+    out_dir = out_dir or spec_dir
+
+    with open(spec) as f:
+        lines = f.readlines()
+    try:
+        anims = compile_spec(lines, read_eye_shapes(eyes))
+    except SpecError as e:
+        click.echo('%s: %s' % (spec, e), err=True)
+        sys.exit(1)
+
+    # The firmware sources use CRLF line endings.
+    spec_name = os.path.basename(spec)
+    with open(os.path.join(out_dir, 'animations.c'), 'w', newline='\r\n') as f:
+        write_c(f, spec_name, anims)
+    with open(os.path.join(out_dir, 'animations.h'), 'w', newline='\r\n') as f:
+        write_h(f, spec_name, anims)
+
+    total = 0
+    for name, _, code in anims:
+        size = sum(len(op) for op, _ in code)
+        total += size
+        click.echo('%-12s %3d bytes' % (name, size), err=True)
+    click.echo('%-12s %3d bytes of FRAM, plus %d for animations[]' % (
+        'total', total, 2 * sum(1 for a in anims if a[1])), err=True)
+
+if __name__ == '__main__':
+    anim_compile()
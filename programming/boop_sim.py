@@ -0,0 +1,127 @@
+"""Simulate boop reach reports: convergecast against per-badge acks.
+
+Badges are scattered at random over a square area, and any two within range
+hear each other. Badge 0 boops, and the boop floods out for up to
+BADGE_BOOP_RADIO_HOPS relays. Then the badges tell badge 0 how many were
+reached, in one of two ways:
+
+  convergecast  what radio.c does. Every badge remembers the badge it first
+                heard the boop from (its parent). A badge with h hops left
+                waits h*30 csecs, plus up to 10 of jitter, for its children to
+                report, then sends its parent one report with its own count.
+  e2e acks      the alternative. Every badge sends its own ack back toward
+                badge 0 at a random time, relayed hop by hop along the
+                parents.
+
+Time runs in centiseconds. Each badge transmits at a fixed offset inside the
+centisecond, and two packets a receiver hears in the same centisecond collide
+if their offsets are closer than their airtime. Every packet that survives is
+also lost at random with probability LOSS.
+
+For each area this prints, averaged over the seeds, how many badges the boop
+reached, how many report packets it cost, and what fraction of the reach badge
+0 was told about.
+"""
+
+import math
+import random
+import statistics
+
+import click
+
+# These match radio.h and badge.h.
+BADGE_BOOP_RADIO_HOPS = 10
+RADIO_BOOP_REPORT_CSECS_PER_HOP = 30
+RADIO_BOOP_REPORT_JITTER_CSECS = 10
+
+# Airtime of a packet, in 100 us steps of the centisecond.
+AIRTIME = 2
+LOSS = 0.05
+# Csecs a relay waits, at most, before passing a packet on.
+RELAY_DELAY = 3
+
+AREAS = ((40, 40), (120, 40), (120, 80), (250, 60))
+
+
+def run(badges, side, radio_range, acks, seed):
+    """Boop once from badge 0, and return (report packets, reached, reported)."""
+    random.seed(seed)
+    position = [(random.uniform(0, side), random.uniform(0, side)) for _ in range(badges)]
+    offset = [random.randrange(100) for _ in range(badges)]
+    neighbors = [set(j for j in range(badges) if j != i and math.dist(position[i], position[j]) <= radio_range)
+                 for i in range(badges)]
+
+    # Packets are ('boop', hops left, from), ('report', count, to) and
+    #  ('ack', acked badge, to).
+    queue = {}
+
+    def send(t, sender, packet):
+        queue.setdefault(t, []).append((sender, packet))
+
+    # parent[i] is the badge i first heard the boop from.
+    parent = {0: None}
+    # report[i] is [parent, count, csec to report at, reported].
+    report = {0: [0, 1, (BADGE_BOOP_RADIO_HOPS + 1) * RADIO_BOOP_REPORT_CSECS_PER_HOP, False]}
+    acked = set()
+    report_packets = 0
+
+    send(0, 0, ('boop', BADGE_BOOP_RADIO_HOPS, 0))
+    for t in range((BADGE_BOOP_RADIO_HOPS + 2) * RADIO_BOOP_REPORT_CSECS_PER_HOP + 400):
+        sent = queue.pop(t, [])
+        report_packets += sum(packet[0] != 'boop' for _, packet in sent)
+        senders = set(sender for sender, _ in sent)
+
+        for r in range(badges):
+            if r in senders:
+                continue
+            heard = [(s, packet) for s, packet in sent if r in neighbors[s]]
+            for s, packet in heard:
+                if any(abs(offset[s] - offset[o]) < AIRTIME for o, _ in heard if o != s):
+                    continue
+                if random.random() < LOSS:
+                    continue
+                kind, value, to = packet
+                if kind == 'boop' and r not in parent:
+                    parent[r] = s
+                    if acks:
+                        send(t + 1 + random.randrange(RADIO_BOOP_REPORT_CSECS_PER_HOP * BADGE_BOOP_RADIO_HOPS),
+                             r, ('ack', r, r))
+                    else:
+                        report[r] = [s, 1, t + 1 + value * RADIO_BOOP_REPORT_CSECS_PER_HOP
+                                     + random.randrange(RADIO_BOOP_REPORT_JITTER_CSECS), False]
+                    if value:
+                        send(t + 1 + random.randrange(RELAY_DELAY), r, ('boop', value - 1, r))
+                elif kind == 'report' and to == r and r in report and not report[r][3]:
+                    report[r][1] = min(255, report[r][1] + value)
+                elif kind == 'ack' and parent.get(to) == r:
+                    if r == 0:
+                        acked.add(value)
+                    else:
+                        send(t + 1 + random.randrange(RELAY_DELAY), r, ('ack', value, r))
+
+        for i, (to, count, due, reported) in report.items():
+            if not reported and due == t:
+                report[i][3] = True
+                if i:
+                    send(t + 1, i, ('report', count, to))
+
+    reached = len(parent) - 1
+    return report_packets, reached, len(acked) if acks else report[0][1] - 1
+
+
+@click.command()
+@click.option('-r', '--range', 'radio_range', default=15.0, type=float, help='Radio range in meters.')
+@click.option('-s', '--seeds', default=40, type=int, help='Runs to average for each area.')
+def boop_sim(radio_range, seeds):
+    for badges, side in AREAS:
+        for acks in (False, True):
+            runs = [run(badges, side, radio_range, acks, seed) for seed in range(seeds)]
+            print('%3d badges in %gx%g m, %-12s: reached %5.1f, report packets %6.1f, reported/reached %.2f'
+                  % (badges, side, side, 'e2e acks' if acks else 'convergecast',
+                     statistics.mean(reached for _, reached, _ in runs),
+                     statistics.mean(packets for packets, _, _ in runs),
+                     statistics.mean(reported / reached for _, reached, reported in runs if reached)))
+
+
+if __name__ == '__main__':
+    boop_sim()
@@ -0,0 +1,57 @@
+"""Generate the brightness ladder in ccs_workspace/booper.badge.lgbt/leds.c.
+
+Prints the C source for leds_brightness_ladder to stdout; paste it over the
+table in leds.c if the number of levels or their range ever changes.
+
+    python gen_brightness_ladder.py > /tmp/ladder.c
+
+The levels are evenly spaced in log(intensity), which is how the eye sees
+them. Each level gets its light from the LED current first, and only makes
+up the rest with grayscale: the global brightness (BC) comes down from 100%
+to its 25% floor, then every channel's dot correction is scaled down to a
+quarter of its calibrated value, and only then does the grayscale ceiling
+drop. So a dim level still fades and scans over thousands of grayscale
+codes, rather than the couple of hundred it had before.
+
+The current model, from the TLC5948A's BC and DC registers as this badge
+uses them: BC takes the output current linearly from 25% (0x00) to 100%
+(0x7f), and DC scales that linearly from 0 to 100% (0x7f).
+"""
+
+import math
+
+import click
+
+BC_MAX = 0x7f
+BC_FLOOR = 0.25
+DC_SCALE_FULL = 128
+
+def bc_current(bc):
+    return BC_FLOOR + (1 - BC_FLOOR) * bc / BC_MAX
+
+@click.command()
+@click.option('--levels', default=16, show_default=True, help='LEDS_BRIGHTNESS_LEVELS in leds.h.')
+@click.option('--dimmest', default=0x00ff, show_default=True, help='Grayscale of the dimmest level at full current.')
+@click.option('--brightest', default=0xf000, show_default=True, help='Grayscale of the brightest level at full current.')
+@click.option('--min-dc-scale', default=32, show_default=True, help='Lowest dot correction scale, out of 128.')
+def gen_brightness_ladder(levels, dimmest, brightest, min_dc_scale):
+    lo = dimmest / 0xffff
+    hi = brightest / 0xffff
+    print('/// BC, DC scale and grayscale ceiling for each brightness level.')
+    print('const leds_brightness_t leds_brightness_ladder[LEDS_BRIGHTNESS_LEVELS] = {')
+    for level in range(levels):
+        intensity = lo * (hi / lo) ** (level / (levels - 1))
+        if intensity >= BC_FLOOR:
+            dc_scale = DC_SCALE_FULL
+            bc = min(BC_MAX, math.ceil((intensity - BC_FLOOR) / (1 - BC_FLOOR) * BC_MAX))
+        else:
+            bc = 0
+            dc_scale = max(min_dc_scale, math.ceil(intensity / BC_FLOOR * DC_SCALE_FULL))
+        current = bc_current(bc) * dc_scale / DC_SCALE_FULL
+        gs = min(0xffff, round(intensity / current * 0xffff))
+        print('        {0x%02x, %3d, 0x%04x}, // %2d: %6.2f%% light, %6.2f%% current' % (
+            bc, dc_scale, gs, level, 100 * intensity, 100 * current))
+    print('};')
+
+if __name__ == '__main__':
+    gen_brightness_ladder()
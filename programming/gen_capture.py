@@ -0,0 +1,81 @@
+"""Generate the synthetic radio capture in host/sample_capture.bin.
+
+The capture is in the sniffer's stream format (see sniff_decode.py), so
+host/replay takes it just like a real one. It covers ten minutes of a crowd
+of BADGES badges: a beacon every 8 s from one of them at random, on one of
+three channels, two boops that flood out four hops deep (with more copies
+at each hop, as more badges relay them), and a few bytes of line noise to
+resync past.
+
+The packets are version 2 of the protocol, which is what the badges spoke
+when this capture was first made, and the replay numbers quoted in the
+history are from this exact file. The output is the same on every run;
+`make check` in host/ replays it against host/replay_golden.txt.
+
+    python gen_capture.py ../host/sample_capture.bin
+"""
+
+import random
+import struct
+
+import click
+
+from sniff_decode import SNIFFER_SYNC, RADIO_MSG_TYPE_BEACON, RADIO_MSG_TYPE_BOOP, RADIO_HOP_PAYLOAD_SYNCED, crc16
+
+CAPTURE_PROTO_VER = 2
+CAPTURE_CSECS = 60000
+# Csecs between one moment of the capture and the next.
+CAPTURE_STEP_CSECS = 7
+BADGES = 20
+BEACON_CSECS = 800
+BEACON_CHANNELS = (14, 49, 78)
+BOOP_CSECS = (10003, 30009)
+BOOP_CHANNEL = 49
+BOOP_BADGE = 3
+BOOP_HOPS = 4
+BADGE_BOOP_RADIO_HOPS = 10
+GARBAGE_CSECS = 20006
+GARBAGE = b'\x00\xa5\x13garbage'
+
+
+def record(csecs, channel, payload, pipe=1, dropped=0):
+    """Return one sniffer record, with its checksum."""
+    body = bytes([len(payload)]) + struct.pack('<IBBB', csecs, channel, pipe, dropped) + payload
+    return bytes([SNIFFER_SYNC]) + body + bytes([-sum(body) & 0xFF])
+
+
+def packet(badge_id, msg_type, payload, csecs):
+    """Return a packet, clock-stamped at `csecs`, with its CRC."""
+    data = struct.pack('<HBBBBH', badge_id, CAPTURE_PROTO_VER, msg_type, payload,
+                       csecs % 100, (csecs // 100) & 0xFFFF)
+    return data + struct.pack('<H', crc16(data))
+
+
+def capture(seed):
+    random.seed(seed)
+    out = bytearray()
+    for t in range(0, CAPTURE_CSECS, CAPTURE_STEP_CSECS):
+        badge_id = random.randrange(BADGES)
+        if t % BEACON_CSECS < CAPTURE_STEP_CSECS:
+            out += record(t, random.choice(BEACON_CHANNELS),
+                          packet(badge_id, RADIO_MSG_TYPE_BEACON, RADIO_HOP_PAYLOAD_SYNCED, t))
+        if t in BOOP_CSECS:
+            for hop in range(BOOP_HOPS):
+                # One more relay heard at each hop, 5 csecs apart.
+                for copy in range(hop + 1):
+                    out += record(t + hop * 5 + copy, BOOP_CHANNEL,
+                                  packet(BOOP_BADGE, RADIO_MSG_TYPE_BOOP, BADGE_BOOP_RADIO_HOPS - hop, t))
+        if t == GARBAGE_CSECS:
+            out += GARBAGE
+    return out
+
+
+@click.command()
+@click.argument('output', type=click.File('wb'))
+@click.option('--seed', default=1, show_default=True, type=int)
+def gen_capture(output, seed):
+    output.write(capture(seed))
+
+
+if __name__ == '__main__':
+    gen_capture()
@@ -0,0 +1,32 @@
+"""Generate the lookup tables in ccs_workspace/booper.badge.lgbt/fade.c.
+
+Prints the C source for the tables to stdout; paste it over the tables in
+fade.c, between the "Generated by" comment and the first function, if the
+gamma or FADE_MAX_TICKS ever changes.
+
+    python gen_fade_tables.py > /tmp/tables.c
+"""
+
+import click
+
+@click.command()
+@click.option('--gamma', default=2.2, show_default=True, help='Display gamma.')
+@click.option('--max-ticks', default=100, show_default=True, help='FADE_MAX_TICKS in fade.h.')
+def gen_fade_tables(gamma, max_ticks):
+    print('/// Grayscale for each perceptual level, 0..255, at full brightness.')
+    print('const uint16_t fade_gamma[256] = {')
+    values = [round(65535 * (i / 255) ** gamma) for i in range(256)]
+    for row in range(0, 256, 8):
+        print('        ' + ', '.join('0x%04x' % v for v in values[row:row+8]) + ',')
+    print('};')
+    print()
+    print('/// 65536/ticks, for stepping a fade over that many ticks without dividing.')
+    print('const uint16_t fade_recip[FADE_MAX_TICKS+1] = {')
+    # 0 and 1 tick fades just snap to the target.
+    values = [0, 0] + [65536 // t for t in range(2, max_ticks + 1)]
+    for row in range(0, len(values), 8):
+        print('        ' + ', '.join('%5d' % v for v in values[row:row+8]) + ',')
+    print('};')
+
+if __name__ == '__main__':
+    gen_fade_tables()
@@ -0,0 +1,132 @@
+"""Simulate beacon collisions with and without channel hopping.
+
+Every badge is in one collision domain (everyone hears everyone), and beacons
+in the same slot collide if they start less than a packet's airtime apart on
+the same channel. Time is split into frames of 8 one-second slots, and each
+badge beacons in slot badge_id % 8, as radio.c does.
+
+  single   every badge beacons on one channel, at the same point in its
+           slot every frame (the beacon timer's phase), give or take 10 ms.
+  hopping  radio.c's scheme: a random time in the slot, clear of the 20 csec
+           guard bands, on hopping sequence entry (frame + badge_id / 8), with
+           each listener on entry (2 * frame + badge_id).
+
+Every badge's crystal is off by a few channels, which its calibration makes up
+for by moving its home channel off FREQ_NOMINAL by as much. radio.c shifts the
+rest of the sequence by the same amount, so every badge ends up on the same
+real channels. With --uncorrected, only the home channel is shifted, which is
+how the first version of hopping worked: then two badges only hear each other
+away from home if their crystals are off by the same amount.
+
+For each crowd size this prints, for both, the fraction of beacons a listener
+tuned to their channel received intact, and how many beacons each badge heard
+per frame. Then it works out, analytically, how many badges a single channel
+and the hopping sequence carry at 90% delivery.
+"""
+
+import math
+import random
+
+import click
+
+# A 17-byte packet, with preamble, at 1 Mbps.
+AIRTIME_SECS = 136e-6
+RADIO_BEACON_INTERVAL_SECS = 8
+RADIO_HOP_CHANNEL_COUNT = 6
+# These match radio.h and radio.c; entry 0 is the home channel.
+FREQ_MIN = 14
+FREQ_NUM = 6
+FREQ_NOMINAL = FREQ_MIN + FREQ_NUM // 2
+RADIO_HOP_CHANNELS = (FREQ_NOMINAL, 49, 78, 24, 80, 74)
+RADIO_HOP_GUARD_CSECS = 20
+# How far the beacon timer wanders from its phase each frame.
+SINGLE_JITTER_SECS = 0.01
+
+CROWDS = (120, 300, 1000, 3000, 10000)
+
+
+def real_channel(entry, offset, corrected):
+    """Return the real channel hopping sequence `entry` is on, for a crystal off by `offset`."""
+    if entry >= len(RADIO_HOP_CHANNELS):
+        # Beyond radio.c's sequence (with --channels), make one up.
+        channel = 2 * entry
+    else:
+        channel = RADIO_HOP_CHANNELS[entry]
+    if entry and not corrected:
+        return channel - offset
+    return channel
+
+
+def run(badges, hopping, channels, frames, corrected=True, seed=1):
+    """Return (delivery, beacons heard per badge per frame)."""
+    rand = random.Random(seed)
+    phase = [rand.random() for _ in range(badges)]
+    # The calibration picks from FREQ_MIN to FREQ_MIN + FREQ_NUM - 1.
+    crystal = random.Random(seed)
+    offset = [crystal.randrange(FREQ_NUM) + FREQ_MIN - FREQ_NOMINAL for _ in range(badges)]
+    guard = RADIO_HOP_GUARD_CSECS / 100
+    ok = 0
+    attempts = 0
+
+    for frame in range(frames):
+        for slot in range(RADIO_BEACON_INTERVAL_SECS):
+            sent = []
+            for j in range(slot, badges, RADIO_BEACON_INTERVAL_SECS):
+                if hopping:
+                    t = guard + (1 - 2 * guard) * rand.random()
+                    channel = real_channel((frame + j // RADIO_BEACON_INTERVAL_SECS) % channels,
+                                           offset[j], corrected)
+                else:
+                    t = (phase[j] + rand.random() * SINGLE_JITTER_SECS) % 1.0
+                    channel = real_channel(0, offset[j], corrected)
+                sent.append((t, channel, j))
+
+            on_channel = {}
+            for t, channel, j in sent:
+                on_channel.setdefault(channel, []).append((t, j))
+            # intact[j] is (channel, whether j's beacon didn't collide).
+            intact = {}
+            for channel, beacons in on_channel.items():
+                beacons.sort()
+                for k, (t, j) in enumerate(beacons):
+                    collided = ((k > 0 and t - beacons[k - 1][0] < AIRTIME_SECS) or
+                                (k + 1 < len(beacons) and beacons[k + 1][0] - t < AIRTIME_SECS))
+                    intact[j] = (channel, not collided)
+
+            for i in range(badges):
+                listening = real_channel((2 * frame + i) % channels if hopping else 0, offset[i], corrected)
+                for j, (channel, good) in intact.items():
+                    if j == i or channel != listening:
+                        continue
+                    attempts += 1
+                    if good:
+                        ok += 1
+    return ok / max(attempts, 1), ok / (badges * frames)
+
+
+@click.command()
+@click.option('-c', '--channels', default=RADIO_HOP_CHANNEL_COUNT, show_default=True, type=int,
+              help='Channels in the hopping sequence.')
+@click.option('-f', '--frames', default=40, show_default=True, type=int,
+              help='Frames to run; crowds over 1000 run a fifth as many.')
+@click.option('--uncorrected', is_flag=True,
+              help="Don't correct hops away from home for each badge's crystal.")
+def hop_sim(channels, frames, uncorrected):
+    print('badges  single P(ok)  heard/frame  hopping P(ok)  heard/frame')
+    for badges in CROWDS:
+        n = frames if badges <= 1000 else max(frames // 5, 1)
+        single = run(badges, False, channels, n)
+        hopping = run(badges, True, channels, n, corrected=not uncorrected)
+        print('%6d  %12.3f  %11.1f  %13.3f  %11.1f' % (badges, single[0], single[1], hopping[0], hopping[1]))
+
+    # A beacon survives if nothing else starts within an airtime either side
+    #  of it, so at 90% delivery the beacons per second on a channel are:
+    rate = -math.log(0.9) / (2 * AIRTIME_SECS)
+    # Hopping beacons only go out in the middle of the slot, between the guards.
+    window = 1 - 2 * RADIO_HOP_GUARD_CSECS / 100
+    print('Capacity at 90%% delivery: %d badges on one channel, %d hopping over %d.'
+          % (rate * RADIO_BEACON_INTERVAL_SECS, rate * RADIO_BEACON_INTERVAL_SECS * channels * window, channels))
+
+
+if __name__ == '__main__':
+    hop_sim()
@@ -0,0 +1,72 @@
+"""Check a badge's LED test report, for the assembly line.
+
+Connect a 3.3V USB serial adapter's RX to P1.4 (and ground to ground), at
+250000 8N1, then power the badge up. At power-on, the badge lights each LED
+by itself and reads back the TLC5948A's open and short detection, then sends
+the result, little-endian:
+
+    0x5A | open (2) | shorted (2) | sum
+
+`open` and `shorted` have a bit for each LED, eye*8 + segment, and `sum`
+makes the 8-bit sum of every byte after the 0x5A equal zero.
+
+Exits 0 if every LED passed, 1 if any failed, and 2 if no report came.
+"""
+
+import sys
+import time
+
+import click
+
+BADGE_POST_REPORT_SYNC = 0x5A
+REPORT_LEN = 6
+
+EYES = ('left', 'right')
+# In the order of eye_t's fields.
+SEGMENTS = ('tl', 'l', 'bl', 'm', 'dot', 'tr', 'r', 'br')
+
+
+def find_report(data):
+    """Return (open, shorted) from the first good report in `data`, or None."""
+    for start in range(len(data) - REPORT_LEN + 1):
+        record = data[start:start + REPORT_LEN]
+        if record[0] == BADGE_POST_REPORT_SYNC and not sum(record[1:]) & 0xFF:
+            return (record[1] | record[2] << 8, record[3] | record[4] << 8)
+    return None
+
+
+def led_names(bits):
+    return ['%s %s' % (EYES[i // 8], SEGMENTS[i % 8]) for i in range(16) if bits & (1 << i)]
+
+
+@click.command()
+@click.option('-p', '--port', required=True, help='Serial port the badge is on.')
+@click.option('-b', '--baud', default=250000, type=int)
+@click.option('-t', '--timeout', default=10.0, type=float, help='Seconds to wait for the badge to power up.')
+def post_check(port, baud, timeout):
+    import serial
+    stream = serial.Serial(port, baud, timeout=0.1)
+    data = bytearray()
+    deadline = time.time() + timeout
+    report = None
+    while report is None and time.time() < deadline:
+        data += stream.read(64)
+        report = find_report(data)
+
+    if report is None:
+        click.echo('FAIL: no LED test report from the badge.')
+        sys.exit(2)
+
+    opened, shorted = report
+    if not opened | shorted:
+        click.echo('PASS: all 16 LEDs.')
+        return
+    for name in led_names(opened):
+        click.echo('FAIL: %s is open.' % name)
+    for name in led_names(shorted):
+        click.echo('FAIL: %s is shorted.' % name)
+    sys.exit(1)
+
+
+if __name__ == '__main__':
+    post_check()
@@ -3,16 +3,34 @@ import os
 import click
 
 # In the following, FA is the badge ID, and 0E is the frequency.
+# This is the badge's persist_data_t (persist.h), which it boots from whenever
+# it has no committed settings of its own at 0x1900; flashing INFOA erases those.
 INFOA_TXT = """@1800
 FA 00 00 00 00 00 00 00 00 00 00 00 00 00 00 00 
 00 00 01 00 0E XX 00"""
 # TODO: needs a `q` by itself on the last line
 
+# Where tlc_dc_cal lives, in the last 16 bytes of INFOA.
+DC_CAL_ADDR = 0x19F0
+# The badge's calibration cache (calcache.c) sits just under it, at 0x19D0.
+# Flashing INFOA erases it, which just makes the next boot calibrate cold.
+
 @click.group()
 def program_badge():
     pass
 
-def do_flash_infoa(id, freq=None, infoa_base=INFOA_TXT):
+def parse_dc(ctx, param, value):
+    if value is None:
+        return None
+    try:
+        dc = [int(v, 0) for v in value.split(',')]
+    except ValueError:
+        raise click.BadParameter('expected 16 comma-separated numbers')
+    if len(dc) != 16 or not all(1 <= v <= 0x7f for v in dc):
+        raise click.BadParameter('expected 16 values from 1 to 0x7f, OUT15 first')
+    return dc
+
+def do_flash_infoa(id, freq=None, dc=None, infoa_base=INFOA_TXT):
     id_hex = '%02X' % id
     my_infoa = infoa_base
     my_infoa = my_infoa.replace('FA', id_hex, 1)
@@ -22,6 +40,10 @@ def do_flash_infoa(id, freq=None, infoa_base=INFOA_TXT):
         my_infoa = my_infoa.replace('0E', freq_hex)
     else:
         my_infoa = my_infoa.replace('XX', '00')
+    if dc is not None:
+        # Left out, the erase leaves it 0xFF, and the badge uses TLC_DC.
+        my_infoa += '\n@%04X\n' % DC_CAL_ADDR
+        my_infoa += ' '.join('%02X' % v for v in dc)
     with open('.infoa.tmp.txt', 'w') as infoa:
         print(my_infoa, file=infoa)
         print('q', file=infoa)
@@ -43,8 +65,9 @@ def do_flash_infoa(id, freq=None, infoa_base=INFOA_TXT):
 @click.command()
 @click.argument('id', type=int)
 @click.option('--freq', type=int, default=None)
-def flash_infoa(id, freq):
-    do_flash_infoa(id, freq=freq)
+@click.option('--dc', callback=parse_dc, default=None, help='Dot correction for each LED, OUT15 first, as 16 comma-separated values.')
+def flash_infoa(id, freq, dc):
+    do_flash_infoa(id, freq=freq, dc=dc)
 
 program_badge.add_command(flash_infoa)
 
@@ -75,13 +98,14 @@ program_badge.add_command(flash_program)
 @click.option('-i', '--source-txt', default='code_and_cinit.txt', type=click.Path(file_okay=True, dir_okay=False, exists=True, readable=True))
 @click.argument('id', type=int)
 @click.option('--freq', type=int, default=None)
-def flash_badge(id, source_txt, freq):
+@click.option('--dc', callback=parse_dc, default=None, help='Dot correction for each LED, OUT15 first, as 16 comma-separated values.')
+def flash_badge(id, source_txt, freq, dc):
     if id == 250:
         click.echo("WARNING:\tFlashing this badge using unassigned ID")
     if id > 100:
         click.echo("WARNING:\tFlashing this badge with ID over 100")
     click.echo("INFO:\tAttempting to flash badge %03d" % id)
-    do_flash_infoa(id, freq=freq)
+    do_flash_infoa(id, freq=freq, dc=dc)
     do_flash_program(source_txt)
 
 program_badge.add_command(flash_badge)
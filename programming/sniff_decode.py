@@ -0,0 +1,239 @@
+"""Decode the serial stream from a RADIO_SNIFFER badge.
+
+Connect a 3.3V USB serial adapter's RX to P1.4 (and ground to ground), at
+250000 8N1. Every record in the stream looks like this, little-endian:
+
+    0xA5 | len | csecs (4) | channel | pipe | dropped | payload (len) | sum
+
+`csecs` is the sniffer's uptime in centiseconds, `dropped` is the number of
+records the sniffer had to drop (because its queue was full) just before this
+one, and `sum` makes the 8-bit sum of every byte after the 0xA5 equal zero.
+
+The same bytes, saved to a file with --save, are a radio capture that can be
+decoded again later by passing the file instead of --port, or replayed through
+the badge's own code with host/replay.
+
+Relayed boops carry the originator's badge ID, not the relayer's, so the boop
+"trees" are grouped by hop depth (how many relays a copy went through), not by
+which badge relayed it.
+"""
+
+import struct
+import sys
+from collections import defaultdict
+
+import click
+
+SNIFFER_SYNC = 0xA5
+SNIFFER_RECORD_OVERHEAD = 10
+
+RADIO_MSG_TYPE_BEACON = 1
+RADIO_MSG_TYPE_BOOP = 2
+RADIO_PROTO_VER = 2
+RADIO_PROTO_FMT = '<HBBBBHH'
+RADIO_PROTO_LEN = struct.calcsize(RADIO_PROTO_FMT)
+RADIO_HOP_PAYLOAD_SYNCED = 0x80
+
+BADGES_IN_SYSTEM = 120
+BADGE_ID_UNASSIGNED = 250
+BADGE_BOOP_RADIO_HOPS = 10
+
+CRC16_SEED = 0x9C8B
+
+# Copies of the same boop heard more than this long after the first are a new boop.
+BOOP_WINDOW_CSECS = 500
+
+
+def crc16(data):
+    """Match the MSP430 CRC module fed through CRCDI, which takes each byte LSB first."""
+    crc = CRC16_SEED
+    for byte in data:
+        for bit in range(8):
+            feedback = ((crc >> 15) ^ (byte >> bit)) & 1
+            crc = (crc << 1) & 0xFFFF
+            if feedback:
+                crc ^= 0x1021
+    return crc
+
+
+def read_records(read, save=None):
+    """Yield (csecs, channel, pipe, dropped, payload) for every good record from `read`."""
+    buf = bytearray()
+    bad = 0
+    while True:
+        chunk = read(256)
+        if not chunk:
+            break
+        if save:
+            save.write(chunk)
+        buf += chunk
+        while True:
+            start = buf.find(SNIFFER_SYNC)
+            if start < 0:
+                bad += len(buf)
+                buf.clear()
+                break
+            bad += start
+            del buf[:start]
+            if len(buf) < 2:
+                break
+            total = buf[1] + SNIFFER_RECORD_OVERHEAD
+            if len(buf) < total:
+                break
+            record = buf[1:total]
+            if sum(record) & 0xFF:
+                # Not actually the start of a record. Resync on the next 0xA5.
+                bad += 1
+                del buf[:1]
+                continue
+            csecs, channel, pipe, dropped = struct.unpack_from('<IBBB', record, 1)
+            yield csecs, channel, pipe, dropped, bytes(record[8:-1])
+            del buf[:total]
+    if bad:
+        click.echo('Skipped %d bytes of garbage in the stream.' % bad, err=True)
+
+
+class Packet(object):
+    def __init__(self, csecs, channel, pipe, payload):
+        self.csecs = csecs
+        self.channel = channel
+        self.pipe = pipe
+        self.valid = False
+        if len(payload) != RADIO_PROTO_LEN:
+            return
+        (self.badge_id, self.proto_version, self.msg_type, self.msg_payload,
+         self.clock_csecs, self.clock_secs, crc) = struct.unpack(RADIO_PROTO_FMT, payload)
+        self.crc_ok = crc16(payload[:-2]) == crc
+        self.valid = (self.badge_id < BADGES_IN_SYSTEM or self.badge_id == BADGE_ID_UNASSIGNED)
+
+
+class Stats(object):
+    def __init__(self, bin_secs, check_crc):
+        self.bin_secs = bin_secs
+        self.check_crc = check_crc
+        self.first = None
+        self.last = None
+        self.records = 0
+        self.dropped = 0
+        self.invalid = 0
+        self.beacons = defaultdict(int)
+        self.beacon_first = {}
+        self.beacon_last = {}
+        self.boops = []
+        self.open_boops = {}
+        self.channel_bins = defaultdict(lambda: defaultdict(int))
+
+    def add(self, csecs, channel, pipe, dropped, payload):
+        self.records += 1
+        self.dropped += dropped
+        if self.first is None:
+            self.first = csecs
+        self.last = csecs
+        self.channel_bins[channel][(csecs - self.first) // (100 * self.bin_secs)] += 1
+
+        pkt = Packet(csecs, channel, pipe, payload)
+        if not pkt.valid or (self.check_crc and not pkt.crc_ok):
+            self.invalid += 1
+            return
+
+        if pkt.msg_type == RADIO_MSG_TYPE_BEACON:
+            self.beacons[pkt.badge_id] += 1
+            self.beacon_first.setdefault(pkt.badge_id, csecs)
+            self.beacon_last[pkt.badge_id] = csecs
+        elif pkt.msg_type == RADIO_MSG_TYPE_BOOP:
+            boop = self.open_boops.get(pkt.badge_id)
+            if boop is None or csecs - boop['start'] > BOOP_WINDOW_CSECS:
+                boop = {'origin': pkt.badge_id, 'start': csecs,
+                        'depths': defaultdict(list)}
+                self.open_boops[pkt.badge_id] = boop
+                self.boops.append(boop)
+            depth = BADGE_BOOP_RADIO_HOPS - pkt.msg_payload
+            boop['depths'][depth].append((csecs - boop['start'], channel))
+
+    def report_beacons(self):
+        span = max(self.last - self.first, 1) / 100.0
+        click.echo('Beacons per minute, by badge (%d badges over %.0f s):' % (len(self.beacons), span))
+        for badge_id in sorted(self.beacons):
+            heard = (self.beacon_last[badge_id] - self.beacon_first[badge_id]) / 100.0
+            click.echo('  %3d  %6.2f/min  (%d heard over %.0f s)' % (
+                badge_id, 60.0 * self.beacons[badge_id] / span,
+                self.beacons[badge_id], heard))
+
+    def report_boops(self):
+        click.echo('Boops (%d):' % len(self.boops))
+        for boop in self.boops:
+            click.echo('  from %d at %.2f s' % (boop['origin'], (boop['start'] - self.first) / 100.0))
+            for depth in sorted(boop['depths']):
+                copies = boop['depths'][depth]
+                channels = sorted(set(c for _, c in copies))
+                click.echo('  %s+- hop %d: %d heard, first at +%.2f s, channels %s' % (
+                    '  ' * depth, depth, len(copies), copies[0][0] / 100.0,
+                    ','.join(str(c) for c in channels)))
+
+    def report_channels(self, width=60):
+        bins = max(max(b) for b in self.channel_bins.values()) + 1
+        peak = max(max(b.values()) for b in self.channel_bins.values())
+        click.echo('Channel load, packets per %d s:' % self.bin_secs)
+        for channel in sorted(self.channel_bins):
+            counts = self.channel_bins[channel]
+            total = sum(counts.values())
+            click.echo('  ch %3d: %d packets, peak %d' % (channel, total, max(counts.values())))
+            for i in range(bins):
+                click.echo('    %6d s |%s %d' % (
+                    i * self.bin_secs, '#' * (counts[i] * width // peak), counts[i]))
+
+    def write_csv(self, path):
+        bins = max(max(b) for b in self.channel_bins.values()) + 1
+        channels = sorted(self.channel_bins)
+        with open(path, 'w') as out:
+            print('secs,' + ','.join('ch%d' % c for c in channels), file=out)
+            for i in range(bins):
+                print('%d,' % (i * self.bin_secs) + ','.join(
+                    str(self.channel_bins[c][i]) for c in channels), file=out)
+
+
+@click.command()
+@click.argument('capture', required=False, type=click.Path(dir_okay=False, exists=True))
+@click.option('-p', '--port', default=None, help='Serial port to read live from, instead of a capture file.')
+@click.option('-b', '--baud', default=250000, type=int)
+@click.option('-s', '--save', default=None, type=click.Path(dir_okay=False, writable=True), help='Also save the raw stream here.')
+@click.option('--bin-secs', default=10, type=int, help='Width of each channel load bin, in seconds.')
+@click.option('--csv', default=None, type=click.Path(dir_okay=False, writable=True), help='Write channel load bins to a CSV file.')
+@click.option('--no-crc', is_flag=True, help='Don\'t drop packets whose CRC doesn\'t check out.')
+def sniff_decode(capture, port, baud, save, bin_secs, csv, no_crc):
+    if port:
+        import serial
+        stream = serial.Serial(port, baud)
+        # Block for the first byte, then take whatever else has arrived.
+        read = lambda n: stream.read(max(1, min(n, stream.in_waiting)))
+    elif capture:
+        read = open(capture, 'rb').read
+    else:
+        read = sys.stdin.buffer.read
+
+    save_file = open(save, 'wb') if save else None
+    stats = Stats(bin_secs, not no_crc)
+    try:
+        for record in read_records(read, save_file):
+            stats.add(*record)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        if save_file:
+            save_file.close()
+
+    if not stats.records:
+        click.echo('No records.')
+        return
+
+    click.echo('%d records, %d invalid, %d dropped by the sniffer.' % (
+        stats.records, stats.invalid, stats.dropped))
+    stats.report_beacons()
+    stats.report_boops()
+    stats.report_channels()
+    if csv:
+        stats.write_csv(csv)
+
+
+if __name__ == '__main__':
+    sniff_decode()
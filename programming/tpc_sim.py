@@ -0,0 +1,150 @@
+"""Simulate the radio's transmit power control in a crowded hall.
+
+Badges are scattered at random over a square hall. Every beacon interval each
+badge hears every other badge whose signal arrives above the RFM75's
+sensitivity, under log-distance path loss, and then steps its beacon and relay
+power levels exactly as radio_tpc_update() does in radio.c. The same hall is
+run again with power control off, for comparison.
+
+For each hall this prints:
+  - how many badges hear each beacon, without and with power control (the
+    ratio is the spatial reuse power control buys);
+  - the mean transmit current of a beacon, from assumed per-level currents;
+  - the fraction of badges a flooded boop reaches, from random origins;
+  - how many power changes happened in the last 100 intervals, which should be
+    none once the hall has settled.
+
+The path loss model and the transmit currents are assumptions, not
+measurements, so the output is only good for comparing settings.
+"""
+
+import math
+import random
+
+import click
+
+# RF_PWR levels, lowest to highest, in dBm.
+RADIO_TX_POWER_DBM = (-10, -5, 0, 5)
+RADIO_TX_POWER_MAX = len(RADIO_TX_POWER_DBM) - 1
+# Assumed typical RFM75 transmit current at each level, in mA.
+RADIO_TX_CURRENT_MA = (12.0, 14.0, 17.0, 28.0)
+RADIO_SENSITIVITY_DBM = -83.0
+
+# These match radio.c and radio.h.
+RADIO_TPC_BEACON_LIMITS = (0, 24, 16, 8)
+RADIO_TPC_RELAY_LIMITS = (0, 16, 10, 4)
+RADIO_TPC_WINDOW_INTERVALS = 12
+RADIO_TPC_HOLD_INTERVALS = 8
+BADGE_BOOP_RADIO_HOPS = 10
+
+BOOP_ORIGINS = 20
+SETTLED_INTERVALS = 100
+
+
+def path_loss(distance):
+    """Return the path loss in dB over `distance` meters (exponent 3)."""
+    return 40 + 30 * math.log10(max(distance, 0.5))
+
+
+def hears(level, distance):
+    return RADIO_TX_POWER_DBM[level] - path_loss(distance) >= RADIO_SENSITIVITY_DBM
+
+
+def tpc_step(level, limits, nearby):
+    """radio_tpc_step() from radio.c."""
+    if level and nearby > limits[level]:
+        return level - 1
+    if level < RADIO_TX_POWER_MAX and nearby < limits[level + 1] - (limits[level + 1] >> 2):
+        return level + 1
+    return level
+
+
+def simulate(badges, side, seed, intervals, tpc=True):
+    """Run one hall, and return a dict of its results."""
+    rand = random.Random(seed)
+    position = [(rand.uniform(0, side), rand.uniform(0, side)) for _ in range(badges)]
+    distance = [[math.dist(a, b) for b in position] for a in position]
+    beacon = [RADIO_TX_POWER_MAX] * badges
+    relay = [RADIO_TX_POWER_MAX] * badges
+    hold = [0] * badges
+    # last_heard[i][j] is the last interval badge i heard badge j.
+    last_heard = [[-RADIO_TPC_WINDOW_INTERVALS - 1] * badges for _ in range(badges)]
+    changes = 0
+    settled_changes = 0
+
+    for t in range(intervals):
+        if t == intervals - SETTLED_INTERVALS:
+            settled_changes = changes
+        for j in range(badges):
+            for i in range(badges):
+                if i != j and hears(beacon[j], distance[i][j]):
+                    last_heard[i][j] = t
+        if not tpc:
+            continue
+        for i in range(badges):
+            if hold[i]:
+                hold[i] -= 1
+                continue
+            nearby = sum(1 for j in range(badges) if t - last_heard[i][j] < RADIO_TPC_WINDOW_INTERVALS)
+            new_beacon = tpc_step(beacon[i], RADIO_TPC_BEACON_LIMITS, nearby)
+            new_relay = tpc_step(relay[i], RADIO_TPC_RELAY_LIMITS, nearby)
+            if new_beacon != beacon[i] or new_relay != relay[i]:
+                hold[i] = RADIO_TPC_HOLD_INTERVALS
+                changes += 1
+            beacon[i] = new_beacon
+            relay[i] = new_relay
+
+    reach = sum(sum(1 for i in range(badges) if i != j and hears(beacon[j], distance[i][j]))
+                for j in range(badges)) / badges
+
+    # Flood boops: the origin at full power, every relay at its relay level.
+    coverage = 0
+    for origin in rand.sample(range(badges), BOOP_ORIGINS):
+        seen = {origin}
+        frontier = [(origin, RADIO_TX_POWER_MAX)]
+        hops = BADGE_BOOP_RADIO_HOPS
+        while frontier and hops >= 0:
+            heard = []
+            for j, level in frontier:
+                for i in range(badges):
+                    if i not in seen and hears(level, distance[i][j]):
+                        seen.add(i)
+                        heard.append((i, relay[i]))
+            frontier = heard if hops else []
+            hops -= 1
+        coverage += len(seen) / badges
+
+    return dict(
+        reach=reach,
+        beacon_ma=sum(RADIO_TX_CURRENT_MA[level] for level in beacon) / badges,
+        relay_ma=sum(RADIO_TX_CURRENT_MA[level] for level in relay) / badges,
+        coverage=coverage / BOOP_ORIGINS,
+        settled_changes=changes - settled_changes,
+        levels=[beacon.count(level) for level in range(RADIO_TX_POWER_MAX + 1)],
+    )
+
+
+@click.command()
+@click.option('-n', '--badges', default=300, type=int, help='Badges in the hall.')
+@click.option('-s', '--side', 'sides', default=(60, 30), type=float, multiple=True,
+              help='Side of the square hall in meters; repeat for more halls.')
+@click.option('--seed', default=2, type=int)
+@click.option('-i', '--intervals', default=300, type=int, help='Beacon intervals to run.')
+def tpc_sim(badges, sides, seed, intervals):
+    for side in sides:
+        fixed = simulate(badges, side, seed, intervals, tpc=False)
+        tpc = simulate(badges, side, seed, intervals)
+        print('%d badges in a %g m hall:' % (badges, side))
+        print('  receivers per beacon  %.0f -> %.0f (%.1fx spatial reuse)'
+              % (fixed['reach'], tpc['reach'], fixed['reach'] / tpc['reach']))
+        print('  beacon TX current     %.1f -> %.1f mA (-%d%%); relays %.1f mA'
+              % (fixed['beacon_ma'], tpc['beacon_ma'],
+                 round(100 * (1 - tpc['beacon_ma'] / fixed['beacon_ma'])), tpc['relay_ma']))
+        print('  boop coverage         %.2f -> %.2f' % (fixed['coverage'], tpc['coverage']))
+        print('  beacon levels         %s, lowest first' % tpc['levels'])
+        print('  power changes in the last %d intervals: %d'
+              % (SETTLED_INTERVALS, tpc['settled_changes']))
+
+
+if __name__ == '__main__':
+    tpc_sim()